@@ -30,6 +30,9 @@ namespace bts { namespace api {
       vector<market_order> blockchain_market_list_bids(string quote_symbol, string base_symbol, uint32_t limit ) const;
       vector<market_order> blockchain_market_list_asks(string quote_symbol, string base_symbol, uint32_t limit) const;
       vector<market_order> blockchain_market_list_shorts(string quote_symbol, uint32_t limit ) const;
+      market_depth blockchain_market_depth(string quote_symbol, string base_symbol, uint32_t levels ) const;
+      vector<market_depth_update> blockchain_market_depth_updates(string quote_symbol, string base_symbol,
+                                                                  uint64_t after_update_id, uint32_t limit ) const;
    };
 
    class wallet_api 
@@ -51,6 +54,8 @@ FC_API( bts::api::blockchain_api,
         (blockchain_market_list_bids)
         (blockchain_market_list_asks)
         (blockchain_market_list_shorts)
+        (blockchain_market_depth)
+        (blockchain_market_depth_updates)
       )
 FC_API( bts::api::wallet_api, (wallet_unlock) )
 
@@ -136,7 +136,7 @@ namespace bts { namespace blockchain {
 
        cur_record->last_update = eval_state.pending_state()->now();
 
-       const oasset_record asset_rec = eval_state.pending_state()->get_asset_record( cur_record->condition.asset_id );
+       const oasset_record asset_rec = eval_state.pending_state()->get_asset_definition( cur_record->condition.asset_id );
        FC_ASSERT( asset_rec.valid() );
 
        FC_ASSERT( !eval_state.pending_state()->is_fraudulent_asset( *asset_rec ) );
@@ -170,7 +170,7 @@ namespace bts { namespace blockchain {
       if( this->amount > current_balance_record->get_spendable_balance( eval_state.pending_state()->now() ).amount )
          FC_CAPTURE_AND_THROW( insufficient_funds, (current_balance_record)(amount) );
 
-      auto asset_rec = eval_state.pending_state()->get_asset_record( current_balance_record->condition.asset_id );
+      auto asset_rec = eval_state.pending_state()->get_asset_definition( current_balance_record->condition.asset_id );
       FC_ASSERT( asset_rec.valid() );
 
       const bool authority_is_retracting = asset_rec->flag_is_active( asset_record::retractable_balances )
@@ -224,6 +224,8 @@ namespace bts { namespace blockchain {
 
       if( asset_rec->is_market_issued() )
       {
+         // The yield is the only part of a withdrawal that depends on the supply and collected fees
+         asset_rec = eval_state.pending_state()->get_asset_record( current_balance_record->condition.asset_id );
          auto yield = current_balance_record->calculate_yield( eval_state.pending_state()->now(),
                                                                current_balance_record->balance,
                                                                asset_rec->collected_fees,
@@ -0,0 +1,210 @@
+#include <bts/blockchain/block_log.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <limits>
+
+namespace bts { namespace blockchain {
+
+   block_log::~block_log()
+   {
+      close();
+   }
+
+   void block_log::open( const fc::path& dir )
+   { try {
+      close();
+
+      std::lock_guard<std::mutex> lock( _mutex );
+      fc::create_directories( dir );
+      _log_path = dir / "blocks.log";
+      _index_path = dir / "blocks.index";
+
+      // fstream cannot open a file for both reading and writing unless it already exists
+      if( !fc::exists( _log_path ) ) { boost::filesystem::ofstream create( _log_path, std::ios::binary ); }
+      if( !fc::exists( _index_path ) ) { boost::filesystem::ofstream create( _index_path, std::ios::binary ); }
+
+      const uint64_t index_size = boost::filesystem::file_size( _index_path );
+      _log_size = boost::filesystem::file_size( _log_path );
+      open_files();
+
+      // Drop whatever was not completely written if we were interrupted in the middle of an append
+      _head_block_num = uint32_t( index_size / index_entry_size );
+      while( _head_block_num > 0 && end_of_block( read_index_entry( _head_block_num ) ) > _log_size )
+          --_head_block_num;
+
+      const uint64_t log_end = _head_block_num > 0 ? end_of_block( read_index_entry( _head_block_num ) ) : 0;
+      if( log_end != _log_size || uint64_t( _head_block_num ) * index_entry_size != index_size )
+      {
+          wlog( "Discarding incomplete entries at the end of the block log after block ${n}", ("n",_head_block_num) );
+          truncate_files( _head_block_num + 1 );
+      }
+   } FC_CAPTURE_AND_RETHROW( (dir) ) }
+
+   void block_log::close()
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      if( _log.is_open() ) _log.close();
+      if( _index.is_open() ) _index.close();
+      _head_block_num = 0;
+      _log_size = 0;
+   }
+
+   bool block_log::is_open()const
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      return _log.is_open();
+   }
+
+   uint32_t block_log::head_block_num()const
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      return _head_block_num;
+   }
+
+   void block_log::append( const full_block& block_data, const block_id_type& block_id )
+   { try {
+      const vector<char> data = fc::raw::pack( block_data );
+      const uint32_t data_size = uint32_t( data.size() );
+
+      std::lock_guard<std::mutex> lock( _mutex );
+      FC_ASSERT( _log.is_open() );
+      FC_ASSERT( block_data.block_num == _head_block_num + 1, "blocks must be appended in order",
+                 ("head_block_num",_head_block_num) );
+
+      _log.clear();
+      _log.seekp( _log_size );
+      _log.write( (const char*)&data_size, sizeof( data_size ) );
+      _log.write( data.data(), data.size() );
+      _log.flush();
+
+      // The index entry is written last so that a partially written block is never indexed
+      _index.clear();
+      _index.seekp( uint64_t( _head_block_num ) * index_entry_size );
+      _index.write( (const char*)&_log_size, sizeof( _log_size ) );
+      _index.write( block_id.data(), block_id.data_size() );
+      _index.flush();
+
+      FC_ASSERT( _log.good() && _index.good(), "error writing to block log" );
+
+      _log_size += sizeof( data_size ) + data.size();
+      ++_head_block_num;
+   } FC_CAPTURE_AND_RETHROW( (block_id) ) }
+
+   void block_log::truncate( uint32_t block_num )
+   { try {
+      std::lock_guard<std::mutex> lock( _mutex );
+      FC_ASSERT( _log.is_open() );
+      truncate_files( block_num );
+   } FC_CAPTURE_AND_RETHROW( (block_num) ) }
+
+   void block_log::flush()
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      if( _log.is_open() ) _log.flush();
+      if( _index.is_open() ) _index.flush();
+   }
+
+   optional<block_id_type> block_log::fetch_block_id( uint32_t block_num )const
+   { try {
+      std::lock_guard<std::mutex> lock( _mutex );
+      if( block_num == 0 || block_num > _head_block_num ) return optional<block_id_type>();
+      return read_index_entry( block_num ).id;
+   } FC_CAPTURE_AND_RETHROW( (block_num) ) }
+
+   optional<full_block> block_log::fetch_optional( uint32_t block_num )const
+   { try {
+      std::lock_guard<std::mutex> lock( _mutex );
+      if( block_num == 0 || block_num > _head_block_num ) return optional<full_block>();
+      return read_block( block_num, read_index_entry( block_num ) );
+   } FC_CAPTURE_AND_RETHROW( (block_num) ) }
+
+   optional<full_block> block_log::fetch_optional( uint32_t block_num, const block_id_type& block_id )const
+   { try {
+      std::lock_guard<std::mutex> lock( _mutex );
+      if( block_num == 0 || block_num > _head_block_num ) return optional<full_block>();
+      const index_entry entry = read_index_entry( block_num );
+      if( entry.id != block_id ) return optional<full_block>();
+      return read_block( block_num, entry );
+   } FC_CAPTURE_AND_RETHROW( (block_num)(block_id) ) }
+
+   full_block block_log::fetch( uint32_t block_num )const
+   { try {
+      const optional<full_block> block = fetch_optional( block_num );
+      FC_ASSERT( block.valid(), "block is not in the block log" );
+      return *block;
+   } FC_CAPTURE_AND_RETHROW( (block_num) ) }
+
+   void block_log::open_files()
+   {
+      const auto mode = std::ios::in | std::ios::out | std::ios::binary;
+      _log.open( _log_path, mode );
+      _index.open( _index_path, mode );
+      FC_ASSERT( _log.is_open() && _index.is_open(), "unable to open block log" );
+   }
+
+   void block_log::truncate_files( uint32_t block_num )
+   {
+      FC_ASSERT( block_num > 0 );
+      if( block_num > _head_block_num + 1 ) return;
+
+      uint64_t new_log_size = 0;
+      if( block_num <= _head_block_num )
+          new_log_size = read_index_entry( block_num ).offset;
+      else if( _head_block_num > 0 )
+          new_log_size = end_of_block( read_index_entry( _head_block_num ) );
+
+      // Windows cannot resize a file that is open
+      _log.close();
+      _index.close();
+      boost::filesystem::resize_file( _log_path, new_log_size );
+      boost::filesystem::resize_file( _index_path, uint64_t( block_num - 1 ) * index_entry_size );
+      open_files();
+
+      _head_block_num = block_num - 1;
+      _log_size = new_log_size;
+   }
+
+   optional<full_block> block_log::read_block( uint32_t block_num, const index_entry& entry )const
+   {
+      uint32_t data_size = 0;
+      _log.clear();
+      _log.seekg( entry.offset );
+      _log.read( (char*)&data_size, sizeof( data_size ) );
+      FC_ASSERT( _log.good() && entry.offset + sizeof( data_size ) + data_size <= _log_size, "corrupt block log entry",
+                 ("block_num",block_num) );
+
+      vector<char> data( data_size );
+      _log.read( data.data(), data.size() );
+      FC_ASSERT( _log.good(), "error reading block log", ("block_num",block_num) );
+
+      return fc::raw::unpack<full_block>( data );
+   }
+
+   block_log::index_entry block_log::read_index_entry( uint32_t block_num )const
+   {
+      index_entry entry;
+      _index.clear();
+      _index.seekg( uint64_t( block_num - 1 ) * index_entry_size );
+      _index.read( (char*)&entry.offset, sizeof( entry.offset ) );
+      _index.read( entry.id.data(), entry.id.data_size() );
+      FC_ASSERT( _index.good(), "error reading block log index", ("block_num",block_num) );
+      return entry;
+   }
+
+   uint64_t block_log::end_of_block( const index_entry& entry )const
+   {
+      uint32_t data_size = 0;
+      if( entry.offset + sizeof( data_size ) > _log_size ) return std::numeric_limits<uint64_t>::max();
+
+      _log.clear();
+      _log.seekg( entry.offset );
+      _log.read( (char*)&data_size, sizeof( data_size ) );
+      if( !_log.good() ) return std::numeric_limits<uint64_t>::max();
+
+      return entry.offset + sizeof( data_size ) + data_size;
+   }
+
+} } // bts::blockchain
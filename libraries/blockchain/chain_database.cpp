@@ -16,8 +16,12 @@
 #include <fc/thread/non_preemptable_scope_check.hpp>
 #include <fc/thread/unique_lock.hpp>
 
+#include <deque>
+#include <future>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <thread>
 
 #ifndef WIN32
 #include <csignal>
@@ -30,28 +34,98 @@ namespace bts { namespace blockchain {
 
    const static short MAX_RECENT_OPERATIONS = 20;
 
+   void forget_pending_evaluations( unordered_map<transaction_id_type, pending_evaluation>& evaluations,
+                                    const vector<transaction_id_type>& trx_ids, pending_read_set& dirty_keys )
+   {
+       for( const transaction_id_type& trx_id : trx_ids )
+       {
+           const auto iter = evaluations.find( trx_id );
+           if( iter == evaluations.end() )
+               continue;
+
+           dirty_keys.add( *iter->second.writes );
+           evaluations.erase( iter );
+       }
+   }
+
    namespace detail
    {
       void chain_database_impl::revalidate_pending()
       {
+            // This may yield, so do it before we start rebuilding the pending state
+            recover_pending_signatures();
+
+            const vector<transaction_id_type> expired = _pending_pool.remove_expired( self->now() );
+            for( const transaction_id_type& trx_id : expired )
+            {
+                _pending_signature_cache.erase( trx_id );
+                ilog( "discarding expired transaction: ${id}", ("id",trx_id) );
+            }
+
+            // Later transactions may have been evaluated on top of what the expired ones wrote
+            forget_pending_evaluations( _pending_evaluations, expired, _pending_dirty_keys );
+
             _pending_fee_index.clear();
 
             vector<transaction_id_type> trx_to_discard;
 
             _pending_trx_state = std::make_shared<pending_chain_state>( self->shared_from_this() );
+
+            // Everything written by new blocks, or by pending transactions whose results changed, since the
+            // previous round; any saved evaluation that touched one of these keys has to be redone
+            pending_read_set dirty_keys = std::move( _pending_dirty_keys );
+            _pending_dirty_keys.clear();
+            const bool revalidate_all = _revalidate_all_pending;
+            _revalidate_all_pending = false;
+
+            unordered_map<transaction_id_type, pending_evaluation> previous_evaluations = std::move( _pending_evaluations );
+            _pending_evaluations.clear();
+
             unsigned num_pending_transaction_considered = 0;
-            auto itr = _pending_transaction_db.begin();
-            while( itr.valid() )
+            unsigned num_pending_transaction_reused = 0;
+            for( const auto& item : _pending_pool.entries() )
             {
-                signed_transaction trx = itr.value();
-                const transaction_id_type trx_id = itr.key();
-                assert(trx_id == trx.id());
+                const transaction_id_type& trx_id = item.first;
                 try
                 {
-                  transaction_evaluation_state_ptr eval_state = self->evaluate_transaction( trx, _relay_fee );
+                  transaction_evaluation_state_ptr eval_state;
+                  const auto prev_iter = previous_evaluations.find( trx_id );
+                  if( prev_iter != previous_evaluations.end() )
+                  {
+                      const pending_evaluation& evaluation = prev_iter->second;
+                      const signed_transaction& trx = evaluation.eval_state->trx;
+                      if( !revalidate_all && evaluation.reusable
+                          && !evaluation.reads->intersects( dirty_keys )
+                          && !evaluation.writes->intersects( dirty_keys )
+                          && _pending_trx_state->now() < trx.expiration
+                          && !_pending_trx_state->is_known_transaction( trx ) )
+                      {
+                          evaluation.changes->set_prev_state( _pending_trx_state );
+                          evaluation.changes->apply_changes();
+                          eval_state = evaluation.eval_state;
+                          _pending_evaluations[ trx_id ] = evaluation;
+                          _pending_pool.note_revalidated( true );
+                          ++num_pending_transaction_reused;
+                      }
+                      else
+                      {
+                          dirty_keys.add( *evaluation.writes );
+                          eval_state = evaluate_pending_transaction( trx, _relay_fee, true );
+                          dirty_keys.add( *_pending_evaluations.at( trx_id ).writes );
+                          _pending_pool.note_revalidated( false );
+                          ilog( "revalidated pending transaction id ${id}", ("id", trx_id) );
+                      }
+                  }
+                  else
+                  {
+                      eval_state = evaluate_pending_transaction( item.second.trx, _relay_fee, true );
+                      dirty_keys.add( *_pending_evaluations.at( trx_id ).writes );
+                      ilog( "revalidated pending transaction id ${id}", ("id", trx_id) );
+                  }
+
                   const share_type fees = eval_state->total_base_equivalent_fees_paid;
                   _pending_fee_index[ fee_index( fees, trx_id ) ] = eval_state;
-                  ilog( "revalidated pending transaction id ${id}", ("id", trx_id) );
+                  _pending_pool.update( trx_id, fees, eval_state->signed_addresses );
                 }
                 catch ( const fc::canceled_exception& )
                 {
@@ -64,16 +138,131 @@ namespace bts { namespace blockchain {
                         ("id",trx_id)("e",e.to_detail_string()) );
                 }
                 ++num_pending_transaction_considered;
-                ++itr;
             }
 
             for( const auto& item : trx_to_discard )
-                _pending_transaction_db.remove( item );
-            ilog("revalidate_pending complete, there are now ${pending_count} evaluated transactions, ${num_pending_transaction_considered} raw transactions",
+            {
+                _pending_pool.remove( item );
+                _pending_signature_cache.erase( item );
+            }
+            ilog("revalidate_pending complete, there are now ${pending_count} evaluated transactions, ${num_pending_transaction_considered} raw transactions, ${num_pending_transaction_reused} reused",
                  ("pending_count", _pending_fee_index.size())
-                 ("num_pending_transaction_considered", num_pending_transaction_considered));
+                 ("num_pending_transaction_considered", num_pending_transaction_considered)
+                 ("num_pending_transaction_reused", num_pending_transaction_reused));
       }
 
+      transaction_evaluation_state_ptr chain_database_impl::evaluate_pending_transaction( const signed_transaction& trx,
+                                                                                          const share_type required_fees,
+                                                                                          const bool reusable,
+                                                                                          const bool check_pool_limits )
+      { try {
+          if( !_pending_trx_state )
+              _pending_trx_state = std::make_shared<pending_chain_state>( self->shared_from_this() );
+
+          const transaction_id_type trx_id = trx.id();
+
+          pending_evaluation evaluation;
+          evaluation.reads = std::make_shared<pending_read_set>();
+          evaluation.changes = std::make_shared<pending_chain_state>( _pending_trx_state );
+          evaluation.changes->track_reads( evaluation.reads );
+          evaluation.eval_state = std::make_shared<transaction_evaluation_state>( evaluation.changes );
+
+          const auto signature_iter = _pending_signature_cache.find( trx_id );
+          const bool signatures_cached = signature_iter != _pending_signature_cache.end();
+          if( signatures_cached )
+              evaluation.eval_state->_preverified_signed_addresses = signature_iter->second;
+
+          evaluation.eval_state->evaluate( trx );
+          evaluation.changes->track_reads( nullptr );
+
+          const share_type fees = evaluation.eval_state->total_base_equivalent_fees_paid;
+          if( fees < required_fees )
+          {
+              ilog("Transaction ${id} needed relay fee ${required_fees} but only had ${fees}", ("id", trx_id)("required_fees",required_fees)("fees",fees));
+              FC_CAPTURE_AND_THROW( insufficient_relay_fee, (fees)(required_fees) );
+          }
+
+          if( check_pool_limits )
+          {
+              try
+              {
+                  _pending_pool.check_admission( fc::raw::pack_size( trx ), fees, evaluation.eval_state->signed_addresses );
+              }
+              catch( const insufficient_relay_fee& )
+              {
+                  _pending_pool.note_rejected();
+                  throw;
+              }
+          }
+
+          if( !signatures_cached )
+              _pending_signature_cache[ trx_id ] = evaluation.eval_state->signed_addresses;
+
+          // apply changes from this transaction to _pending_trx_state
+          evaluation.changes->apply_changes();
+
+          evaluation.writes = std::make_shared<pending_read_set>();
+          evaluation.writes->add_writes( *evaluation.changes );
+          evaluation.reusable = reusable;
+          _pending_evaluations[ trx_id ] = evaluation;
+
+          return evaluation.eval_state;
+      } FC_CAPTURE_AND_RETHROW( (trx)(required_fees)(reusable)(check_pool_limits) ) }
+
+      void chain_database_impl::forget_pending_transaction( const transaction_id_type& trx_id )
+      {
+          _pending_pool.remove( trx_id );
+          _pending_signature_cache.erase( trx_id );
+
+          const auto iter = _pending_evaluations.find( trx_id );
+          if( iter != _pending_evaluations.end() )
+          {
+              _pending_fee_index.erase( fee_index( iter->second.eval_state->total_base_equivalent_fees_paid, trx_id ) );
+              _pending_dirty_keys.add( *iter->second.writes );
+              _pending_evaluations.erase( iter );
+          }
+      }
+
+      void chain_database_impl::recover_pending_signatures()
+      { try {
+          vector<signed_transaction> trxs;
+          for( const auto& item : _pending_pool.entries() )
+          {
+              if( _pending_signature_cache.count( item.first ) == 0 )
+                  trxs.push_back( item.second.trx );
+          }
+          if( trxs.empty() ) return;
+
+          const digest_type chain_id = self->get_chain_id();
+          vector<fc::future<set<address>>> recovered;
+          recovered.reserve( trxs.size() );
+          for( uint32_t i = 0; i < trxs.size(); ++i )
+          {
+              const signed_transaction& trx = trxs.at( i );
+              fc::thread* verification_thread = _verification_threads[ i % _verification_threads.size() ].get();
+              recovered.push_back( verification_thread->async( [ trx, chain_id ]()
+              {
+                  return transaction_evaluation_state::recover_signed_addresses( trx, chain_id );
+              }, "recover_pending_signatures" ) );
+          }
+
+          for( uint32_t i = 0; i < trxs.size(); ++i )
+          {
+              // Leave failures uncached; evaluation will report the error when the transaction is discarded
+              try
+              {
+                  _pending_signature_cache[ trxs.at( i ).id() ] = recovered.at( i ).wait();
+              }
+              catch( const fc::canceled_exception& )
+              {
+                  throw;
+              }
+              catch( const fc::exception& )
+              {
+              }
+          }
+      } FC_CAPTURE_AND_RETHROW() }
+
       void chain_database_impl::load_checkpoints( const fc::path& data_dir )const
       { try {
           for( const auto& item : CHECKPOINT_BLOCKS )
@@ -150,8 +339,10 @@ namespace bts { namespace blockchain {
 
       void chain_database_impl::open_database( const fc::path& data_dir )
       { try {
+          _block_log.open( data_dir / "raw_chain/block_log" );
           _block_id_to_full_block.open( data_dir / "raw_chain/block_id_to_block_data_db" );
-          _block_id_to_undo_state.open( data_dir / "index/block_id_to_undo_state" );
+          _block_id_to_block_num.open( data_dir / "index/block_id_to_block_num" );
+          _block_id_to_undo_state.open( data_dir / "index/block_id_to_undo_state", _state_cache_entries );
 
           _fork_number_db.open( data_dir / "index/fork_number_db" );
           _fork_db.open( data_dir / "index/fork_db" );
@@ -164,19 +355,19 @@ namespace bts { namespace blockchain {
 
           _property_id_to_record.open( data_dir / "index/property_id_to_record" );
 
-          _account_id_to_record.open( data_dir / "index/account_id_to_record" );
-          _account_name_to_id.open( data_dir / "index/account_name_to_id" );
-          _account_address_to_id.open( data_dir / "index/account_address_to_id" );
+          _account_id_to_record.open( data_dir / "index/account_id_to_record", _state_cache_entries );
+          _account_name_to_id.open( data_dir / "index/account_name_to_id", _state_cache_entries );
+          _account_address_to_id.open( data_dir / "index/account_address_to_id", _state_cache_entries );
 
           _asset_id_to_record.open( data_dir / "index/asset_id_to_record" );
           _asset_symbol_to_id.open( data_dir / "index/asset_symbol_to_id" );
 
           _slate_id_to_record.open( data_dir / "index/slate_id_to_record" );
 
-          _balance_id_to_record.open( data_dir / "index/balance_id_to_record" );
+          _balance_id_to_record.open( data_dir / "index/balance_id_to_record", _state_cache_entries );
 
           _transaction_id_to_record.open( data_dir / "index/transaction_id_to_record" );
-          _address_to_transaction_ids.open( data_dir / "index/address_to_transaction_ids" );
+          _address_transaction_index.open( data_dir / "index/address_transaction_index" );
 
           _burn_index_to_record.open( data_dir / "index/burn_index_to_record" );
 
@@ -186,7 +377,22 @@ namespace bts { namespace blockchain {
 
           _market_transactions_db.open( data_dir / "index/market_transactions_db" );
 
-          _pending_transaction_db.open( data_dir / "index/pending_transaction_db" );
+          if( _pending_journal_enabled )
+          {
+              _pending_transaction_journal.open( data_dir / "index/pending_transaction_db" );
+              for( auto itr = _pending_transaction_journal.begin(); itr.valid(); ++itr )
+              {
+                  // Fees and signers are filled in when the pool is next revalidated
+                  try
+                  {
+                      _pending_pool.insert( itr.key(), itr.value(), 0, set<address>(), false );
+                  }
+                  catch( const fc::exception& e )
+                  {
+                      wlog( "Dropping journaled pending transaction ${id}: ${e}", ("id",itr.key())("e",e.to_string()) );
+                  }
+              }
+          }
 
           _ask_db.open( data_dir / "index/ask_db" );
           _bid_db.open( data_dir / "index/bid_db" );
@@ -203,8 +409,27 @@ namespace bts { namespace blockchain {
           clear_invalidation_of_future_blocks();
       } FC_CAPTURE_AND_RETHROW( (data_dir) ) }
 
+      /** Empties the in-memory indexes kept alongside the databases */
+      void chain_database_impl::clear_indexes()
+      {
+          _delegate_votes.clear();
+          _balance_owner_index.clear();
+          _unique_transactions.clear();
+          _nested_feed_map.clear();
+          _active_feed_price_cache.clear();
+          _short_limit_index.clear();
+          _collateral_expiration_index.clear();
+          _market_depth.clear();
+          _stale_market_depth.clear();
+          _market_history_by_pair.clear();
+          _market_history_by_owner.clear();
+          _recent_operations.clear();
+      }
+
       void chain_database_impl::populate_indexes()
       { try {
+          clear_indexes();
+
           for( auto iter = _account_id_to_record.unordered_begin();
                iter != _account_id_to_record.unordered_end(); ++iter )
           {
@@ -213,6 +438,13 @@ namespace bts { namespace blockchain {
                   _delegate_votes.emplace( record.net_votes(), record.id );
           }
 
+          for( auto iter = _balance_id_to_record.unordered_begin();
+               iter != _balance_id_to_record.unordered_end(); ++iter )
+          {
+              for( const address& owner : iter->second.owners() )
+                  _balance_owner_index[ owner ].insert( iter->first );
+          }
+
           for( auto iter = _transaction_id_to_record.begin(); iter.valid(); ++iter )
           {
               const transaction& trx = iter.value().trx;
@@ -233,6 +465,28 @@ namespace bts { namespace blockchain {
               const expiration_index index{ key.order_price.quote_asset_id, record.expiration, key };
               _collateral_expiration_index.insert( index );
           }
+
+          for( auto iter = _bid_db.begin(); iter.valid(); ++iter )
+              adjust_market_depth( bid_order, iter.key(), iter.value(), 1 );
+          for( auto iter = _ask_db.begin(); iter.valid(); ++iter )
+              adjust_market_depth( ask_order, iter.key(), iter.value(), 1 );
+          for( auto iter = _short_db.begin(); iter.valid(); ++iter )
+              adjust_market_depth( short_order, iter.key(), iter.value(), 1 );
+          for( auto iter = _collateral_db.begin(); iter.valid(); ++iter )
+              adjust_market_depth( iter.key(), iter.value(), 1 );
+          _market_depth.discard_changes( _head_block_header.block_num );
+
+          // Reads every market transaction ever stored, even when the state maps are bounded
+          for( auto iter = _market_transactions_db.begin(); iter.valid(); ++iter )
+              index_market_transactions( iter.key(), iter.value(), true );
+
+          for( auto iter = _short_db.begin(); iter.valid(); ++iter )
+          {
+              const market_index_key& key = iter.key();
+              const order_record& order = iter.value();
+              if( order.limit_price.valid() )
+                  _short_limit_index[ key.order_price.asset_pair() ].insert( { *order.limit_price, key } );
+          }
       } FC_CAPTURE_AND_RETHROW() }
 
       void chain_database_impl::clear_invalidation_of_future_blocks()
@@ -428,10 +682,19 @@ namespace bts { namespace blockchain {
          return vector<block_id_type>();
       } FC_CAPTURE_AND_RETHROW( (block_num) ) }
 
-      void chain_database_impl::clear_pending( const full_block& block_data )
+      void chain_database_impl::clear_pending( const full_block& block_data, const pending_chain_state_ptr& block_state )
       { try {
          for( const signed_transaction& trx : block_data.user_transactions )
-            _pending_transaction_db.remove( trx.id() );
+            forget_pending_transaction( trx.id() );
+
+         // There is no point tracking what changed if everything is going to be re-evaluated anyway
+         if( _head_block_header.block_num < LAST_CHECKPOINT_BLOCK_NUM )
+             _revalidate_all_pending = true;
+
+         if( _revalidate_all_pending )
+             _pending_dirty_keys.clear();
+         else
+             _pending_dirty_keys.add_writes( *block_state );
 
          _pending_fee_index.clear();
          _pending_trx_state = std::make_shared<pending_chain_state>( self->shared_from_this() );
@@ -470,7 +733,7 @@ namespace bts { namespace blockchain {
                 _fork_db.store( next_id, record );
 
                 //keep one of the block ids of the current block number being processed (simplify this code)
-                const full_block& next_block = _block_id_to_full_block.fetch( next_id );
+                const full_block next_block = self->get_block( next_id );
                 if( next_block.block_num > highest_block_num )
                 {
                     highest_block_num = next_block.block_num;
@@ -543,6 +806,7 @@ namespace bts { namespace blockchain {
 
           // first of all store this block at the given block number
           _block_id_to_full_block.store( block_id, block_data );
+          _block_id_to_block_num.store( block_id, block_data.block_num );
 
           if( self->get_statistics_enabled() )
           {
@@ -710,16 +974,30 @@ namespace bts { namespace blockchain {
       } FC_CAPTURE_AND_RETHROW( (block_id) ) }
 
       void chain_database_impl::apply_transactions( const full_block& block_data,
-                                                    const pending_chain_state_ptr& pending_state )const
+                                                    const pending_chain_state_ptr& pending_state,
+                                                    const optional<preverified_block>& preverified )const
       { try {
+         timing_histogram& apply_transaction_timer = block_timer( "apply_transaction" );
          uint32_t trx_num = 0;
          for( const auto& trx : block_data.user_transactions )
          {
+            scoped_timer transaction_timer( apply_transaction_timer );
+
             transaction_evaluation_state_ptr trx_eval_state = std::make_shared<transaction_evaluation_state>( pending_state );
             trx_eval_state->_skip_signature_check = !self->_verify_transaction_signatures;
+            trx_eval_state->_record_operation_times = true;
+            if( preverified.valid() && trx_num < preverified->signed_addresses.size() )
+                trx_eval_state->_preverified_signed_addresses = preverified->signed_addresses.at( trx_num );
             trx_eval_state->evaluate( trx );
 
-            const transaction_id_type& trx_id = trx.id();
+            for( uint32_t op_num = 0; op_num < trx_eval_state->_operation_times.size(); ++op_num )
+            {
+                const operation_type_enum op_type = trx.operations.at( op_num ).type;
+                operation_timer( op_type ).record( trx_eval_state->_operation_times.at( op_num ) );
+            }
+
+            const transaction_id_type& trx_id = preverified.valid() ? preverified->digest.user_transaction_ids.at( trx_num )
+                                                                    : trx.id();
             otransaction_record record = pending_state->lookup<transaction_record>( trx_id );
             FC_ASSERT( record.valid() );
             record->chain_location = transaction_location( block_data.block_num, trx_num );
@@ -729,6 +1007,37 @@ namespace bts { namespace blockchain {
          }
       } FC_CAPTURE_AND_RETHROW() }
 
+      timing_histogram& chain_database_impl::operation_timer( const operation_type_enum type )const
+      {
+          if( type >= _operation_timers.size() )
+              _operation_timers.resize( type + 1, nullptr );
+
+          timing_histogram*& timer = _operation_timers[ type ];
+          if( timer == nullptr )
+              timer = &block_timer( string( "operation/" ) + fc::reflector<operation_type_enum>::to_string( type ) );
+          return *timer;
+      }
+
+      timing_histogram& chain_database_impl::market_timer( const std::pair<asset_id_type, asset_id_type>& market_pair )const
+      {
+          const auto iter = _market_timers.find( market_pair );
+          if( iter != _market_timers.end() )
+              return *iter->second;
+
+          // Anyone can create a market, so only the first ones seen get their own histogram
+          if( _market_timers.size() >= BTS_BLOCKCHAIN_MAX_TIMED_MARKETS )
+          {
+              if( _other_markets_timer == nullptr )
+                  _other_markets_timer = &block_timer( "execute_market/other" );
+              return *_other_markets_timer;
+          }
+
+          timing_histogram& timer = block_timer( "execute_market/" + std::to_string( market_pair.first.value )
+                                                 + ":" + std::to_string( market_pair.second.value ) );
+          _market_timers.emplace( market_pair, &timer );
+          return timer;
+      }
+
       void chain_database_impl::pay_delegate( const block_id_type& block_id,
                                               const public_key_type& block_signee,
                                               const pending_chain_state_ptr& pending_state,
@@ -798,6 +1107,120 @@ namespace bts { namespace blockchain {
           _block_id_to_undo_state.store( block_id, *undo_state );
       } FC_CAPTURE_AND_RETHROW( (block_num)(block_id) ) }
 
+      fc::future<preverified_block> chain_database_impl::preverify_block( const block_id_type& block_id, const full_block& block_data )
+      {
+          const auto iter = _preverified_blocks.find( block_id );
+          if( iter != _preverified_blocks.end() )
+              return iter->second;
+
+          const digest_type chain_id = self->get_chain_id();
+          const bool recover_block_signee = block_data.block_num > LAST_CHECKPOINT_BLOCK_NUM;
+          const bool recover_transaction_signees = self->_verify_transaction_signatures;
+
+          fc::thread* verification_thread = _verification_threads[ block_data.block_num % _verification_threads.size() ].get();
+          fc::future<preverified_block> result = verification_thread->async( [ = ]() -> preverified_block
+          {
+              const time_point start_time = time_point::now();
+
+              preverified_block verified;
+              verified.id = block_id;
+              verified.block_num = block_data.block_num;
+              verified.digest = digest_block( block_data );
+
+              // Leave anything we fail to recover unset; extend_chain will report the error in the usual place
+              if( recover_block_signee )
+              {
+                  try
+                  {
+                      verified.signee = block_data.signee();
+                  }
+                  catch( const fc::exception& )
+                  {
+                  }
+              }
+
+              if( recover_transaction_signees )
+              {
+                  verified.signed_addresses.reserve( block_data.user_transactions.size() );
+                  for( const signed_transaction& trx : block_data.user_transactions )
+                  {
+                      optional<set<address>> addresses;
+                      try
+                      {
+                          addresses = transaction_evaluation_state::recover_signed_addresses( trx, chain_id );
+                      }
+                      catch( const fc::exception& )
+                      {
+                      }
+                      verified.signed_addresses.push_back( std::move( addresses ) );
+                  }
+              }
+
+              verified.recovery_time = time_point::now() - start_time;
+              return verified;
+          }, "preverify_block" );
+
+          _preverified_blocks[ block_id ] = result;
+          return result;
+      }
+
+      /**
+       *  Returns the preverified data for the block if it has finished computing, without yielding.
+       *  The data is only trusted if the recovered transaction ids match the header's digest, which
+       *  guarantees it was computed from the same transactions we are about to apply.
+       */
+      optional<preverified_block> chain_database_impl::take_preverified_block( const block_id_type& block_id )
+      {
+          optional<preverified_block> verified;
+
+          const auto iter = _preverified_blocks.find( block_id );
+          if( iter == _preverified_blocks.end() )
+              return verified;
+
+          if( iter->second.ready() )
+          {
+              try
+              {
+                  verified = iter->second.wait();
+                  if( !verified->digest.validate_digest() )
+                      verified.reset();
+              }
+              catch( const fc::exception& )
+              {
+                  verified.reset();
+              }
+          }
+          _preverified_blocks.erase( iter );
+
+          // Drop results for blocks that will never be applied, e.g. stale forks
+          if( _preverified_blocks.size() > BTS_BLOCKCHAIN_PREVERIFY_BLOCK_WINDOW )
+          {
+              const uint32_t head_block_num = _head_block_header.block_num;
+              for( auto stale_iter = _preverified_blocks.begin(); stale_iter != _preverified_blocks.end(); )
+              {
+                  bool stale = false;
+                  if( stale_iter->second.ready() )
+                  {
+                      try
+                      {
+                          stale = stale_iter->second.wait().block_num <= head_block_num;
+                      }
+                      catch( const fc::exception& )
+                      {
+                          stale = true;
+                      }
+                  }
+
+                  if( stale )
+                      stale_iter = _preverified_blocks.erase( stale_iter );
+                  else
+                      ++stale_iter;
+              }
+          }
+
+          return verified;
+      }
+
       void chain_database_impl::verify_header( const digest_block& block_digest, const public_key_type& block_signee )const
       { try {
           if( block_digest.block_num > 1 && block_digest.block_num != _head_block_header.block_num + 1 )
@@ -971,6 +1394,7 @@ namespace bts { namespace blockchain {
           for( const auto& market_pair : dirty_markets )
           {
               FC_ASSERT( market_pair.first > market_pair.second );
+              scoped_timer timer( market_timer( market_pair ) );
               market_engine engine( pending_state, *this );
               if( engine.execute( market_pair.first, market_pair.second, timestamp ) )
               {
@@ -985,6 +1409,145 @@ namespace bts { namespace blockchain {
               debug_check_no_orders_overlap( pending_state );
       } FC_CAPTURE_AND_RETHROW( (timestamp) ) }
 
+      void chain_database_impl::adjust_market_depth( const order_type_enum type,
+                                                     const market_index_key& key,
+                                                     const order_record& order,
+                                                     const int32_t sign )
+      {
+          const asset_id_type quote_id = key.order_price.quote_asset_id;
+          const asset_id_type base_id = key.order_price.base_asset_id;
+
+          // Shorts are keyed by interest rate, so list them at their limit instead
+          price level_price = key.order_price;
+          if( type == short_order )
+              level_price = order.limit_price.valid() ? *order.limit_price : price( fc::uint128_t(), quote_id, base_id );
+
+          if( !_market_depth.adjust( type, quote_id, base_id, level_price, sign * order.balance, sign ) )
+              mark_market_depth_stale( quote_id, base_id );
+      }
+
+      void chain_database_impl::adjust_market_depth( const market_index_key& key,
+                                                     const collateral_record& collateral,
+                                                     const int32_t sign )
+      {
+          const asset_id_type quote_id = key.order_price.quote_asset_id;
+          const asset_id_type base_id = key.order_price.base_asset_id;
+          if( !_market_depth.adjust( cover_order, quote_id, base_id, key.order_price, sign * collateral.payoff_balance, sign ) )
+              mark_market_depth_stale( quote_id, base_id );
+      }
+
+      void chain_database_impl::mark_market_depth_stale( const asset_id_type quote_id, const asset_id_type base_id )
+      {
+          if( _stale_market_depth.emplace( quote_id, base_id ).second )
+              wlog( "Market depth for ${q}:${b} no longer matches its orders; rebuilding it", ("q",quote_id)("b",base_id) );
+      }
+
+      /** Rebuilds the stale markets from their order records; call once the block's records have been stored */
+      void chain_database_impl::resync_market_depth()
+      {
+          set<pair<asset_id_type, asset_id_type>> stale_markets;
+          stale_markets.swap( _stale_market_depth );
+
+          for( const auto& market : stale_markets )
+          {
+              const asset_id_type quote_id = market.first;
+              const asset_id_type base_id = market.second;
+              const market_index_key start( price( fc::uint128_t(), quote_id, base_id ) );
+              const auto in_market = [ & ]( const market_index_key& key )
+              {
+                  return key.order_price.quote_asset_id == quote_id && key.order_price.base_asset_id == base_id;
+              };
+
+              _market_depth.reset_market( quote_id, base_id );
+              for( auto iter = _bid_db.lower_bound( start ); iter.valid() && in_market( iter.key() ); ++iter )
+                  adjust_market_depth( bid_order, iter.key(), iter.value(), 1 );
+              for( auto iter = _ask_db.lower_bound( start ); iter.valid() && in_market( iter.key() ); ++iter )
+                  adjust_market_depth( ask_order, iter.key(), iter.value(), 1 );
+              for( auto iter = _short_db.lower_bound( start ); iter.valid() && in_market( iter.key() ); ++iter )
+                  adjust_market_depth( short_order, iter.key(), iter.value(), 1 );
+              for( auto iter = _collateral_db.lower_bound( start ); iter.valid() && in_market( iter.key() ); ++iter )
+                  adjust_market_depth( iter.key(), iter.value(), 1 );
+          }
+      }
+
+      void chain_database_impl::index_market_transactions( const uint32_t block_num,
+                                                           const vector<market_transaction>& trxs,
+                                                           const bool insert )
+      {
+          for( uint32_t seq = 0; seq < trxs.size(); ++seq )
+          {
+              const market_transaction& trx = trxs.at( seq );
+              const price& order_price = trx.ask_index.order_price;
+
+              const market_history_pair_index pair_index{ order_price.quote_asset_id, order_price.base_asset_id, block_num, seq };
+              const market_history_owner_index bid_owner_index{ trx.bid_index.owner, block_num, seq };
+              const market_history_owner_index ask_owner_index{ trx.ask_index.owner, block_num, seq };
+
+              if( insert )
+              {
+                  _market_history_by_pair.insert( pair_index );
+                  _market_history_by_owner.insert( bid_owner_index );
+                  _market_history_by_owner.insert( ask_owner_index );
+              }
+              else
+              {
+                  _market_history_by_pair.erase( pair_index );
+                  _market_history_by_owner.erase( bid_owner_index );
+                  _market_history_by_owner.erase( ask_owner_index );
+              }
+          }
+      }
+
+      active_feed_price_entry chain_database_impl::calculate_active_feed_price( const asset_id_type quote_id,
+                                                                                const time_point_sec now )const
+      { try {
+          active_feed_price_entry entry;
+          entry.valid_from = time_point::min();
+          entry.valid_until = time_point::maximum();
+
+          const auto outer_iter = _nested_feed_map.find( quote_id );
+          if( outer_iter == _nested_feed_map.end() )
+              return entry;
+
+          // TODO: Caller passes in delegate list
+          const vector<account_id_type>& delegate_ids = self->get_active_delegates();
+
+          vector<price> prices;
+          prices.reserve( delegate_ids.size() );
+
+          static const auto limit = fc::days( 1 );
+
+          const unordered_map<account_id_type, feed_record>& delegate_feeds = outer_iter->second;
+          for( const account_id_type delegate_id : delegate_ids )
+          {
+              const auto iter = delegate_feeds.find( delegate_id );
+              if( iter == delegate_feeds.end() ) continue;
+
+              const feed_record& record = iter->second;
+              if( record.value.quote_asset_id != quote_id ) continue;
+              if( record.value.base_asset_id != 0 ) continue;
+
+              const time_point expiration = time_point( record.last_update ) + limit;
+              if( time_point( now ) >= expiration )
+              {
+                  entry.valid_from = std::max( entry.valid_from, expiration );
+                  continue;
+              }
+
+              entry.valid_until = std::min( entry.valid_until, expiration );
+              prices.push_back( record.value );
+          }
+
+          if( prices.size() >= BTS_BLOCKCHAIN_MIN_FEEDS )
+          {
+              const auto midpoint = prices.size() / 2;
+              std::nth_element( prices.begin(), prices.begin() + midpoint, prices.end() );
+              entry.price = prices.at( midpoint );
+          }
+
+          return entry;
+      } FC_CAPTURE_AND_RETHROW( (quote_id)(now) ) }
+
       void chain_database_impl::debug_check_no_orders_overlap(
           const pending_chain_state_ptr& pending_state ) const
       {
@@ -1202,10 +1765,24 @@ namespace bts { namespace blockchain {
          }
          try
          {
+            scoped_timer block_timer_total( block_timer( "extend_chain" ) );
+
+            const optional<preverified_block> preverified = take_preverified_block( block_id );
+            if( preverified.valid() )
+                block_timer( "preverify_block" ).record( preverified->recovery_time );
+
             public_key_type block_signee;
             if( block_data.block_num > LAST_CHECKPOINT_BLOCK_NUM )
             {
-                block_signee = block_data.signee();
+                if( preverified.valid() && preverified->signee.valid() )
+                {
+                    block_signee = *preverified->signee;
+                }
+                else
+                {
+                    scoped_timer timer( block_timer( "recover_signee" ) );
+                    block_signee = block_data.signee();
+                }
             }
             else
             {
@@ -1218,7 +1795,10 @@ namespace bts { namespace blockchain {
             }
 
             // NOTE: Secret is validated later in update_delegate_production_info()
-            verify_header( digest_block( block_data ), block_signee );
+            {
+                scoped_timer timer( block_timer( "verify_header" ) );
+                verify_header( preverified.valid() ? preverified->digest : digest_block( block_data ), block_signee );
+            }
 
             // Create a pending state to track changes that would apply as we evaluate the block
             pending_chain_state_ptr pending_state = std::make_shared<pending_chain_state>( self->shared_from_this() );
@@ -1226,22 +1806,40 @@ namespace bts { namespace blockchain {
             /** Increment the blocks produced or missed for all delegates. This must be done
              *  before applying transactions because it depends upon the current active delegate order.
              **/
-            update_delegate_production_info( block_data, block_id, block_signee, pending_state );
+            {
+                scoped_timer timer( block_timer( "update_delegate_production_info" ) );
+                update_delegate_production_info( block_data, block_id, block_signee, pending_state );
+            }
 
             oblock_record block_record;
             if( self->get_statistics_enabled() ) block_record = self->get_block_record( block_id );
 
-            pay_delegate( block_id, block_signee, pending_state, block_record );
+            {
+                scoped_timer timer( block_timer( "pay_delegate" ) );
+                pay_delegate( block_id, block_signee, pending_state, block_record );
+            }
 
             if( block_data.block_num < BTS_V0_4_9_FORK_BLOCK_NUM )
-                apply_transactions( block_data, pending_state );
+            {
+                scoped_timer timer( block_timer( "apply_transactions" ) );
+                apply_transactions( block_data, pending_state, preverified );
+            }
 
-            execute_markets( block_data.timestamp, pending_state );
+            {
+                scoped_timer timer( block_timer( "execute_markets" ) );
+                execute_markets( block_data.timestamp, pending_state );
+            }
 
             if( block_data.block_num >= BTS_V0_4_9_FORK_BLOCK_NUM )
-                apply_transactions( block_data, pending_state );
+            {
+                scoped_timer timer( block_timer( "apply_transactions" ) );
+                apply_transactions( block_data, pending_state, preverified );
+            }
 
-            update_active_delegate_list( block_data.block_num, pending_state );
+            {
+                scoped_timer timer( block_timer( "update_active_delegate_list" ) );
+                update_active_delegate_list( block_data.block_num, pending_state );
+            }
 
             update_random_seed( block_data.previous_secret, pending_state, block_record );
 
@@ -1249,18 +1847,36 @@ namespace bts { namespace blockchain {
             pending_state->check_supplies();
 #endif
 
-            save_undo_state( block_data.block_num, block_id, pending_state );
+            {
+                scoped_timer timer( block_timer( "save_undo_state" ) );
+                save_undo_state( block_data.block_num, block_id, pending_state );
+            }
 
-            pending_state->apply_changes();
+            {
+                scoped_timer timer( block_timer( "apply_changes" ) );
+                pending_state->apply_changes();
+            }
 
             update_head_block( block_data, block_id );
+            resync_market_depth();
+            _market_depth.end_update( block_data.block_num );
 
             mark_included( block_id, true );
 
-            clear_pending( block_data );
+            {
+                scoped_timer timer( block_timer( "clear_pending" ) );
+                clear_pending( block_data, pending_state );
+            }
 
             _block_num_to_id_db.store( block_data.block_num, block_id );
 
+            // The block is part of the current chain now, so move it from the fork store to the block log
+            {
+                scoped_timer timer( block_timer( "store_block" ) );
+                _block_log.append( block_data, block_id );
+                _block_id_to_full_block.remove( block_id );
+            }
+
             // NOTE: None of the following hardfork changes can be rewound
 
             if( block_data.block_num == BTS_V0_4_16_FORK_BLOCK_NUM )
@@ -1367,13 +1983,19 @@ namespace bts { namespace blockchain {
          while( iter != _unique_transactions.end() && iter->expiration <= self->now() )
              iter = _unique_transactions.erase( iter );
 
+         schedule_state_snapshot( block_data, block_id );
+
          // Schedule the observer notifications for later; the chain is in a
          // non-premptable state right now, and observers may yield
          if( (blockchain::now() - block_data.timestamp).to_seconds() < BTS_BLOCKCHAIN_BLOCK_INTERVAL_SEC )
          {
              for( chain_observer* o : _observers )
              {
-                 fc::async( [ = ] { o->block_pushed( block_data ); }, "call_block_pushed_observer" );
+                 fc::async( [ = ]
+                 {
+                     scoped_timer timer( block_timer( "observer_dispatch" ) );
+                     o->block_pushed( block_data );
+                 }, "call_block_pushed_observer" );
              }
          }
       } FC_CAPTURE_AND_RETHROW() }
@@ -1430,16 +2052,23 @@ namespace bts { namespace blockchain {
          // update the block_num_to_block_id index
          _block_num_to_id_db.remove( _head_block_header.block_num );
 
+         // move the block back to the fork store
+         _block_id_to_full_block.store( _head_block_id, _block_log.fetch( _head_block_header.block_num ) );
+         _block_log.truncate( _head_block_header.block_num );
+
          auto previous_block_id = _head_block_header.previous;
 
-         const auto undo_iter = _block_id_to_undo_state.unordered_find( _head_block_id );
-         FC_ASSERT( undo_iter != _block_id_to_undo_state.unordered_end() );
-         const auto& undo_state = undo_iter->second;
+         const optional<pending_chain_state> undo_state = _block_id_to_undo_state.fetch_optional( _head_block_id );
+         FC_ASSERT( undo_state.valid() );
 
-         bts::blockchain::pending_chain_state_ptr undo_state_ptr = std::make_shared<bts::blockchain::pending_chain_state>( undo_state );
+         bts::blockchain::pending_chain_state_ptr undo_state_ptr = std::make_shared<bts::blockchain::pending_chain_state>( *undo_state );
          undo_state_ptr->set_prev_state( self->shared_from_this() );
          undo_state_ptr->apply_changes();
 
+         // Saved pending evaluations were made on top of the state we just rewound
+         _revalidate_all_pending = true;
+         _pending_dirty_keys.clear();
+
          _head_block_id = previous_block_id;
 
          if( _head_block_id == block_id_type() )
@@ -1447,6 +2076,9 @@ namespace bts { namespace blockchain {
          else
              _head_block_header = self->get_block_header( _head_block_id );
 
+         resync_market_depth();
+         _market_depth.end_update( _head_block_header.block_num );
+
          // Schedule the observer notifications for later; the chain is in a
          // non-premptable state right now, and observers may yield
          for( chain_observer* o : _observers )
@@ -1455,12 +2087,289 @@ namespace bts { namespace blockchain {
          }
       } FC_CAPTURE_AND_RETHROW() }
 
+      /**
+       *  Makes the block log match _block_num_to_id_db after an unclean shutdown, moving blocks between
+       *  the block log and the fork store as needed.
+       */
+      void chain_database_impl::sync_block_log()
+      { try {
+         const uint32_t head_block_num = _head_block_header.block_num;
+
+         while( _block_log.head_block_num() > 0 )
+         {
+             const uint32_t block_num = _block_log.head_block_num();
+             const block_id_type block_id = *_block_log.fetch_block_id( block_num );
+             const optional<block_id_type> chain_block_id = _block_num_to_id_db.fetch_optional( block_num );
+             if( block_num <= head_block_num && chain_block_id.valid() && *chain_block_id == block_id )
+                 break;
+
+             wlog( "Moving block ${n} ${id} from the block log back to the fork store", ("n",block_num)("id",block_id) );
+             _block_id_to_full_block.store( block_id, _block_log.fetch( block_num ) );
+             _block_log.truncate( block_num );
+         }
+
+         for( uint32_t block_num = _block_log.head_block_num() + 1; block_num <= head_block_num; ++block_num )
+         {
+             const block_id_type block_id = _block_num_to_id_db.fetch( block_num );
+             _block_log.append( _block_id_to_full_block.fetch( block_id ), block_id );
+             _block_id_to_full_block.remove( block_id );
+         }
+      } FC_CAPTURE_AND_RETHROW() }
+
+      template<typename Db>
+      static state_snapshot_db make_state_snapshot_db( const string& name, Db& db )
+      {
+         state_snapshot_db snapshot_db;
+         snapshot_db.name = name;
+         snapshot_db.iterate = [ &db ]() { return db.raw_iterator(); };
+         snapshot_db.restore = [ name ]( const fc::path& data_dir, state_snapshot_reader& reader )
+         {
+             Db restored;
+             restored.open( data_dir / name );
+
+             vector<std::pair<string, string>> entries;
+             string key;
+             string value;
+             while( reader.next_entry( key, value ) )
+             {
+                 entries.emplace_back( std::move( key ), std::move( value ) );
+                 if( entries.size() >= 10000 )
+                 {
+                     restored.store_raw( entries );
+                     entries.clear();
+                 }
+             }
+             restored.store_raw( entries );
+
+             restored.close();
+         };
+         return snapshot_db;
+      }
+
+      /** Every database under index/ except pending transactions; the in-memory indexes are rebuilt from these */
+      vector<state_snapshot_db> chain_database_impl::state_snapshot_dbs()
+      {
+         return vector<state_snapshot_db>
+         {
+             make_state_snapshot_db( "index/block_id_to_block_num", _block_id_to_block_num ),
+             make_state_snapshot_db( "index/block_id_to_undo_state", _block_id_to_undo_state ),
+
+             make_state_snapshot_db( "index/fork_number_db", _fork_number_db ),
+             make_state_snapshot_db( "index/fork_db", _fork_db ),
+
+             make_state_snapshot_db( "index/future_blocks_db", _revalidatable_future_blocks_db ),
+
+             make_state_snapshot_db( "index/block_id_to_block_record_db", _block_id_to_block_record_db ),
+
+             make_state_snapshot_db( "index/property_id_to_record", _property_id_to_record ),
+
+             make_state_snapshot_db( "index/account_id_to_record", _account_id_to_record ),
+             make_state_snapshot_db( "index/account_name_to_id", _account_name_to_id ),
+             make_state_snapshot_db( "index/account_address_to_id", _account_address_to_id ),
+
+             make_state_snapshot_db( "index/asset_id_to_record", _asset_id_to_record ),
+             make_state_snapshot_db( "index/asset_symbol_to_id", _asset_symbol_to_id ),
+
+             make_state_snapshot_db( "index/slate_id_to_record", _slate_id_to_record ),
+
+             make_state_snapshot_db( "index/balance_id_to_record", _balance_id_to_record ),
+
+             make_state_snapshot_db( "index/transaction_id_to_record", _transaction_id_to_record ),
+             make_state_snapshot_db( "index/address_transaction_index", _address_transaction_index ),
+
+             make_state_snapshot_db( "index/burn_index_to_record", _burn_index_to_record ),
+
+             make_state_snapshot_db( "index/status_index_to_record", _status_index_to_record ),
+
+             make_state_snapshot_db( "index/feed_index_to_record", _feed_index_to_record ),
+
+             make_state_snapshot_db( "index/market_transactions_db", _market_transactions_db ),
+
+             make_state_snapshot_db( "index/ask_db", _ask_db ),
+             make_state_snapshot_db( "index/bid_db", _bid_db ),
+             make_state_snapshot_db( "index/short_db", _short_db ),
+             make_state_snapshot_db( "index/collateral_db", _collateral_db ),
+
+             make_state_snapshot_db( "index/market_history_db", _market_history_db ),
+
+             make_state_snapshot_db( "index/slot_index_to_record", _slot_index_to_record ),
+             make_state_snapshot_db( "index/slot_timestamp_to_delegate", _slot_timestamp_to_delegate )
+         };
+      }
+
+      /**
+       *  Every BTS_BLOCKCHAIN_STATE_SNAPSHOT_INTERVAL blocks, saves the state as of the block that was just applied.
+       *  The iterators are created here, at the block boundary, and keep seeing the databases as they are now, so
+       *  the snapshot is written on a background thread while later blocks are applied.
+       */
+      void chain_database_impl::schedule_state_snapshot( const full_block& block_data, const block_id_type& block_id )
+      {
+         if( !_state_snapshots_enabled || block_data.block_num % BTS_BLOCKCHAIN_STATE_SNAPSHOT_INTERVAL != 0 )
+             return;
+
+         if( _state_snapshot.valid() && !_state_snapshot.ready() )
+         {
+             wlog( "Skipping state snapshot at block ${n} because the previous one is still being written", ("n",block_data.block_num) );
+             return;
+         }
+
+         try
+         {
+             state_snapshot_header header;
+             header.format_version = BTS_BLOCKCHAIN_STATE_SNAPSHOT_VERSION;
+             header.database_version = BTS_BLOCKCHAIN_DATABASE_VERSION;
+             header.block_num = block_data.block_num;
+             header.block_id = block_id;
+             header.timestamp = block_data.timestamp;
+
+             vector<std::pair<string, std::shared_ptr<leveldb::Iterator>>> sections;
+             for( const state_snapshot_db& db : state_snapshot_dbs() )
+                 sections.emplace_back( db.name, db.iterate() );
+
+             const fc::path filename = _data_dir / "state_snapshot";
+             _state_snapshot = _state_snapshot_thread->async( [ filename, header, sections ]() mutable
+             {
+                 try
+                 {
+                     state_snapshot_writer writer( filename, header );
+                     for( const auto& section : sections )
+                     {
+                         leveldb::Iterator& iter = *section.second;
+
+                         writer.begin_section( section.first );
+                         for( ; iter.Valid(); iter.Next() )
+                         {
+                             const leveldb::Slice key = iter.key();
+                             const leveldb::Slice value = iter.value();
+                             writer.add_entry( key.data(), uint32_t( key.size() ), value.data(), uint32_t( value.size() ) );
+                         }
+                         FC_ASSERT( iter.status().ok(), "error reading ${db}: ${msg}", ("db",section.first)("msg",iter.status().ToString()) );
+                         writer.end_section();
+                     }
+                     writer.finish();
+
+                     ilog( "Saved state snapshot at block ${n}", ("n",header.block_num) );
+                 }
+                 catch( const fc::exception& e )
+                 {
+                     elog( "Error saving state snapshot at block ${n}: ${e}", ("n",header.block_num)("e",e.to_detail_string()) );
+                 }
+
+                 // The iterators must not outlive the databases
+                 sections.clear();
+             }, "save_state_snapshot" );
+         }
+         catch( const fc::exception& e )
+         {
+             elog( "Error starting state snapshot at block ${n}: ${e}", ("n",block_data.block_num)("e",e.to_detail_string()) );
+         }
+      }
+
+      /**
+       *  Recreates the index databases from the last state snapshot if its block is still on the current chain.
+       *  On success the current chain is cut back to the snapshot block, and the ids of the blocks that followed
+       *  it are returned so that only those have to be pushed again.
+       */
+      bool chain_database_impl::restore_state_snapshot( const fc::path& data_dir, vector<block_id_type>& blocks_to_replay )
+      {
+         const fc::path filename = data_dir / "state_snapshot";
+         if( !fc::exists( filename ) )
+             return false;
+
+         try
+         {
+             wlog( "Database inconsistency detected; attempting to restore state snapshot" );
+
+             state_snapshot_reader reader( filename );
+             const state_snapshot_header& header = reader.header();
+             FC_ASSERT( header.format_version == BTS_BLOCKCHAIN_STATE_SNAPSHOT_VERSION, "unsupported state snapshot format" );
+             FC_ASSERT( header.database_version == BTS_BLOCKCHAIN_DATABASE_VERSION, "state snapshot is for a different database version" );
+
+             bts::db::level_map<uint32_t, block_id_type> block_num_to_id;
+             block_num_to_id.open( data_dir / "raw_chain/block_num_to_id_db" );
+
+             const optional<block_id_type> chain_block_id = block_num_to_id.fetch_optional( header.block_num );
+             FC_ASSERT( chain_block_id.valid() && *chain_block_id == header.block_id, "state snapshot block is not on the current chain" );
+
+             for( const auto& item : CHECKPOINT_BLOCKS )
+             {
+                 if( item.first > header.block_num ) break;
+                 const optional<block_id_type> block_id = block_num_to_id.fetch_optional( item.first );
+                 FC_ASSERT( !block_id.valid() || *block_id == item.second, "current chain fails checkpoint ${n}", ("n",item.first) );
+             }
+
+             fc::remove_all( data_dir / "index" );
+
+             map<string, state_snapshot_db> dbs;
+             for( state_snapshot_db& db : state_snapshot_dbs() )
+                 dbs[ db.name ] = std::move( db );
+
+             string name;
+             while( reader.next_section( name ) )
+             {
+                 const auto iter = dbs.find( name );
+                 FC_ASSERT( iter != dbs.end(), "unknown database ${name} in state snapshot", ("name",name) );
+                 iter->second.restore( data_dir, reader );
+                 dbs.erase( iter );
+             }
+             FC_ASSERT( dbs.empty(), "state snapshot is missing ${n} databases", ("n",dbs.size()) );
+
+             // sync_block_log() moves the blocks after the snapshot back into the fork store
+             vector<uint32_t> block_nums;
+             blocks_to_replay.clear();
+             for( auto iter = block_num_to_id.lower_bound( header.block_num + 1 ); iter.valid(); ++iter )
+             {
+                 block_nums.push_back( iter.key() );
+                 blocks_to_replay.push_back( iter.value() );
+             }
+             for( const uint32_t block_num : block_nums )
+                 block_num_to_id.remove( block_num );
+
+             ilog( "Restored state snapshot at block ${n}", ("n",header.block_num) );
+             return true;
+         }
+         catch( const fc::exception& e )
+         {
+             wlog( "Unable to restore state snapshot: ${e}", ("e",e.to_detail_string()) );
+         }
+
+         fc::remove_all( data_dir / "index" );
+         blocks_to_replay.clear();
+         return false;
+      }
+
+      /**
+       *  Pushes the blocks that followed the restored state snapshot. Each is taken out of the fork store first since
+       *  pushing stores it again; a missing block or one that does not extend the chain means the snapshot cannot be
+       *  brought up to date.
+       */
+      void chain_database_impl::replay_blocks_after_snapshot( const vector<block_id_type>& block_ids )
+      { try {
+         ilog( "Replaying ${x} blocks after the state snapshot", ("x",block_ids.size()) );
+         for( const block_id_type& block_id : block_ids )
+         {
+             const optional<full_block> block = _block_id_to_full_block.fetch_optional( block_id );
+             FC_ASSERT( block.valid(), "Block ${id} after the state snapshot is missing", ("id",block_id) );
+             _block_id_to_full_block.remove( block_id );
+
+             self->push_block( *block );
+             FC_ASSERT( _head_block_id == block_id, "Block ${id} after the state snapshot did not extend the chain", ("id",block_id) );
+         }
+      } FC_CAPTURE_AND_RETHROW( (block_ids.size()) ) }
+
    } // namespace detail
 
    chain_database::chain_database()
    :my( new detail::chain_database_impl() )
    {
       my->self = this;
+
+      const uint32_t num_verification_threads = std::max( 1u, std::thread::hardware_concurrency() );
+      my->_verification_threads.reserve( num_verification_threads );
+      for( uint32_t i = 0; i < num_verification_threads; ++i )
+          my->_verification_threads.push_back( std::unique_ptr<fc::thread>( new fc::thread( "chain_verifier_" + std::to_string( i ) ) ) );
+
+      my->_state_snapshot_thread.reset( new fc::thread( "chain_snapshot" ) );
    }
 
    chain_database::~chain_database()
@@ -1506,24 +2415,50 @@ namespace bts { namespace blockchain {
           now();
 
           my->load_checkpoints( data_dir.parent_path() );
+          my->_data_dir = data_dir;
+
+          bool replay_blockchain = my->replay_required( data_dir );
+          vector<block_id_type> blocks_to_replay;
+          const bool restored_snapshot = replay_blockchain && my->restore_state_snapshot( data_dir, blocks_to_replay );
+          if( restored_snapshot )
+              replay_blockchain = false;
 
-          if( !my->replay_required( data_dir ) )
+          if( !replay_blockchain )
           {
-              my->open_database( data_dir );
+              try
+              {
+                  my->open_database( data_dir );
+
+                  uint32_t head_block_num = 0;
+                  block_id_type head_block_id;
+                  my->_block_num_to_id_db.last( head_block_num, head_block_id );
+
+                  if( head_block_num > 0 )
+                  {
+                      my->_head_block_id = head_block_id;;
+                      my->_head_block_header = get_block_header( head_block_id );
+                  }
 
-              uint32_t head_block_num = 0;
-              block_id_type head_block_id;
-              my->_block_num_to_id_db.last( head_block_num, head_block_id );
+                  my->sync_block_log();
+                  my->populate_indexes();
 
-              if( head_block_num > 0 )
+                  if( !blocks_to_replay.empty() )
+                      my->replay_blocks_after_snapshot( blocks_to_replay );
+              }
+              catch( const fc::exception& e )
               {
-                  my->_head_block_id = head_block_id;;
-                  my->_head_block_header = get_block_header( head_block_id );
+                  if( !restored_snapshot ) throw;
+
+                  wlog( "Unable to bring the state snapshot up to date; replaying the whole blockchain: ${e}", ("e",e.to_detail_string()) );
+                  close();
+                  my->clear_indexes();
+                  my->_head_block_id = block_id_type();
+                  my->_head_block_header = signed_block_header();
+                  replay_blockchain = true;
               }
-
-              my->populate_indexes();
           }
-          else
+
+          if( replay_blockchain )
           {
               wlog( "Database inconsistency detected; erasing state and attempting to replay blockchain" );
 
@@ -1535,10 +2470,25 @@ namespace bts { namespace blockchain {
                       fc::rename( data_dir / "raw_chain/block_id_to_block_data_db", data_dir / "raw_chain/block_id_to_data_original" );
               }
 
+              if( fc::is_directory( data_dir / "raw_chain/block_log" ) )
+              {
+                  if( !fc::is_directory( data_dir / "raw_chain/block_log_original" ) )
+                      fc::rename( data_dir / "raw_chain/block_log", data_dir / "raw_chain/block_log_original" );
+                  else
+                      fc::remove_all( data_dir / "raw_chain/block_log" );
+              }
+
               // During replay we implement stop-and-copy garbage collection on the raw blocks
               decltype( my->_block_id_to_full_block ) block_id_to_data_original;
               block_id_to_data_original.open( data_dir / "raw_chain/block_id_to_data_original" );
-              const size_t original_size = fc::directory_size( data_dir / "raw_chain/block_id_to_data_original" );
+              size_t original_size = fc::directory_size( data_dir / "raw_chain/block_id_to_data_original" );
+
+              block_log block_log_original;
+              if( fc::is_directory( data_dir / "raw_chain/block_log_original" ) )
+              {
+                  block_log_original.open( data_dir / "raw_chain/block_log_original" );
+                  original_size += fc::directory_size( data_dir / "raw_chain/block_log_original" );
+              }
 
               my->open_database( data_dir );
               store_property_record( property_id_type::database_version, variant( BTS_BLOCKCHAIN_DATABASE_VERSION ) );
@@ -1648,10 +2598,27 @@ namespace bts { namespace blockchain {
                   }
               };
 
+              // Keep a window of blocks read ahead so their signatures are recovered in parallel
+              // on the verification threads while earlier blocks are being applied
+              std::deque<full_block> blocks_to_insert;
+              const auto queue_block = [&]( const full_block& block )
+              {
+                  preverify_block( block );
+                  blocks_to_insert.push_back( block );
+                  if( blocks_to_insert.size() > BTS_BLOCKCHAIN_PREVERIFY_BLOCK_WINDOW )
+                  {
+                      insert_block( blocks_to_insert.front() );
+                      blocks_to_insert.pop_front();
+                  }
+              };
+
               if( num_to_id.empty() )
               {
+                  for( uint32_t block_num = 1; block_num <= block_log_original.head_block_num(); ++block_num )
+                      queue_block( block_log_original.fetch( block_num ) );
+
                   for( auto block_itr = block_id_to_data_original.begin(); block_itr.valid(); ++block_itr )
-                      insert_block( block_itr.value() );
+                      queue_block( block_itr.value() );
               }
               else
               {
@@ -1659,13 +2626,24 @@ namespace bts { namespace blockchain {
                   if( last_known_block_num > BTS_BLOCKCHAIN_MAX_UNDO_HISTORY )
                       my->_min_undo_block = last_known_block_num - BTS_BLOCKCHAIN_MAX_UNDO_HISTORY;
 
+                  // Blocks of the old current chain are read sequentially from the old block log
                   for( const auto& num_id : num_to_id )
                   {
+                      const optional<block_id_type> log_block_id = block_log_original.fetch_block_id( num_id.first );
+                      if( log_block_id.valid() && *log_block_id == num_id.second )
+                      {
+                          queue_block( block_log_original.fetch( num_id.first ) );
+                          continue;
+                      }
+
                       const auto oblock = block_id_to_data_original.fetch_optional( num_id.second );
-                      if( oblock.valid() ) insert_block(*oblock);
+                      if( oblock.valid() ) queue_block(*oblock);
                   }
               }
 
+              for( ; !blocks_to_insert.empty(); blocks_to_insert.pop_front() )
+                  insert_block( blocks_to_insert.front() );
+
               // Re-enable flushing on all cached databases we disabled it on above
               toggle_leveldb( true );
               set_db_cache_write_through( true );
@@ -1673,7 +2651,12 @@ namespace bts { namespace blockchain {
               block_id_to_data_original.close();
               fc::remove_all( data_dir / "raw_chain/block_id_to_data_original" );
 
-              const size_t final_size = fc::directory_size( data_dir / "raw_chain/block_id_to_block_data_db" );
+              block_log_original.close();
+              fc::remove_all( data_dir / "raw_chain/block_log_original" );
+
+              my->_block_log.flush();
+              const size_t final_size = fc::directory_size( data_dir / "raw_chain/block_id_to_block_data_db" )
+                                        + fc::directory_size( data_dir / "raw_chain/block_log" );
 
               std::cout << "\rSuccessfully replayed " << blocks_indexed << " blocks in "
                         << (blockchain::now() - start_time).to_seconds() << " seconds.                          "
@@ -1683,22 +2666,10 @@ namespace bts { namespace blockchain {
           }
 
           // Process the pending transactions to cache by fees
-          for( auto pending_itr = my->_pending_transaction_db.begin(); pending_itr.valid(); ++pending_itr )
-          {
-             try
-             {
-                const auto trx = pending_itr.value();
-                const auto trx_id = trx.id();
-                const auto eval_state = evaluate_transaction( trx, my->_relay_fee );
-                const share_type fees = eval_state->total_base_equivalent_fees_paid;
-                my->_pending_fee_index[ fee_index( fees, trx_id ) ] = eval_state;
-                my->_pending_transaction_db.store( trx_id, trx );
-             }
-             catch( const fc::exception& e )
-             {
-                wlog( "Error processing pending transaction: ${e}", ("e",e.to_detail_string() ) );
-             }
-          }
+          my->_revalidate_all_pending = true;
+          my->revalidate_pending();
+
+          my->_state_snapshots_enabled = true;
       }
       catch( ... )
       {
@@ -1716,9 +2687,25 @@ namespace bts { namespace blockchain {
 
    void chain_database::close()
    { try {
-      my->_pending_transaction_db.close();
+      my->_state_snapshots_enabled = false;
+      if( my->_state_snapshot.valid() && !my->_state_snapshot.ready() )
+          my->_state_snapshot.wait();
 
+      if( my->_pending_transaction_journal.is_open() )
+      {
+          auto batch = my->_pending_transaction_journal.create_batch();
+          for( auto itr = my->_pending_transaction_journal.begin(); itr.valid(); ++itr )
+              batch.remove( itr.key() );
+          for( const auto& item : my->_pending_pool.entries() )
+              batch.store( item.first, item.second.trx );
+          batch.commit();
+          my->_pending_transaction_journal.close();
+      }
+      my->_pending_pool.clear();
+
+      my->_block_log.close();
       my->_block_id_to_full_block.close();
+      my->_block_id_to_block_num.close();
       my->_block_id_to_undo_state.close();
 
       my->_fork_number_db.close();
@@ -1744,7 +2731,7 @@ namespace bts { namespace blockchain {
       my->_balance_id_to_record.close();
 
       my->_transaction_id_to_record.close();
-      my->_address_to_transaction_ids.close();
+      my->_address_transaction_index.close();
 
       my->_burn_index_to_record.close();
 
@@ -1834,7 +2821,7 @@ namespace bts { namespace blockchain {
           FC_CAPTURE_AND_THROW( insufficient_relay_fee, (fees)(required_fees) );
       }
       // apply changes from this transaction to _pending_trx_state
-      pend_state->apply_changes();
+      pend_state->commit_changes();
 
       return trx_eval_state;
    } FC_CAPTURE_AND_RETHROW( (trx) ) }
@@ -1928,11 +2915,19 @@ namespace bts { namespace blockchain {
 
    full_block chain_database::get_block( const block_id_type& block_id )const
    { try {
+       const optional<uint32_t> block_num = my->_block_id_to_block_num.fetch_optional( block_id );
+       if( block_num.valid() )
+       {
+           const optional<full_block> block = my->_block_log.fetch_optional( *block_num, block_id );
+           if( block.valid() ) return *block;
+       }
        return my->_block_id_to_full_block.fetch( block_id );
    } FC_CAPTURE_AND_RETHROW( (block_id) ) }
 
    full_block chain_database::get_block( uint32_t block_num )const
    { try {
+       const optional<full_block> block = my->_block_log.fetch_optional( block_num );
+       if( block.valid() ) return *block;
        return get_block( get_block_id( block_num ) );
    } FC_CAPTURE_AND_RETHROW( (block_num) ) }
 
@@ -1995,6 +2990,10 @@ namespace bts { namespace blockchain {
                            ("head_block_num", head_block_num)("undo_history", BTS_BLOCKCHAIN_MAX_UNDO_HISTORY));
       }
 
+      // Recover signatures on a verification thread before taking the lock, so that fibers queued
+      // behind the lock (e.g. while syncing) do their elliptic curve work in parallel
+      my->preverify_block( block_data.id(), block_data ).wait();
+
       // only allow a single fiber attempt to push blocks at any given time,
       // this method is not re-entrant.
       fc::unique_lock<fc::mutex> lock( my->_push_block_mutex );
@@ -2030,7 +3029,7 @@ namespace bts { namespace blockchain {
       */
       if (longest_fork.second.can_link())
       {
-        full_block longest_fork_block = my->_block_id_to_full_block.fetch(longest_fork.first);
+        full_block longest_fork_block = get_block(longest_fork.first);
         uint32_t highest_unchecked_block_number = longest_fork_block.block_num;
         if (highest_unchecked_block_number > head_block_num)
         {
@@ -2071,6 +3070,11 @@ namespace bts { namespace blockchain {
       return *get_block_fork_data(block_id);
    } FC_CAPTURE_AND_RETHROW() }
 
+   void chain_database::preverify_block( const full_block& block_data )
+   { try {
+      my->preverify_block( block_data.id(), block_data );
+   } FC_CAPTURE_AND_RETHROW( (block_data) ) }
+
   std::vector<block_id_type> chain_database::get_fork_history( const block_id_type& id )
   {
     return my->get_fork_history(id);
@@ -2206,28 +3210,30 @@ namespace bts { namespace blockchain {
       if (override_limits)
         ilog("storing new local transaction with id ${id}", ("id", trx_id));
 
-      auto current_itr = my->_pending_transaction_db.find( trx_id );
-      if( current_itr.valid() )
+      if( my->_pending_pool.contains( trx_id ) )
         return nullptr;
 
-      share_type relay_fee = my->_relay_fee;
-      if( !override_limits )
-      {
-         if( my->_pending_fee_index.size() > BTS_BLOCKCHAIN_MAX_PENDING_QUEUE_SIZE )
-         {
-             auto overage = my->_pending_fee_index.size() - BTS_BLOCKCHAIN_MAX_PENDING_QUEUE_SIZE;
-             relay_fee = my->_relay_fee * overage * overage;
-         }
-      }
-
-      transaction_evaluation_state_ptr eval_state = evaluate_transaction( trx, relay_fee );
+      // Evaluated out of _pending_pool order, so revalidation must not reuse this result as is
+      transaction_evaluation_state_ptr eval_state = my->evaluate_pending_transaction( trx, my->_relay_fee, false,
+                                                                                      !override_limits );
       const share_type fees = eval_state->total_base_equivalent_fees_paid;
 
-      //if( fees < my->_relay_fee )
-      //   FC_CAPTURE_AND_THROW( insufficient_relay_fee, (fees)(my->_relay_fee) );
-
       my->_pending_fee_index[ fee_index( fees, trx_id ) ] = eval_state;
-      my->_pending_transaction_db.store( trx_id, trx );
+      const vector<transaction_id_type> evicted = my->_pending_pool.insert( trx_id, trx, fees, eval_state->signed_addresses,
+                                                                            override_limits );
+
+      if( !evicted.empty() )
+      {
+          // Their changes are still in the pending state, so rebuild it without them
+          for( const transaction_id_type& evicted_id : evicted )
+          {
+              ilog( "evicted pending transaction ${id} for ${new_id}", ("id",evicted_id)("new_id",trx_id) );
+              my->forget_pending_transaction( evicted_id );
+          }
+
+          if( !my->_revalidate_pending.valid() || my->_revalidate_pending.ready() )
+              my->_revalidate_pending = fc::async( [=](){ my->revalidate_pending(); }, "revalidate_pending" );
+      }
 
       return eval_state;
    } FC_CAPTURE_AND_RETHROW( (trx)(override_limits) ) }
@@ -2257,101 +3263,226 @@ namespace bts { namespace blockchain {
       size_t block_size = new_block.block_size();
       if( config.block_max_transaction_count > 0 && config.block_max_size > block_size )
       {
-          // Evaluate pending transactions
+          struct block_candidate
+          {
+              const signed_transaction*     trx = nullptr;
+              size_t                        size = 0;
+              pending_chain_state_ptr       changes;
+              pending_read_set_ptr          reads;
+              share_type                    fee = 0;
+              optional<fc::exception>       error;
+              bool                          evaluated = false;
+          };
+
+          // Filter on the transactions alone before spending any time evaluating them
           const vector<transaction_evaluation_state_ptr> pending_trx = get_pending_transactions();
+          vector<block_candidate> candidates;
+          candidates.reserve( pending_trx.size() );
           for( const transaction_evaluation_state_ptr& item : pending_trx )
           {
-              // Check block production time limit
-              if( time_point::now() - start_time >= config.block_max_production_time )
-                  break;
-
               const signed_transaction& new_transaction = item->trx;
-              try
+
+              // Check transaction size limit
+              const size_t transaction_size = new_transaction.data_size();
+              if( transaction_size > config.transaction_max_size )
               {
-                  // Check transaction size limit
-                  const size_t transaction_size = new_transaction.data_size();
-                  if( transaction_size > config.transaction_max_size )
-                  {
-                      wlog( "Excluding transaction ${id} of size ${size} because it exceeds transaction size limit ${limit}",
-                            ("id",new_transaction.id())("size",transaction_size)("limit",config.transaction_max_size) );
-                      continue;
-                  }
+                  wlog( "Excluding transaction ${id} of size ${size} because it exceeds transaction size limit ${limit}",
+                        ("id",new_transaction.id())("size",transaction_size)("limit",config.transaction_max_size) );
+                  continue;
+              }
 
-                  // Check block size limit
-                  if( block_size + transaction_size > config.block_max_size )
+              // Check transaction blacklist
+              if( !config.transaction_blacklist.empty() )
+              {
+                  const transaction_id_type id = new_transaction.id();
+                  if( config.transaction_blacklist.count( id ) > 0 )
                   {
-                      wlog( "Excluding transaction ${id} of size ${size} because block would exceed block size limit ${limit}",
-                            ("id",new_transaction.id())("size",transaction_size)("limit",config.block_max_size) );
+                      wlog( "Excluding blacklisted transaction ${id}", ("id",id) );
                       continue;
                   }
+              }
 
-                  // Check transaction blacklist
-                  if( !config.transaction_blacklist.empty() )
+              // Check operation blacklist
+              if( !config.operation_blacklist.empty() )
+              {
+                  optional<operation_type_enum> blacklisted_op;
+                  for( const operation& op : new_transaction.operations )
                   {
-                      const transaction_id_type id = new_transaction.id();
-                      if( config.transaction_blacklist.count( id ) > 0 )
+                      if( config.operation_blacklist.count( op.type ) > 0 )
                       {
-                          wlog( "Excluding blacklisted transaction ${id}", ("id",id) );
-                          continue;
+                          blacklisted_op = op.type;
+                          break;
                       }
                   }
+                  if( blacklisted_op.valid() )
+                  {
+                      wlog( "Excluding transaction ${id} because of blacklisted operation ${op}",
+                            ("id",new_transaction.id())("op",*blacklisted_op) );
+                      continue;
+                  }
+              }
 
-                  // Check operation blacklist
-                  if( !config.operation_blacklist.empty() )
+              block_candidate candidate;
+              candidate.trx = &new_transaction;
+              candidate.size = transaction_size;
+              candidates.push_back( std::move( candidate ) );
+          }
+
+          const bool canonical_signatures = config.transaction_canonical_signatures_required;
+          const auto evaluate_candidate = [ &pending_state, canonical_signatures ]( block_candidate& candidate,
+                                                                                   const optional<set<address>>& signed_addresses )
+          {
+              candidate.changes = std::make_shared<pending_chain_state>( pending_state );
+              candidate.reads = std::make_shared<pending_read_set>();
+              candidate.fee = 0;
+              candidate.error.reset();
+              candidate.evaluated = false;
+
+              candidate.changes->track_reads( candidate.reads );
+              try
+              {
+                  auto trx_eval_state = std::make_shared<transaction_evaluation_state>( candidate.changes );
+                  trx_eval_state->_enforce_canonical_signatures = canonical_signatures;
+                  trx_eval_state->_preverified_signed_addresses = signed_addresses;
+                  trx_eval_state->evaluate( *candidate.trx );
+                  candidate.fee = trx_eval_state->total_base_equivalent_fees_paid;
+              }
+              catch( const fc::canceled_exception& )
+              {
+                  candidate.changes->track_reads( nullptr );
+                  throw;
+              }
+              catch( const fc::exception& e )
+              {
+                  candidate.error = e;
+              }
+              candidate.changes->track_reads( nullptr );
+              candidate.evaluated = true;
+          };
+
+          // Signatures recovered when the transactions arrived do not say whether they were canonical
+          const auto cached_signatures = [ & ]( const block_candidate& candidate ) -> optional<set<address>>
+          {
+              if( canonical_signatures ) return optional<set<address>>();
+              const auto iter = my->_pending_signature_cache.find( candidate.trx->id() );
+              if( iter == my->_pending_signature_cache.end() ) return optional<set<address>>();
+              return iter->second;
+          };
+
+          // Bounded state maps fill their caches on lookup, so they cannot be read from several threads at once
+          const bool parallel = my->_state_cache_entries == 0 && my->_verification_threads.size() > 1;
+          const size_t window_size = parallel ? BTS_BLOCKCHAIN_SPECULATIVE_EVALUATION_WINDOW : 1;
+
+          /**
+           *  Evaluate a window of candidates at a time against the state as of the start of the window, in parallel
+           *  when possible, then pack them in fee order. A candidate that read anything written by one packed ahead
+           *  of it in the same window is evaluated again on the packed state, so the block is exactly what evaluating
+           *  the candidates one after another would have built. Fees are accumulated as commutative deltas, so
+           *  candidates that only share the fee asset do not conflict.
+           */
+          bool block_full = false;
+          uint32_t num_reevaluated = 0;
+          for( size_t window_begin = 0; window_begin < candidates.size() && !block_full; window_begin += window_size )
+          {
+              // Check block production time limit
+              if( time_point::now() - start_time >= config.block_max_production_time )
+                  break;
+
+              const size_t window_end = std::min( window_begin + window_size, candidates.size() );
+              if( window_end - window_begin == 1 )
+              {
+                  block_candidate& candidate = candidates.at( window_begin );
+                  evaluate_candidate( candidate, cached_signatures( candidate ) );
+              }
+              else
+              {
+                  vector<std::future<void>> finished;
+                  finished.reserve( window_end - window_begin );
+                  for( size_t i = window_begin; i < window_end; ++i )
                   {
-                      optional<operation_type_enum> blacklisted_op;
-                      for( const operation& op : new_transaction.operations )
+                      block_candidate& candidate = candidates.at( i );
+                      const optional<set<address>> signed_addresses = cached_signatures( candidate );
+
+                      // Block on a std::future instead of an fc::future so no other task can change the chain meanwhile
+                      const auto done = std::make_shared<std::promise<void>>();
+                      finished.push_back( done->get_future() );
+
+                      fc::thread* evaluation_thread = my->_verification_threads[ i % my->_verification_threads.size() ].get();
+                      evaluation_thread->async( [ &candidate, signed_addresses, evaluate_candidate, done ]()
                       {
-                          if( config.operation_blacklist.count( op.type ) > 0 )
+                          try
                           {
-                              blacklisted_op = op.type;
-                              break;
+                              evaluate_candidate( candidate, signed_addresses );
                           }
-                      }
-                      if( blacklisted_op.valid() )
+                          catch( ... )
+                          {
+                              // Only cancellation escapes; the candidate is left unevaluated and redone below
+                          }
+                          done->set_value();
+                      }, "evaluate_block_candidate" );
+                  }
+
+                  for( auto& result : finished )
+                      result.wait();
+              }
+
+              pending_read_set written;
+              for( size_t i = window_begin; i < window_end; ++i )
+              {
+                  block_candidate& candidate = candidates.at( i );
+                  const signed_transaction& new_transaction = *candidate.trx;
+
+                  if( !candidate.evaluated || candidate.reads->intersects( written ) )
+                  {
+                      if( time_point::now() - start_time >= config.block_max_production_time )
                       {
-                          wlog( "Excluding transaction ${id} because of blacklisted operation ${op}",
-                                ("id",new_transaction.id())("op",*blacklisted_op) );
-                          continue;
+                          block_full = true;
+                          break;
                       }
+                      if( window_end - window_begin > 1 ) ++num_reevaluated;
+                      evaluate_candidate( candidate, cached_signatures( candidate ) );
                   }
 
-                  // Validate transaction
-                  auto pending_trx_state = std::make_shared<pending_chain_state>( pending_state );
+                  if( candidate.error.valid() )
                   {
-                      auto trx_eval_state = std::make_shared<transaction_evaluation_state>( pending_trx_state );
-                      trx_eval_state->_enforce_canonical_signatures = config.transaction_canonical_signatures_required;
-                      trx_eval_state->evaluate( new_transaction );
+                      wlog( "Pending transaction was found to be invalid in context of block\n${trx}\n${e}",
+                            ("trx",fc::json::to_pretty_string( new_transaction ))("e",candidate.error->to_detail_string()) );
+                      continue;
+                  }
 
-                      // Check transaction fee limit
-                      const share_type transaction_fee = trx_eval_state->total_base_equivalent_fees_paid;
-                      if( transaction_fee < config.transaction_min_fee )
-                      {
-                          wlog( "Excluding transaction ${id} with fee ${fee} because it does not meet transaction fee limit ${limit}",
-                                ("id",new_transaction.id())("fee",transaction_fee)("limit",config.transaction_min_fee) );
-                          continue;
-                      }
+                  // Check transaction fee limit
+                  if( candidate.fee < config.transaction_min_fee )
+                  {
+                      wlog( "Excluding transaction ${id} with fee ${fee} because it does not meet transaction fee limit ${limit}",
+                            ("id",new_transaction.id())("fee",candidate.fee)("limit",config.transaction_min_fee) );
+                      continue;
+                  }
+
+                  // Check block size limit
+                  if( block_size + candidate.size > config.block_max_size )
+                  {
+                      wlog( "Excluding transaction ${id} of size ${size} because block would exceed block size limit ${limit}",
+                            ("id",new_transaction.id())("size",candidate.size)("limit",config.block_max_size) );
+                      continue;
                   }
 
                   // Include transaction
-                  pending_trx_state->apply_changes();
+                  written.add_writes( *candidate.changes );
+                  candidate.changes->commit_changes();
                   new_block.user_transactions.push_back( new_transaction );
-                  block_size += transaction_size;
+                  block_size += candidate.size;
 
                   // Check block transaction count limit
                   if( new_block.user_transactions.size() >= config.block_max_transaction_count )
+                  {
+                      block_full = true;
                       break;
-              }
-              catch( const fc::canceled_exception& )
-              {
-                  throw;
-              }
-              catch( const fc::exception& e )
-              {
-                  wlog( "Pending transaction was found to be invalid in context of block\n${trx}\n${e}",
-                        ("trx",fc::json::to_pretty_string( new_transaction ))("e",e.to_detail_string()) );
+                  }
               }
           }
+
+          ilog( "Packed ${packed} of ${count} candidate transactions, ${redone} evaluated again after a conflict",
+                ("packed",new_block.user_transactions.size())("count",candidates.size())("redone",num_reevaluated) );
       }
 
       const signed_block_header head_block = get_head_block();
@@ -2395,6 +3526,8 @@ namespace bts { namespace blockchain {
    uint32_t chain_database::get_block_num( const block_id_type& block_id )const
    { try {
        if( block_id == block_id_type() ) return 0;
+       const optional<uint32_t> block_num = my->_block_id_to_block_num.fetch_optional( block_id );
+       if( block_num.valid() ) return *block_num;
        return get_block( block_id ).block_num;
    } FC_CAPTURE_AND_RETHROW( (block_id) ) }
 
@@ -2411,12 +3544,15 @@ namespace bts { namespace blockchain {
    unordered_map<balance_id_type, balance_record> chain_database::get_balances_for_address( const address& addr )const
    { try {
         unordered_map<balance_id_type, balance_record> records;
-        const auto scan_balance = [ &addr, &records ]( const balance_record& record )
+        const auto index_iter = my->_balance_owner_index.find( addr );
+        if( index_iter == my->_balance_owner_index.end() )
+            return records;
+
+        for( const balance_id_type& balance_id : index_iter->second )
         {
-            if( record.is_owner( addr ) )
-                records[ record.id() ] = record;
-        };
-        scan_balances( scan_balance );
+            const obalance_record record = balance_lookup_by_id( balance_id );
+            if( record.valid() ) records[ balance_id ] = *record;
+        }
         return records;
    } FC_CAPTURE_AND_RETHROW( (addr) ) }
 
@@ -2431,22 +3567,22 @@ namespace bts { namespace blockchain {
             address( pts_address( key, false, 0 ) ),
             address( pts_address( key, true, 0 ) )
         };
-        const auto scan_balance = [ &addrs, &records ]( const balance_record& record )
+        for( const address& addr : addrs )
         {
-            const auto& owner = record.condition.owner();
-            if( !owner.valid() )
-                return;
+            const auto index_iter = my->_balance_owner_index.find( addr );
+            if( index_iter == my->_balance_owner_index.end() )
+                continue;
 
-            for( const address& addr : addrs )
+            for( const balance_id_type& balance_id : index_iter->second )
             {
-                if( addr == *owner )
-                {
-                    records[ record.id() ] = record;
-                    return;
-                }
+                // Only match balances with a single owner, e.g. not multisig balances that include this key
+                const obalance_record record = balance_lookup_by_id( balance_id );
+                if( !record.valid() ) continue;
+                const auto& owner = record->condition.owner();
+                if( owner.valid() && *owner == addr )
+                    records[ balance_id ] = *record;
             }
-        };
-        scan_balances( scan_balance );
+        }
         return records;
    } FC_CAPTURE_AND_RETHROW( (key) ) }
 
@@ -2488,9 +3624,8 @@ namespace bts { namespace blockchain {
       fc::time_point_sec start_time;
       std::map<uint32_t, vector<signed_block_header>> nodes_by_rank;
       //std::set<uint32_t> ranks_in_use;
-      for( auto block_itr = my->_block_id_to_full_block.begin(); block_itr.valid(); ++block_itr )
+      const auto add_block = [&]( const full_block& block )
       {
-        const full_block& block = block_itr.value();
         if (first)
         {
           first = false;
@@ -2504,7 +3639,13 @@ namespace bts { namespace blockchain {
           //ilog( "${id} => ${r}", ("id",fork_itr.key())("r",fork_data) );
           nodes_by_rank[rank].push_back(block);
         }
-      }
+      };
+
+      // The current chain comes from the block log and the blocks on other forks from the fork store
+      for( uint32_t block_num = std::max( start_block, 1u ); block_num <= std::min( end_block, my->_block_log.head_block_num() ); ++block_num )
+          add_block( my->_block_log.fetch( block_num ) );
+      for( auto block_itr = my->_block_id_to_full_block.begin(); block_itr.valid(); ++block_itr )
+          add_block( block_itr.value() );
 
       for( const auto& item : nodes_by_rank )
       {
@@ -2659,30 +3800,64 @@ namespace bts { namespace blockchain {
 
    void chain_database::store_bid_record( const market_index_key& key, const order_record& order )
    {
+      const auto existing = my->_bid_db.fetch_optional( key );
+      if( existing.valid() )
+         my->adjust_market_depth( bid_order, key, *existing, -1 );
+
       if( order.is_null() )
+      {
          my->_bid_db.remove( key );
+      }
       else
+      {
+         my->adjust_market_depth( bid_order, key, order, 1 );
          my->_bid_db.store( key, order );
+      }
    }
 
    void chain_database::store_ask_record( const market_index_key& key, const order_record& order )
    {
+      const auto existing = my->_ask_db.fetch_optional( key );
+      if( existing.valid() )
+         my->adjust_market_depth( ask_order, key, *existing, -1 );
+
       if( order.is_null() )
+      {
          my->_ask_db.remove( key );
+      }
       else
+      {
+         my->adjust_market_depth( ask_order, key, order, 1 );
          my->_ask_db.store( key, order );
+      }
    }
 
    void chain_database::store_short_record( const market_index_key& key, const order_record& order )
    {
+      auto existing = my->_short_db.fetch_optional( key );
+      if( existing && existing->limit_price.valid() )
+      {
+         const auto shorts = my->_short_limit_index.find( key.order_price.asset_pair() );
+         if( shorts != my->_short_limit_index.end() )
+         {
+            shorts->second.erase( { *existing->limit_price, key } );
+            if( shorts->second.empty() )
+               my->_short_limit_index.erase( shorts );
+         }
+      }
+      if( existing )
+         my->adjust_market_depth( short_order, key, *existing, -1 );
+
       if( order.is_null() )
       {
-         auto existing = my->_short_db.fetch_optional( key );
          if( existing )
             my->_short_db.remove( key );
       }
       else
       {
+         if( order.limit_price.valid() )
+            my->_short_limit_index[ key.order_price.asset_pair() ].insert( { *order.limit_price, key } );
+         my->adjust_market_depth( short_order, key, order, 1 );
          my->_short_db.store( key, order );
       }
    }
@@ -2696,6 +3871,8 @@ namespace bts { namespace blockchain {
          {
             my->_collateral_expiration_index.erase( {key.order_price.quote_asset_id,  old_record->expiration, key } );
          }
+         if( old_record )
+            my->adjust_market_depth( key, *old_record, -1 );
          my->_collateral_db.remove( key );
       }
       else
@@ -2706,6 +3883,9 @@ namespace bts { namespace blockchain {
             my->_collateral_expiration_index.erase( {key.order_price.quote_asset_id,  old_record->expiration, key } );
          }
          my->_collateral_expiration_index.insert( {key.order_price.quote_asset_id, collateral.expiration, key } );
+         if( old_record )
+            my->adjust_market_depth( key, *old_record, -1 );
+         my->adjust_market_depth( key, collateral, 1 );
          my->_collateral_db.store( key, collateral );
       }
    }
@@ -2879,6 +4059,51 @@ namespace bts { namespace blockchain {
        return results;
    } FC_CAPTURE_AND_RETHROW( (quote_symbol)(limit) ) }
 
+   vector<market_order> chain_database::get_margin_positions_at_risk( const asset_id_type quote_id,
+                                                                      uint32_t max_drop_percent,
+                                                                      uint32_t limit )const
+   { try {
+       FC_ASSERT( max_drop_percent <= 100 );
+       const asset_id_type base_id = 0;
+
+       const oasset_record quote_record = get_asset_record( quote_id );
+       FC_ASSERT( quote_record.valid() && quote_record->is_market_issued(), "Not a market issued asset!" );
+
+       const oprice feed_price = get_active_feed_price( quote_id );
+       FC_ASSERT( feed_price.valid(), "No active feed price for ${q}", ("q",quote_record->symbol) );
+
+       // Positions are called once their call price is above the feed
+       price threshold = *feed_price;
+       threshold.ratio *= 100 - max_drop_percent;
+       threshold.ratio /= 100;
+
+       // The collateral database is keyed by call price, so walk down from the highest one in the market
+       const price next_pair = (base_id+1 == quote_id) ? price( 0, quote_id+1, 0 ) : price( 0, quote_id, base_id+1 );
+       auto iter = my->_collateral_db.lower_bound( market_index_key( next_pair ) );
+       if( iter.valid() ) --iter;
+       else iter = my->_collateral_db.last();
+
+       vector<market_order> results;
+       for( ; iter.valid() && results.size() < limit; --iter )
+       {
+          const market_index_key& key = iter.key();
+          if( key.order_price.quote_asset_id != quote_id || key.order_price.base_asset_id != base_id )
+             break;
+
+          if( !(key.order_price > threshold) )
+             break;
+
+          const collateral_record& collateral = iter.value();
+          results.push_back( {cover_order,
+                              key,
+                              order_record(collateral.payoff_balance),
+                              collateral.collateral_balance,
+                              collateral.interest_rate,
+                              collateral.expiration } );
+       }
+       return results;
+   } FC_CAPTURE_AND_RETHROW( (quote_id)(max_drop_percent)(limit) ) }
+
    optional<market_order> chain_database::get_market_ask( const market_index_key& key )const
    { try {
        { // abs asks
@@ -3105,6 +4330,26 @@ namespace bts { namespace blockchain {
        return my->_unique_transactions.count( unique_transaction_key( trx, get_chain_id() ) ) > 0;
    } FC_CAPTURE_AND_RETHROW( (trx) ) }
 
+   void chain_database::set_state_cache_entries( uint32_t entries )
+   {
+      my->_state_cache_entries = entries;
+   }
+
+   void chain_database::set_pending_pool_limits( const uint64_t max_bytes, const uint32_t max_transactions_per_address )
+   {
+      my->_pending_pool.set_limits( max_bytes, max_transactions_per_address );
+   }
+
+   void chain_database::set_pending_journal_enabled( const bool enabled )
+   {
+      my->_pending_journal_enabled = enabled;
+   }
+
+   pending_pool_stats chain_database::get_pending_pool_stats()const
+   {
+      return my->_pending_pool.get_stats();
+   }
+
    void chain_database::set_relay_fee( share_type shares )
    {
       my->_relay_fee = shares;
@@ -3117,13 +4362,20 @@ namespace bts { namespace blockchain {
 
    void chain_database::set_market_transactions( vector<market_transaction> trxs )
    {
+      const uint32_t block_num = get_head_block_num() + 1;
+
+      const auto existing = my->_market_transactions_db.fetch_optional( block_num );
+      if( existing.valid() )
+         my->index_market_transactions( block_num, *existing, false );
+
       if( trxs.size() == 0 )
       {
-         my->_market_transactions_db.remove( get_head_block_num()+1 );
+         my->_market_transactions_db.remove( block_num );
       }
       else
       {
-         my->_market_transactions_db.store( get_head_block_num()+1, trxs );
+         my->index_market_transactions( block_num, trxs, true );
+         my->_market_transactions_db.store( block_num, trxs );
       }
    }
 
@@ -3139,86 +4391,96 @@ namespace bts { namespace blockchain {
                                                                      uint32_t skip_count,
                                                                      uint32_t limit,
                                                                      const address& owner)
-   {
+   { try {
       FC_ASSERT(limit <= 10000, "Limit must be at most 10000!");
+      FC_ASSERT(get_head_block_num() > 0, "No blocks have been created yet!");
 
-      uint32_t current_block_num = get_head_block_num();
-      const auto get_transactions_from_prior_block = [&]() -> vector<market_transaction>
-      {
-          auto itr = my->_market_transactions_db.lower_bound( current_block_num );
-          if( current_block_num == get_head_block_num() )
-              itr = my->_market_transactions_db.last();
+      vector<order_history_record> results;
+      results.reserve( limit );
 
-          if (itr.valid()) --itr;
-          if (itr.valid())
+      // Consecutive results usually come from the same block
+      uint32_t cached_block_num = 0;
+      vector<market_transaction> block_trxs;
+      fc::time_point_sec block_timestamp;
+
+      const auto add_result = [&]( const uint32_t block_num, const uint32_t seq ) -> bool
+      {
+          if( block_num != cached_block_num )
           {
-              current_block_num = itr.key();
-              return itr.value();
+              block_trxs = get_market_transactions( block_num );
+              block_timestamp = get_block_header( block_num ).timestamp;
+              cached_block_num = block_num;
           }
-          current_block_num = 1;
-          return vector<market_transaction>();
-      };
 
-      FC_ASSERT(current_block_num > 0, "No blocks have been created yet!");
-      auto orders = get_transactions_from_prior_block();
+          const market_transaction& trx = block_trxs.at( seq );
+          if( trx.ask_index.order_price.quote_asset_id != quote || trx.ask_index.order_price.base_asset_id != base )
+              return false;
 
-      std::function<bool(const market_transaction&)> order_is_uninteresting =
-          [&quote,&base,&owner,this](const market_transaction& order) -> bool
-      {
-          //If it's in the market pair we're interested in, it might be interesting or uninteresting
-          if( order.ask_index.order_price.base_asset_id == base
-              && order.ask_index.order_price.quote_asset_id == quote ) {
-            //If we're not filtering for a specific owner, it's interesting (not uninteresting)
-            if (owner == address())
+          if( skip_count > 0 )
+          {
+              --skip_count;
               return false;
-            //If neither the bidder nor the asker is the owner I'm looking for, it's uninteresting
-            return owner != order.bid_index.owner && owner != order.ask_index.owner;
           }
-          //If it's not the market pair we're interested in, it's definitely uninteresting
+
+          results.push_back( order_history_record( trx, block_timestamp ) );
           return true;
       };
-      //Filter out orders not in our current market of interest
-      orders.erase(std::remove_if(orders.begin(), orders.end(), order_is_uninteresting), orders.end());
-
-      //While the next entire block of orders should be skipped...
-      while( skip_count > 0 && --current_block_num > 0 && orders.size() <= skip_count ) {
-        ilog("Skipping ${num} block ${block} orders", ("num", orders.size())("block", current_block_num));
-        skip_count -= orders.size();
-        orders = get_transactions_from_prior_block();
-        orders.erase(std::remove_if(orders.begin(), orders.end(), order_is_uninteresting), orders.end());
-      }
 
-      if( current_block_num == 0 && orders.size() <= skip_count )
-        // Skip count is greater or equal to the total number of relevant orders on the blockchain.
-        return vector<order_history_record>();
-
-      //If there are still some orders from the last block inspected to skip, remove them
-      if( skip_count > 0 )
-        orders.erase(orders.begin(), orders.begin() + skip_count);
-      ilog("Building up order history, got ${num} so far...", ("num", orders.size()));
+      // Walk each index backwards so that the most recent blocks come first, each in the order it was executed
+      if( owner == address() )
+      {
+          const auto& index = my->_market_history_by_pair;
+          auto iter = std::set<market_history_pair_index>::const_reverse_iterator(
+                  index.upper_bound( market_history_pair_index{ quote, base, std::numeric_limits<uint32_t>::max(), 0 } ) );
+          for( ; iter != index.rend() && results.size() < limit; ++iter )
+          {
+              if( iter->quote_id != quote || iter->base_id != base )
+                  break;
 
-      std::vector<order_history_record> results;
-      results.reserve(limit);
-      fc::time_point_sec stamp = get_block_header(current_block_num).timestamp;
-      for( const auto& rec : orders )
-        results.push_back(order_history_record(rec, stamp));
+              // Skip without loading the block
+              if( skip_count > 0 )
+              {
+                  --skip_count;
+                  continue;
+              }
 
-      //While we still need more orders to reach our limit...
-      while( --current_block_num >= 1 && orders.size() < limit )
+              add_result( iter->block_num, iter->seq );
+          }
+      }
+      else
       {
-        auto more_orders = get_transactions_from_prior_block();
-        more_orders.erase(std::remove_if(more_orders.begin(), more_orders.end(), order_is_uninteresting), more_orders.end());
-        ilog("Found ${num} more orders in block ${block}...", ("num", more_orders.size())("block", current_block_num));
-        stamp = get_block_header(current_block_num).timestamp;
-        for( const auto& rec : more_orders )
-          if( results.size() < limit )
-            results.push_back(order_history_record(rec, stamp));
-          else
-            return results;
+          const auto& index = my->_market_history_by_owner;
+          auto iter = std::set<market_history_owner_index>::const_reverse_iterator(
+                  index.upper_bound( market_history_owner_index{ owner, std::numeric_limits<uint32_t>::max(), 0 } ) );
+          for( ; iter != index.rend() && results.size() < limit; ++iter )
+          {
+              if( iter->owner != owner )
+                  break;
+
+              add_result( iter->block_num, iter->seq );
+          }
       }
 
       return results;
-   }
+   } FC_CAPTURE_AND_RETHROW( (quote)(base)(skip_count)(limit)(owner) ) }
+
+   market_depth chain_database::get_market_depth( const asset_id_type quote_id,
+                                                  const asset_id_type base_id,
+                                                  uint32_t levels )const
+   { try {
+      FC_ASSERT( levels <= 10000, "Levels must be at most 10000!" );
+      return my->_market_depth.get_depth( quote_id, base_id, levels );
+   } FC_CAPTURE_AND_RETHROW( (quote_id)(base_id)(levels) ) }
+
+   vector<market_depth_update> chain_database::get_market_depth_updates( const asset_id_type quote_id,
+                                                                         const asset_id_type base_id,
+                                                                         uint64_t after_update_id,
+                                                                         uint32_t limit )const
+   { try {
+      FC_ASSERT( limit <= BTS_BLOCKCHAIN_MARKET_DEPTH_UPDATE_HISTORY, "Limit must be at most ${max}!",
+                 ("max",BTS_BLOCKCHAIN_MARKET_DEPTH_UPDATE_HISTORY) );
+      return my->_market_depth.get_updates( quote_id, base_id, after_update_id, limit );
+   } FC_CAPTURE_AND_RETHROW( (quote_id)(base_id)(after_update_id)(limit) ) }
 
     void chain_database::generate_issuance_map( const string& symbol, const fc::path& filename )const
     { try {
@@ -3942,42 +5204,29 @@ namespace bts { namespace blockchain {
 
    oprice chain_database::get_active_feed_price( const asset_id_type quote_id )const
    { try {
-       const auto outer_iter = my->_nested_feed_map.find( quote_id );
-       if( outer_iter == my->_nested_feed_map.end() )
-           return oprice();
-
-       // TODO: Caller passes in delegate list
-       const vector<account_id_type>& delegate_ids = get_active_delegates();
-
-       vector<price> prices;
-       prices.reserve( delegate_ids.size() );
-
        const time_point_sec now = this->now();
-       static const auto limit = fc::days( 1 );
 
-       const unordered_map<account_id_type, feed_record>& delegate_feeds = outer_iter->second;
-       for( const account_id_type delegate_id : delegate_ids )
+       // Before the first block now() follows the wall clock
+       const bool cacheable = my->_head_block_header.block_num > 0;
+       if( cacheable )
        {
-           const auto iter = delegate_feeds.find( delegate_id );
-           if( iter == delegate_feeds.end() ) continue;
-
-           const feed_record& record = iter->second;
-           if( time_point( now ) - time_point( record.last_update ) >= limit ) continue;
-
-           if( record.value.quote_asset_id != quote_id ) continue;
-           if( record.value.base_asset_id != 0 ) continue;
-
-           prices.push_back( record.value );
+           std::lock_guard<std::mutex> lock( my->_active_feed_price_mutex );
+           const auto iter = my->_active_feed_price_cache.find( quote_id );
+           if( iter != my->_active_feed_price_cache.end() )
+           {
+               const active_feed_price_entry& entry = iter->second;
+               if( entry.valid_from <= time_point( now ) && time_point( now ) < entry.valid_until )
+                   return entry.price;
+           }
        }
 
-       if( prices.size() >= BTS_BLOCKCHAIN_MIN_FEEDS )
+       const active_feed_price_entry entry = my->calculate_active_feed_price( quote_id, now );
+       if( cacheable )
        {
-           const auto midpoint = prices.size() / 2;
-           std::nth_element( prices.begin(), prices.begin() + midpoint, prices.end() );
-           return prices.at( midpoint );
+           std::lock_guard<std::mutex> lock( my->_active_feed_price_mutex );
+           my->_active_feed_price_cache[ quote_id ] = entry;
        }
-
-       return oprice();
+       return entry.price;
    } FC_CAPTURE_AND_RETHROW( (quote_id) ) }
 
    vector<feed_record> chain_database::get_feeds_for_asset( const asset_id_type quote_id, const asset_id_type base_id )const
@@ -4029,58 +5278,77 @@ namespace bts { namespace blockchain {
       return results;
    } FC_CAPTURE_AND_RETHROW( (account_name) ) }
 
-   vector<transaction_record> chain_database::fetch_address_transactions( const address& addr )
+   /**
+    *  Returns the transactions involving addr in chain order, starting after block after_block.
+    *  Once limit is reached the remaining transactions of the same block are still returned, so the
+    *  block number of the last result can be passed as after_block to fetch the next page.
+    */
+   vector<transaction_record> chain_database::fetch_address_transactions( const address& addr, const uint32_t after_block,
+                                                                          const uint32_t limit )
    { try {
       vector<transaction_record> results;
+      if( after_block == uint32_t( -1 ) || limit == 0 )
+          return results;
 
-      const auto transaction_ids = my->_address_to_transaction_ids.fetch_optional( addr );
-      if( transaction_ids.valid() )
+      uint32_t last_block_num = 0;
+      for( auto iter = my->_address_transaction_index.lower_bound( address_transaction_index( addr, after_block + 1 ) );
+           iter.valid(); ++iter )
       {
-          for( const transaction_id_type& transaction_id : *transaction_ids )
-          {
-              otransaction_record record = get_transaction( transaction_id );
-              if( record.valid() ) results.push_back( std::move( *record ) );
-          }
+          const address_transaction_index key = iter.key();
+          if( key.addr != addr ) break;
+          if( results.size() >= limit && key.block_num != last_block_num ) break;
+
+          otransaction_record record = get_transaction( iter.value() );
+          if( record.valid() ) results.push_back( std::move( *record ) );
+          last_block_num = key.block_num;
       }
 
       return results;
-   } FC_CAPTURE_AND_RETHROW( (addr) ) }
+   } FC_CAPTURE_AND_RETHROW( (addr)(after_block)(limit) ) }
 
    oproperty_record chain_database::property_lookup_by_id( const property_id_type id )const
    {
-       const auto iter = my->_property_id_to_record.unordered_find( static_cast<uint8_t>( id ) );
-       if( iter != my->_property_id_to_record.unordered_end() ) return iter->second;
-       return oproperty_record();
+       return my->_property_id_to_record.fetch_optional( static_cast<uint8_t>( id ) );
    }
 
    void chain_database::property_insert_into_id_map( const property_id_type id, const property_record& record )
    {
        my->_property_id_to_record.store( static_cast<uint8_t>( id ), record );
+
+       if( id == property_id_type::active_delegate_list_id )
+       {
+           std::lock_guard<std::mutex> lock( my->_active_feed_price_mutex );
+           my->_active_feed_price_cache.clear();
+       }
    }
 
    void chain_database::property_erase_from_id_map( const property_id_type id )
    {
        my->_property_id_to_record.remove( static_cast<uint8_t>( id ) );
+
+       if( id == property_id_type::active_delegate_list_id )
+       {
+           std::lock_guard<std::mutex> lock( my->_active_feed_price_mutex );
+           my->_active_feed_price_cache.clear();
+       }
    }
 
    oaccount_record chain_database::account_lookup_by_id( const account_id_type id )const
    {
-       const auto iter = my->_account_id_to_record.unordered_find( id );
-       if( iter != my->_account_id_to_record.unordered_end() ) return iter->second;
-       return oaccount_record();
+       return my->_account_id_to_record.fetch_optional( id );
    }
 
    oaccount_record chain_database::account_lookup_by_name( const string& name )const
    {
-       const auto iter = my->_account_name_to_id.unordered_find( name );
-       if( iter != my->_account_name_to_id.unordered_end() ) return account_lookup_by_id( iter->second );
+       const optional<account_id_type> id = my->_account_name_to_id.fetch_optional( name );
+       if( id.valid() ) return account_lookup_by_id( *id );
        return oaccount_record();
    }
 
    oaccount_record chain_database::account_lookup_by_address( const address& addr )const
    {
-       const auto iter = my->_account_address_to_id.unordered_find( addr );
-       if( iter != my->_account_address_to_id.unordered_end() ) return account_lookup_by_id( iter->second );
+       const optional<account_id_type> id = my->_account_address_to_id.fetch_optional( addr );
+       if( id.valid() ) return account_lookup_by_id( *id );
        return oaccount_record();
    }
 
@@ -4126,15 +5394,13 @@ namespace bts { namespace blockchain {
 
    oasset_record chain_database::asset_lookup_by_id( const asset_id_type id )const
    {
-       const auto iter = my->_asset_id_to_record.unordered_find( id );
-       if( iter != my->_asset_id_to_record.unordered_end() ) return iter->second;
-       return oasset_record();
+       return my->_asset_id_to_record.fetch_optional( id );
    }
 
    oasset_record chain_database::asset_lookup_by_symbol( const string& symbol )const
    {
-       const auto iter = my->_asset_symbol_to_id.unordered_find( symbol );
-       if( iter != my->_asset_symbol_to_id.unordered_end() ) return asset_lookup_by_id( iter->second );
+       const optional<asset_id_type> id = my->_asset_symbol_to_id.fetch_optional( symbol );
+       if( id.valid() ) return asset_lookup_by_id( *id );
        return oasset_record();
    }
 
@@ -4160,9 +5426,7 @@ namespace bts { namespace blockchain {
 
    oslate_record chain_database::slate_lookup_by_id( const slate_id_type id )const
    {
-       const auto iter = my->_slate_id_to_record.unordered_find( id );
-       if( iter != my->_slate_id_to_record.unordered_end() ) return iter->second;
-       return oslate_record();
+       return my->_slate_id_to_record.fetch_optional( id );
    }
 
    void chain_database::slate_insert_into_id_map( const slate_id_type id, const slate_record& record )
@@ -4177,18 +5441,31 @@ namespace bts { namespace blockchain {
 
    obalance_record chain_database::balance_lookup_by_id( const balance_id_type& id )const
    {
-       const auto iter = my->_balance_id_to_record.unordered_find( id );
-       if( iter != my->_balance_id_to_record.unordered_end() ) return iter->second;
-       return obalance_record();
+       return my->_balance_id_to_record.fetch_optional( id );
    }
 
    void chain_database::balance_insert_into_id_map( const balance_id_type& id, const balance_record& record )
    {
        my->_balance_id_to_record.store( id, record );
+
+       for( const address& owner : record.owners() )
+           my->_balance_owner_index[ owner ].insert( id );
    }
 
    void chain_database::balance_erase_from_id_map( const balance_id_type& id )
    {
+       const obalance_record record = my->_balance_id_to_record.fetch_optional( id );
+       if( record.valid() )
+       {
+           for( const address& owner : record->owners() )
+           {
+               const auto index_iter = my->_balance_owner_index.find( owner );
+               if( index_iter == my->_balance_owner_index.end() ) continue;
+               index_iter->second.erase( id );
+               if( index_iter->second.empty() ) my->_balance_owner_index.erase( index_iter );
+           }
+       }
+
        my->_balance_id_to_record.remove( id );
    }
 
@@ -4203,12 +5480,10 @@ namespace bts { namespace blockchain {
 
        if( get_statistics_enabled() )
        {
+           const transaction_location& location = record.chain_location;
            const auto scan_address = [ & ]( const address& addr )
            {
-               auto ids = my->_address_to_transaction_ids.fetch_optional( addr );
-               if( !ids.valid() ) ids = unordered_set<transaction_id_type>();
-               ids->insert( id );
-               my->_address_to_transaction_ids.store( addr, *ids );
+               my->_address_transaction_index.store( address_transaction_index( addr, location.block_num, location.trx_num ), id );
            };
            record.scan_addresses( *this, scan_address );
 
@@ -4229,13 +5504,10 @@ namespace bts { namespace blockchain {
            const otransaction_record record = transaction_lookup_by_id( id );
            if( record.valid() )
            {
+               const transaction_location& location = record->chain_location;
                const auto scan_address = [ & ]( const address& addr )
                {
-                   auto ids = my->_address_to_transaction_ids.fetch_optional( addr );
-                   if( !ids.valid() ) return;
-                   ids->erase( id );
-                   if( !ids->empty() ) my->_address_to_transaction_ids.store( addr, *ids );
-                   else my->_address_to_transaction_ids.remove( addr );
+                   my->_address_transaction_index.remove( address_transaction_index( addr, location.block_num, location.trx_num ) );
                };
                record->scan_addresses( *this, scan_address );
            }
@@ -4296,6 +5568,9 @@ namespace bts { namespace blockchain {
    {
        my->_feed_index_to_record.store( index, record );
        my->_nested_feed_map[ index.quote_id ][ index.delegate_id ] = record;
+
+       std::lock_guard<std::mutex> lock( my->_active_feed_price_mutex );
+       my->_active_feed_price_cache.erase( index.quote_id );
    }
 
    void chain_database::feed_erase_from_index_map( const feed_index index )
@@ -4308,6 +5583,9 @@ namespace bts { namespace blockchain {
            if( inner_iter != outer_iter->second.end() )
                outer_iter->second.erase( index.delegate_id );
        }
+
+       std::lock_guard<std::mutex> lock( my->_active_feed_price_mutex );
+       my->_active_feed_price_cache.erase( index.quote_id );
    }
 
    oslot_record chain_database::slot_lookup_by_index( const slot_index index )const
@@ -4353,4 +5631,28 @@ namespace bts { namespace blockchain {
        return;
    }
 
+   market_engine_run chain_database::debug_execute_market( const pending_chain_state_ptr& state,
+                                                           const asset_id_type quote_id,
+                                                           const asset_id_type base_id,
+                                                           const time_point_sec timestamp,
+                                                           const uint32_t engine_version )const
+   { try {
+      return my->debug_execute_market( state, quote_id, base_id, timestamp, engine_version );
+   } FC_CAPTURE_AND_RETHROW( (quote_id)(base_id)(timestamp)(engine_version) ) }
+
+   map<string, timing_summary> chain_database::debug_get_block_timing_stats( bool reset )
+   {
+       map<string, timing_summary> stats;
+       for( auto& item : my->_block_timings )
+       {
+           const timing_summary summary = item.second.summary();
+           if( summary.count > 0 )
+               stats[ item.first ] = summary;
+
+           // Zero in place: timers in flight, such as observer dispatch across a yield, hold references
+           if( reset ) item.second.reset();
+       }
+       return stats;
+   }
+
 } } // bts::blockchain
@@ -156,6 +156,44 @@ void chain_database_impl::execute_markets_v1( const fc::time_point_sec timestamp
   pending_state->set_market_transactions( std::move( market_transactions ) );
 } FC_CAPTURE_AND_RETHROW( (timestamp) ) }
 
+template<typename EngineType>
+static market_engine_run run_market_engine( EngineType& engine, const asset_id_type quote_id, const asset_id_type base_id,
+                                            const time_point_sec timestamp )
+{
+  market_engine_run run;
+  run.executed = engine.execute( quote_id, base_id, timestamp );
+  run.transactions = std::move( engine._market_transactions );
+  return run;
+}
+
+market_engine_run chain_database_impl::debug_execute_market( const pending_chain_state_ptr& state,
+                                                             const asset_id_type quote_id,
+                                                             const asset_id_type base_id,
+                                                             const time_point_sec timestamp,
+                                                             const uint32_t engine_version )const
+{ try {
+  switch( engine_version )
+  {
+      case 0:
+      {
+          market_engine engine( state, *this );
+          market_engine_run run = run_market_engine( engine, quote_id, base_id, timestamp );
+          run.pass_durations = std::move( engine._pass_durations );
+          return run;
+      }
+      case 1: { market_engine_v1 engine( state, *this ); return run_market_engine( engine, quote_id, base_id, timestamp ); }
+      case 2: { market_engine_v2 engine( state, *this ); return run_market_engine( engine, quote_id, base_id, timestamp ); }
+      case 3: { market_engine_v3 engine( state, *this ); return run_market_engine( engine, quote_id, base_id, timestamp ); }
+      case 4: { market_engine_v4 engine( state, *this ); return run_market_engine( engine, quote_id, base_id, timestamp ); }
+      case 5: { market_engine_v5 engine( state, *this ); return run_market_engine( engine, quote_id, base_id, timestamp ); }
+      case 6: { market_engine_v6 engine( state, *this ); return run_market_engine( engine, quote_id, base_id, timestamp ); }
+      case 7: { market_engine_v7 engine( state, *this ); return run_market_engine( engine, quote_id, base_id, timestamp ); }
+      default:
+          FC_ASSERT( false, "Unknown market engine version ${v}", ("v",engine_version) );
+  }
+  return market_engine_run();
+} FC_CAPTURE_AND_RETHROW( (quote_id)(base_id)(timestamp)(engine_version) ) }
+
 void chain_database_impl::update_active_delegate_list_v1( const uint32_t block_num,
                                                           const pending_chain_state_ptr& pending_state )const
 { try {
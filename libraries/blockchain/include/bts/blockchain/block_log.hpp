@@ -0,0 +1,74 @@
+#pragma once
+
+#include <bts/blockchain/block.hpp>
+
+#include <fc/filesystem.hpp>
+
+#include <boost/filesystem/fstream.hpp>
+
+#include <mutex>
+
+namespace bts { namespace blockchain {
+
+   /**
+    *  Stores the blocks of the current chain in an append-only file in block number order, so replaying
+    *  and serving the chain are sequential reads. A second file has one fixed size entry per block with
+    *  the block's offset in the log and its id.
+    *
+    *  Only blocks that are part of the current chain belong here; chain_database keeps blocks on other
+    *  forks in its fork store and moves blocks between the two as the head changes.
+    *
+    *  The chain_server reads blocks from its own threads while the chain thread appends and truncates, so
+    *  every access to the files goes through one mutex.
+    */
+   class block_log
+   {
+      public:
+         ~block_log();
+
+         void                       open( const fc::path& dir );
+         void                       close();
+         bool                       is_open()const;
+
+         uint32_t                   head_block_num()const;
+
+         /** block_data must be the block after the current head */
+         void                       append( const full_block& block_data, const block_id_type& block_id );
+
+         /** Removes block_num and every block after it */
+         void                       truncate( uint32_t block_num );
+
+         void                       flush();
+
+         optional<block_id_type>    fetch_block_id( uint32_t block_num )const;
+         optional<full_block>       fetch_optional( uint32_t block_num )const;
+         /** Returns nothing unless the block logged at block_num has the given id */
+         optional<full_block>       fetch_optional( uint32_t block_num, const block_id_type& block_id )const;
+         full_block                 fetch( uint32_t block_num )const;
+
+      private:
+         struct index_entry
+         {
+            uint64_t        offset = 0;
+            block_id_type   id;
+         };
+
+         static const uint64_t      index_entry_size = sizeof( uint64_t ) + sizeof( block_id_type );
+
+         // The caller holds _mutex
+         void                       open_files();
+         void                       truncate_files( uint32_t block_num );
+         optional<full_block>       read_block( uint32_t block_num, const index_entry& entry )const;
+         index_entry                read_index_entry( uint32_t block_num )const;
+         uint64_t                   end_of_block( const index_entry& entry )const;
+
+         mutable std::mutex                         _mutex;
+         fc::path                                   _log_path;
+         fc::path                                   _index_path;
+         mutable boost::filesystem::fstream         _log;
+         mutable boost::filesystem::fstream         _index;
+         uint32_t                                   _head_block_num = 0;
+         uint64_t                                   _log_size = 0;
+   };
+
+} } // bts::blockchain
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <bts/blockchain/asset.hpp>
+#include <bts/db/key_encoding.hpp>
 
 namespace bts { namespace blockchain {
 
@@ -52,3 +53,25 @@ class burn_db_interface
 
 FC_REFLECT( bts::blockchain::burn_index, (account_id)(transaction_id) )
 FC_REFLECT( bts::blockchain::burn_record, (index)(amount)(message)(signer) )
+
+namespace bts { namespace db {
+
+   template<>
+   struct memcmp_key_encoding<bts::blockchain::burn_index>
+   {
+      static const bool enabled = true;
+
+      static void encode( key_encoding::writer& w, const bts::blockchain::burn_index& key )
+      {
+         w.write_int32( key.account_id.value );
+         w.write_bytes( key.transaction_id.data(), key.transaction_id.data_size() );
+      }
+
+      static void decode( key_encoding::reader& r, bts::blockchain::burn_index& key )
+      {
+         key.account_id = r.read_int32();
+         r.read_bytes( key.transaction_id.data(), key.transaction_id.data_size() );
+      }
+   };
+
+} } // bts::db
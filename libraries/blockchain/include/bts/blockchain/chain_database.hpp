@@ -2,7 +2,10 @@
 
 #include <bts/blockchain/chain_interface.hpp>
 #include <bts/blockchain/delegate_config.hpp>
+#include <bts/blockchain/market_depth.hpp>
 #include <bts/blockchain/pending_chain_state.hpp>
+#include <bts/blockchain/pending_transaction_pool.hpp>
+#include <bts/blockchain/timing_histogram.hpp>
 
 namespace bts { namespace blockchain {
 
@@ -64,6 +67,14 @@ namespace bts { namespace blockchain {
    };
    typedef fc::optional<fork_record> ofork_record;
 
+   /** The outcome of running one market engine outside of block processing */
+   struct market_engine_run
+   {
+      bool                          executed = false;
+      vector<market_transaction>    transactions;
+      vector<fc::microseconds>      pass_durations; // Only reported by the current engine
+   };
+
    class chain_observer
    {
       public:
@@ -82,9 +93,24 @@ namespace bts { namespace blockchain {
                     const std::function<void(float)> replay_status_callback = std::function<void(float)>() );
          void close();
 
+         /**
+          *  Must be called before open(); zero keeps all account, balance and undo records in memory. The market history
+          *  indexes are not bounded by this: open() rebuilds them from every stored market transaction, so their memory
+          *  and the time that takes grow with the trading history.
+          */
+         void set_state_cache_entries( uint32_t entries );
+
          void add_observer( chain_observer* observer );
          void remove_observer( chain_observer* observer );
 
+         /** Total packed size of the pending pool and how many pending transactions one address may sign */
+         void set_pending_pool_limits( const uint64_t max_bytes, const uint32_t max_transactions_per_address );
+
+         /** Must be called before open(); saves the pending pool on close and reloads it on open */
+         void set_pending_journal_enabled( const bool enabled );
+
+         pending_pool_stats get_pending_pool_stats()const;
+
          void set_relay_fee( share_type shares );
          share_type get_relay_fee();
 
@@ -96,9 +122,9 @@ namespace bts { namespace blockchain {
          pending_chain_state_ptr                    get_pending_state()const;
 
          /**
-          *  @param override_limits - stores the transaction even if the pending queue is full,
-          *                           if false then it will require exponential fee increases
-          *                           as the queue fills.
+          *  @param override_limits - stores the transaction even if the pending pool is full and never
+          *                           evicts it; if false then it must pay more per byte than the
+          *                           transactions it displaces once the pool is full.
           */
          transaction_evaluation_state_ptr           store_pending_transaction( const signed_transaction& trx,
                                                                              bool override_limits = true );
@@ -125,7 +151,8 @@ namespace bts { namespace blockchain {
 
          optional<time_point_sec>    get_next_producible_block_timestamp( const vector<account_id_type>& delegate_ids )const;
 
-         vector<transaction_record>  fetch_address_transactions( const address& addr );
+         vector<transaction_record>  fetch_address_transactions( const address& addr, const uint32_t after_block = 0,
+                                                                 const uint32_t limit = -1 );
 
          uint32_t                    find_block_num(fc::time_point_sec &time)const;
          uint32_t                    get_block_num( const block_id_type& )const;
@@ -177,6 +204,12 @@ namespace bts { namespace blockchain {
           **/
          block_fork_data push_block(const full_block& block_data);
 
+         /**
+          *  Start recovering the block and transaction signatures of a block that is expected
+          *  to be pushed soon on a background thread; does not wait for the result.
+          */
+         void preverify_block( const full_block& block_data );
+
          vector<block_id_type> get_fork_history( const block_id_type& id );
 
          /**
@@ -204,6 +237,11 @@ namespace bts { namespace blockchain {
                                                                const string& base_symbol = BTS_BLOCKCHAIN_SYMBOL,
                                                                uint32_t limit = uint32_t(-1) )const;
 
+         /** Margin positions that would be called if the feed fell by up to max_drop_percent, highest call price first */
+         vector<market_order>               get_margin_positions_at_risk( const asset_id_type quote_id,
+                                                                          uint32_t max_drop_percent,
+                                                                          uint32_t limit = uint32_t(-1) )const;
+
          share_type                         get_asset_collateral( const string& symbol );
 
          virtual omarket_order              get_lowest_ask_record( const asset_id_type quote_id,
@@ -261,6 +299,14 @@ namespace bts { namespace blockchain {
                                                                   uint32_t limit,
                                                                   const address& owner );
 
+         market_depth                       get_market_depth( const asset_id_type quote_id,
+                                                              const asset_id_type base_id,
+                                                              uint32_t levels )const;
+         vector<market_depth_update>        get_market_depth_updates( const asset_id_type quote_id,
+                                                                      const asset_id_type base_id,
+                                                                      uint64_t after_update_id,
+                                                                      uint32_t limit )const;
+
          void                               generate_snapshot( const fc::path& filename )const;
          void                               graphene_snapshot( const string& filename, const set<string>& whitelist )const;
          void                               generate_issuance_map( const string& symbol, const fc::path& filename )const;
@@ -279,6 +325,17 @@ namespace bts { namespace blockchain {
 
          fc::variants debug_get_matching_errors() const;
          void debug_trap_on_block( uint32_t blocknum );
+         map<string, timing_summary> debug_get_block_timing_stats( bool reset );
+
+         /**
+          *  Matches one market against the given state without touching the database; the state is left as the
+          *  engine would leave it. Version 0 is the current engine and 1 through 7 are the legacy engines.
+          */
+         market_engine_run debug_execute_market( const pending_chain_state_ptr& state,
+                                                 const asset_id_type quote_id,
+                                                 const asset_id_type base_id,
+                                                 const time_point_sec timestamp,
+                                                 const uint32_t engine_version = 0 )const;
 
          // Applies only when pushing new blocks; gets enabled in delegate loop
          bool _verify_transaction_signatures = false;
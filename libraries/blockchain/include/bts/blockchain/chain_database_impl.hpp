@@ -1,9 +1,14 @@
 #pragma once
 
+#include <bts/blockchain/block_log.hpp>
 #include <bts/blockchain/chain_database.hpp>
+#include <bts/blockchain/state_snapshot.hpp>
 #include <bts/db/cached_level_map.hpp>
 #include <bts/db/fast_level_map.hpp>
 #include <fc/thread/mutex.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <mutex>
 
 namespace bts { namespace blockchain {
 
@@ -27,6 +32,109 @@ namespace bts { namespace blockchain {
       }
    };
 
+   /**
+    *  The results of recovering the signatures of a block ahead of time on one of the
+    *  verification threads, so that extend_chain does not have to do the elliptic curve
+    *  math while holding the push_block lock. Fields that could not be recovered are left
+    *  unset and the usual code path will compute them (and report any error) instead.
+    */
+   struct preverified_block
+   {
+      block_id_type                         id;
+      uint32_t                              block_num = 0;
+      digest_block                          digest;
+      optional<public_key_type>             signee;
+      vector<optional<set<address>>>        signed_addresses; // One entry per user transaction when verifying
+      fc::microseconds                      recovery_time;
+   };
+
+   /**
+    *  A pending transaction as it was last evaluated on top of _pending_trx_state. As long as
+    *  nothing the evaluation read has been written since, the saved changes can be replayed
+    *  onto a fresh pending state instead of evaluating the transaction again.
+    */
+   struct pending_evaluation
+   {
+      transaction_evaluation_state_ptr      eval_state;
+      pending_chain_state_ptr               changes;
+      pending_read_set_ptr                  reads;
+      pending_read_set_ptr                  writes;
+      bool                                  reusable = false; // Only true if evaluated in _pending_pool order
+   };
+
+   /** Drops the saved evaluations of transactions that left the pool and adds what they wrote to dirty_keys */
+   void forget_pending_evaluations( unordered_map<transaction_id_type, pending_evaluation>& evaluations,
+                                    const vector<transaction_id_type>& trx_ids, pending_read_set& dirty_keys );
+
+   /**
+    *  The median feed price of an asset as of some head block time. The median only changes when a feed or the
+    *  active delegate list is stored, or when head block time moves past the expiration of one of the feeds it
+    *  considered, so the entry stays valid while head block time is within [valid_from, valid_until).
+    */
+   struct active_feed_price_entry
+   {
+      oprice                                price;
+      time_point                            valid_from;
+      time_point                            valid_until;
+   };
+
+   /** A database saved in state snapshots, named by its path relative to the data directory */
+   struct state_snapshot_db
+   {
+      string                                                                      name;
+      std::function<std::shared_ptr<leveldb::Iterator>()>                         iterate;
+      std::function<void( const fc::path& data_dir, state_snapshot_reader& )>     restore;
+   };
+
+   /** Orders the transactions involving an address by their location in the chain */
+   struct address_transaction_index
+   {
+      address    addr;
+      uint32_t   block_num = 0;
+      uint32_t   trx_num = 0;
+
+      address_transaction_index( const address& a = address(), uint32_t block = 0, uint32_t trx = 0 )
+      :addr(a),block_num(block),trx_num(trx){}
+
+      friend bool operator == ( const address_transaction_index& a, const address_transaction_index& b )
+      {
+          return std::tie( a.addr, a.block_num, a.trx_num ) == std::tie( b.addr, b.block_num, b.trx_num );
+      }
+
+      friend bool operator < ( const address_transaction_index& a, const address_transaction_index& b )
+      {
+          return std::tie( a.addr, a.block_num, a.trx_num ) < std::tie( b.addr, b.block_num, b.trx_num );
+      }
+   };
+
+} } // bts::blockchain
+
+namespace bts { namespace db {
+
+   template<>
+   struct memcmp_key_encoding<bts::blockchain::address_transaction_index>
+   {
+      static const bool enabled = true;
+
+      static void encode( key_encoding::writer& w, const bts::blockchain::address_transaction_index& key )
+      {
+         w.write_bytes( key.addr.addr.data(), key.addr.addr.data_size() );
+         w.write_uint32( key.block_num );
+         w.write_uint32( key.trx_num );
+      }
+
+      static void decode( key_encoding::reader& r, bts::blockchain::address_transaction_index& key )
+      {
+         r.read_bytes( key.addr.addr.data(), key.addr.addr.data_size() );
+         key.block_num = r.read_uint32();
+         key.trx_num = r.read_uint32();
+      }
+   };
+
+} } // bts::db
+
+namespace bts { namespace blockchain {
+
    namespace detail
    {
       class chain_database_impl
@@ -38,17 +146,33 @@ namespace bts { namespace blockchain {
             void                                        clear_invalidation_of_future_blocks();
             digest_type                                 initialize_genesis( const optional<path>& genesis_file,
                                                                             const bool statistics_enabled );
+            void                                        clear_indexes();
             void                                        populate_indexes();
 
             std::pair<block_id_type, block_fork_data>   store_and_index( const block_id_type& id, const full_block& blk );
 
-            void                                        clear_pending(  const full_block& block_data );
+            void                                        clear_pending( const full_block& block_data,
+                                                                       const pending_chain_state_ptr& block_state );
             void                                        revalidate_pending();
+            transaction_evaluation_state_ptr            evaluate_pending_transaction( const signed_transaction& trx,
+                                                                                      const share_type required_fees,
+                                                                                      const bool reusable,
+                                                                                      const bool check_pool_limits = false );
+            void                                        forget_pending_transaction( const transaction_id_type& trx_id );
+            void                                        recover_pending_signatures();
 
             void                                        switch_to_fork( const block_id_type& block_id );
             void                                        extend_chain( const full_block& blk );
             vector<block_id_type>                       get_fork_history( const block_id_type& id );
             void                                        pop_block();
+            void                                        sync_block_log();
+
+            vector<state_snapshot_db>                   state_snapshot_dbs();
+            void                                        schedule_state_snapshot( const full_block& block_data,
+                                                                                 const block_id_type& block_id );
+            bool                                        restore_state_snapshot( const fc::path& data_dir,
+                                                                                vector<block_id_type>& blocks_to_replay );
+            void                                        replay_blocks_after_snapshot( const vector<block_id_type>& block_ids );
 
             void                                        mark_invalid( const block_id_type& id, const fc::exception& reason );
             void                                        mark_as_unchecked( const block_id_type& id );
@@ -60,6 +184,9 @@ namespace bts { namespace blockchain {
             void                                        recursive_mark_as_invalid( const std::unordered_set<block_id_type>& ids,
                                                                                    const fc::exception& reason );
 
+            fc::future<preverified_block>               preverify_block( const block_id_type& block_id, const full_block& block_data );
+            optional<preverified_block>                 take_preverified_block( const block_id_type& block_id );
+
             void                                        verify_header( const digest_block& block_digest,
                                                                        const public_key_type& block_signee )const;
 
@@ -77,7 +204,8 @@ namespace bts { namespace blockchain {
                                                                          const pending_chain_state_ptr& pending_state )const;
 
             void                                        apply_transactions( const full_block& block_data,
-                                                                            const pending_chain_state_ptr& pending_state )const;
+                                                                            const pending_chain_state_ptr& pending_state,
+                                                                            const optional<preverified_block>& preverified = optional<preverified_block>() )const;
 
             void                                        update_active_delegate_list( const uint32_t block_num,
                                                                                      const pending_chain_state_ptr& pending_state )const;
@@ -109,16 +237,50 @@ namespace bts { namespace blockchain {
             void                                        update_active_delegate_list_v1( const uint32_t block_num,
                                                                                         const pending_chain_state_ptr& pending_state )const;
 
+            market_engine_run                           debug_execute_market( const pending_chain_state_ptr& state,
+                                                                              const asset_id_type quote_id,
+                                                                              const asset_id_type base_id,
+                                                                              const time_point_sec timestamp,
+                                                                              const uint32_t engine_version )const;
+
             void                                        debug_check_no_orders_overlap( const pending_chain_state_ptr& pending_state ) const;
 
+            void                                        adjust_market_depth( const order_type_enum type,
+                                                                             const market_index_key& key,
+                                                                             const order_record& order,
+                                                                             const int32_t sign );
+            void                                        adjust_market_depth( const market_index_key& key,
+                                                                             const collateral_record& collateral,
+                                                                             const int32_t sign );
+            void                                        mark_market_depth_stale( const asset_id_type quote_id,
+                                                                                 const asset_id_type base_id );
+            void                                        resync_market_depth();
+
+            void                                        index_market_transactions( const uint32_t block_num,
+                                                                                   const vector<market_transaction>& trxs,
+                                                                                   const bool insert );
+
+            active_feed_price_entry                     calculate_active_feed_price( const asset_id_type quote_id,
+                                                                                     const time_point_sec now )const;
+
+            timing_histogram&                           block_timer( const string& phase )const { return _block_timings[ phase ]; }
+            timing_histogram&                           operation_timer( const operation_type_enum type )const;
+            timing_histogram&                           market_timer( const std::pair<asset_id_type, asset_id_type>& market_pair )const;
+
             chain_database*                                                             self = nullptr;
             unordered_set<chain_observer*>                                              _observers;
 
             /* Transaction propagation */
             fc::future<void>                                                            _revalidate_pending;
             pending_chain_state_ptr                                                     _pending_trx_state = nullptr;
-            bts::db::level_map<transaction_id_type, signed_transaction>                 _pending_transaction_db;
+            pending_transaction_pool                                                    _pending_pool;
+            bool                                                                        _pending_journal_enabled = true;
+            bts::db::level_map<transaction_id_type, signed_transaction>                 _pending_transaction_journal; // Written on close
             map<fee_index, transaction_evaluation_state_ptr>                            _pending_fee_index;
+            unordered_map<transaction_id_type, pending_evaluation>                      _pending_evaluations;
+            unordered_map<transaction_id_type, set<address>>                            _pending_signature_cache;
+            pending_read_set                                                            _pending_dirty_keys; // Written since last revalidation
+            bool                                                                        _revalidate_all_pending = true;
             share_type                                                                  _relay_fee = BTS_BLOCKCHAIN_DEFAULT_RELAY_FEE;
 
             /* Block processing */
@@ -126,7 +288,12 @@ namespace bts { namespace blockchain {
 
             fc::mutex                                                                   _push_block_mutex;
 
-            bts::db::level_map<block_id_type, full_block>                               _block_id_to_full_block;
+            vector<std::unique_ptr<fc::thread>>                                         _verification_threads;
+            unordered_map<block_id_type, fc::future<preverified_block>>                 _preverified_blocks;
+
+            block_log                                                                   _block_log; // Current chain
+            bts::db::level_map<block_id_type, full_block>                               _block_id_to_full_block; // Blocks not in _block_log
+            bts::db::level_map<block_id_type, uint32_t>                                 _block_id_to_block_num;
             bts::db::fast_level_map<block_id_type, pending_chain_state>                 _block_id_to_undo_state;
 
             bts::db::level_map<uint32_t, vector<block_id_type>>                         _fork_number_db; // All siblings
@@ -138,7 +305,14 @@ namespace bts { namespace blockchain {
 
             bts::db::level_map<block_id_type, block_record>                             _block_id_to_block_record_db; // Statistics
 
+            fc::path                                                                    _data_dir;
+            bool                                                                        _state_snapshots_enabled = false;
+            std::unique_ptr<fc::thread>                                                 _state_snapshot_thread;
+            fc::future<void>                                                            _state_snapshot;
+
             /* Current primary state */
+            uint32_t                                                                    _state_cache_entries = 0; // Hot set size for the largest state databases; zero loads them entirely
+
             block_id_type                                                               _head_block_id;
             signed_block_header                                                         _head_block_header;
 
@@ -155,10 +329,11 @@ namespace bts { namespace blockchain {
             bts::db::fast_level_map<slate_id_type, slate_record>                        _slate_id_to_record;
 
             bts::db::fast_level_map<balance_id_type, balance_record>                    _balance_id_to_record;
+            unordered_map<address, unordered_set<balance_id_type>>                      _balance_owner_index;
 
             bts::db::level_map<transaction_id_type, transaction_record>                 _transaction_id_to_record;
             set<unique_transaction_key>                                                 _unique_transactions;
-            bts::db::level_map<address, unordered_set<transaction_id_type>>             _address_to_transaction_ids;
+            bts::db::level_map<address_transaction_index, transaction_id_type>          _address_transaction_index;
 
             bts::db::cached_level_map<burn_index, burn_record>                          _burn_index_to_record;
 
@@ -166,16 +341,24 @@ namespace bts { namespace blockchain {
 
             bts::db::cached_level_map<feed_index, feed_record>                          _feed_index_to_record;
             unordered_map<asset_id_type, unordered_map<account_id_type, feed_record>>   _nested_feed_map;
+            mutable std::mutex                                                          _active_feed_price_mutex; // Block production evaluates transactions in parallel
+            mutable unordered_map<asset_id_type, active_feed_price_entry>               _active_feed_price_cache;
 
             bts::db::cached_level_map<market_index_key, order_record>                   _ask_db;
             bts::db::cached_level_map<market_index_key, order_record>                   _bid_db;
 
             bts::db::cached_level_map<market_index_key, order_record>                   _short_db;
+            map<pair<asset_id_type, asset_id_type>, set<short_limit_index>>             _short_limit_index;
 
             bts::db::cached_level_map<market_index_key, collateral_record>              _collateral_db;
             set<expiration_index>                                                       _collateral_expiration_index;
 
+            market_depth_index                                                          _market_depth;
+            set<pair<asset_id_type, asset_id_type>>                                     _stale_market_depth; // Rebuilt at the end of the block
+
             bts::db::cached_level_map<uint32_t, vector<market_transaction>>             _market_transactions_db;
+            set<market_history_pair_index>                                              _market_history_by_pair;
+            set<market_history_owner_index>                                             _market_history_by_owner;
             bts::db::cached_level_map<market_history_key, market_history_record>        _market_history_db;
 
             bts::db::level_map<slot_index, slot_record>                                 _slot_index_to_record;
@@ -183,6 +366,11 @@ namespace bts { namespace blockchain {
 
             map<operation_type_enum, std::deque<operation>>                             _recent_operations;
 
+            mutable map<string, timing_histogram>                                       _block_timings; // By block processing phase, never erased
+            mutable vector<timing_histogram*>                                           _operation_timers; // By operation type, into _block_timings
+            mutable map<std::pair<asset_id_type, asset_id_type>, timing_histogram*>     _market_timers; // Into _block_timings
+            mutable timing_histogram*                                                   _other_markets_timer = nullptr;
+
             mutable fc::variants                                                        _debug_matching_error_log;
             mutable set<uint32_t>                                                       _debug_trap_blocks;
       };
@@ -193,3 +381,4 @@ namespace bts { namespace blockchain {
 FC_REFLECT_TYPENAME( std::vector<bts::blockchain::block_id_type> )
 FC_REFLECT_TYPENAME( std::unordered_set<bts::blockchain::transaction_id_type> )
 FC_REFLECT( bts::blockchain::fee_index, (_fees)(_trx) )
+FC_REFLECT( bts::blockchain::address_transaction_index, (addr)(block_num)(trx_num) )
@@ -7,7 +7,7 @@
 
 #define BTS_TEST_NETWORK_VERSION                            84 // autogenerated
 
-#define BTS_BLOCKCHAIN_DATABASE_VERSION                     uint64_t( 210 )
+#define BTS_BLOCKCHAIN_DATABASE_VERSION                     uint64_t( 212 )
 
 #define BTS_ADDRESS_PREFIX                                  "BTS"
 #define BTS_BLOCKCHAIN_SYMBOL                               "BTS"
@@ -79,3 +79,16 @@
 #define BTS_BLOCKCHAIN_DEFAULT_RELAY_FEE                    10000 // XTS
 #define BTS_BLOCKCHAIN_MAX_TRX_PER_SECOND                   1  // (10)
 #define BTS_BLOCKCHAIN_MAX_PENDING_QUEUE_SIZE               10 // (BTS_BLOCKCHAIN_MAX_TRX_PER_SECOND * BTS_BLOCKCHAIN_BLOCK_INTERVAL_SEC)
+
+// Local tuning only; does not affect consensus
+#define BTS_BLOCKCHAIN_PREVERIFY_BLOCK_WINDOW               64 // blocks to recover signatures for ahead of pushing
+#define BTS_BLOCKCHAIN_STATE_SNAPSHOT_INTERVAL              10000 // blocks between state snapshots used to restart without a full replay
+#define BTS_BLOCKCHAIN_STATE_SNAPSHOT_VERSION               1
+#define BTS_BLOCKCHAIN_MARKET_CANDLE_RETENTION              1500 // candles kept per market and resolution
+#define BTS_BLOCKCHAIN_MARKET_CANDLE_BACKFILL_BLOCKS        ( 7 * BTS_BLOCKCHAIN_BLOCKS_PER_DAY ) // blocks loaded into candles in the background at startup
+#define BTS_BLOCKCHAIN_MARKET_CANDLE_BACKFILL_BATCH         1000 // blocks loaded between yields to other tasks
+#define BTS_BLOCKCHAIN_MARKET_DEPTH_UPDATE_HISTORY          360 // depth updates kept per market for clients to catch up from
+#define BTS_BLOCKCHAIN_SPECULATIVE_EVALUATION_WINDOW        64 // pending transactions evaluated in parallel at a time when producing a block
+#define BTS_BLOCKCHAIN_MAX_TIMED_MARKETS                    256 // markets with their own execution time histogram; the rest share one
+#define BTS_BLOCKCHAIN_MAX_PENDING_POOL_BYTES               ( 16 * 1024 * 1024 ) // packed size of all pending transactions before the cheapest are evicted
+#define BTS_BLOCKCHAIN_MAX_PENDING_TRANSACTIONS_PER_ADDRESS 64 // pending transactions any one address may sign
@@ -91,6 +91,8 @@ FC_DECLARE_DERIVED_EXCEPTION( negative_fee,                     bts::blockchain:
 FC_DECLARE_DERIVED_EXCEPTION( missing_deposit,                  bts::blockchain::evaluation_error, 36004, "missing deposit" );
 FC_DECLARE_DERIVED_EXCEPTION( insufficient_relay_fee,           bts::blockchain::evaluation_error, 36005, "insufficient relay fee" );
 FC_DECLARE_DERIVED_EXCEPTION( fee_greater_than_max,             bts::blockchain::evaluation_error, 36006, "fee greater than max" );
+FC_DECLARE_DERIVED_EXCEPTION( pending_pool_full,                bts::blockchain::insufficient_relay_fee, 36007, "pending transaction pool full" );
+FC_DECLARE_DERIVED_EXCEPTION( too_many_pending_transactions,    bts::blockchain::insufficient_relay_fee, 36008, "too many pending transactions" );
 
 FC_DECLARE_DERIVED_EXCEPTION( invalid_market,                   bts::blockchain::evaluation_error, 37001, "invalid market" );
 FC_DECLARE_DERIVED_EXCEPTION( unknown_market_order,             bts::blockchain::evaluation_error, 37002, "unknown market order" );
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <bts/blockchain/chain_database.hpp>
+
+#include <fc/thread/future.hpp>
+
+#include <deque>
+
+namespace bts { namespace blockchain {
+
+   /**
+    *  The trades of one market aggregated over consecutive periods, one array per field. Periods without
+    *  trades are left out. Prices are raw ratios of quote to base shares, not adjusted for asset precision.
+    */
+   struct market_candles
+   {
+      uint32_t                  resolution_sec = 0;
+      vector<uint32_t>          start_time; // Seconds since the epoch
+      vector<double>            open;
+      vector<double>            high;
+      vector<double>            low;
+      vector<double>            close;
+      vector<share_type>        base_volume;
+      vector<share_type>        quote_volume;
+      vector<uint32_t>          trade_count;
+   };
+
+   /**
+    *  Keeps rolling candles for every market at a fixed set of resolutions, built from the market transactions
+    *  of each pushed block. This runs off the block processing path and is not part of consensus; popped blocks
+    *  are undone from a journal of the candles each block with trades changed, and blocks pushed without a
+    *  notification, as while syncing, are caught up from the stored market transactions. The recent blocks
+    *  already in the chain are loaded in the background, so candles fill in over the first moments after startup.
+    */
+   class market_candle_service : public chain_observer
+   {
+      public:
+         explicit market_candle_service( const chain_database_ptr& chain );
+         virtual ~market_candle_service()override;
+
+         virtual void   block_pushed( const full_block& block_data )override;
+         virtual void   block_popped( const pending_chain_state_ptr& undo_state )override;
+
+         market_candles get_candles( const asset_id_type quote_id, const asset_id_type base_id, const uint32_t resolution_sec,
+                                     const time_point_sec start_time, const uint32_t limit )const;
+
+         static const vector<uint32_t>& resolutions();
+
+      private:
+         struct candle
+         {
+            uint32_t            start_time = 0;
+            double              open = 0;
+            double              high = 0;
+            double              low = 0;
+            double              close = 0;
+            share_type          base_volume = 0;
+            share_type          quote_volume = 0;
+            uint32_t            trade_count = 0;
+         };
+
+         struct candle_series
+         {
+            std::deque<uint32_t>        start_time;
+            std::deque<double>          open;
+            std::deque<double>          high;
+            std::deque<double>          low;
+            std::deque<double>          close;
+            std::deque<share_type>      base_volume;
+            std::deque<share_type>      quote_volume;
+            std::deque<uint32_t>        trade_count;
+
+            size_t  size()const { return start_time.size(); }
+            candle  at( const size_t i )const;
+            void    set( const size_t i, const candle& c );
+            void    push_back( const candle& c );
+            void    push_front( const candle& c );
+            void    pop_back();
+            void    pop_front();
+         };
+
+         typedef std::tuple<asset_id_type, asset_id_type, uint32_t> series_key; // Quote, base, resolution
+
+         /** How to restore one series to what it was before a block */
+         struct series_undo
+         {
+            series_key          key;
+            size_t              prior_size = 0;
+            optional<candle>    prior_last;
+            vector<candle>      dropped; // Oldest first
+         };
+
+         struct block_undo
+         {
+            uint32_t            block_num = 0;
+            block_id_type       block_id;
+            vector<series_undo> series;
+         };
+
+         void apply_block( const uint32_t block_num, const block_id_type& block_id, const time_point_sec timestamp,
+                           const vector<market_transaction>& trxs );
+         void apply_stored_blocks( const uint32_t first_block_num, const uint32_t last_block_num );
+         void backfill();
+         void rollback_orphaned_blocks();
+         void undo_last_block();
+         void rollback_to( const uint32_t block_num );
+
+         chain_database_ptr                 _chain;
+         map<series_key, candle_series>     _series;
+         std::deque<block_undo>             _undo; // Most recent block last
+         uint32_t                           _last_block_num = 0; // Last block folded into the candles
+         fc::future<void>                   _backfill_done;
+   };
+   typedef std::shared_ptr<market_candle_service> market_candle_service_ptr;
+
+} } // bts::blockchain
+
+FC_REFLECT( bts::blockchain::market_candles,
+            (resolution_sec)(start_time)(open)(high)(low)(close)(base_volume)(quote_volume)(trade_count) )
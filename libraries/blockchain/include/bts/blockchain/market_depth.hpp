@@ -0,0 +1,104 @@
+#pragma once
+
+#include <bts/blockchain/market_records.hpp>
+
+#include <deque>
+
+namespace bts { namespace blockchain {
+
+   /**
+    *  All orders of one type at one price. The balance is in the asset market_order::get_balance() reports for
+    *  that type: quote for bids and covers, base for asks and shorts. Shorts without a limit are listed at a zero
+    *  price since they execute at the feed.
+    */
+   struct market_depth_level
+   {
+      price                 order_price;
+      share_type            balance = 0;
+      uint32_t              order_count = 0;
+   };
+
+   struct market_depth
+   {
+      uint64_t                      update_id = 0; // Apply updates after this one to keep the snapshot current
+      uint32_t                      block_num = 0;
+      vector<market_depth_level>    bids; // Highest price first
+      vector<market_depth_level>    asks; // Lowest price first
+      vector<market_depth_level>    shorts; // Highest limit first
+      vector<market_depth_level>    covers; // Highest call price first
+   };
+
+   /** The new state of one level; a zero order count means the level is gone */
+   struct market_depth_change
+   {
+      fc::enum_type<uint8_t, order_type_enum>   type = null_order;
+      market_depth_level                        level;
+   };
+
+   /** The levels of one market changed by a pushed or popped block */
+   struct market_depth_update
+   {
+      uint64_t                      update_id = 0;
+      uint32_t                      block_num = 0; // Head block afterwards; goes backwards when blocks are popped
+      vector<market_depth_change>   changes;
+   };
+
+   /**
+    *  Order book depth aggregated by price level for every market. The chain database adjusts it as order records
+    *  are stored and ends an update after each pushed or popped block, recording the levels that changed so that
+    *  clients can follow the book from a snapshot without fetching every order again.
+    */
+   class market_depth_index
+   {
+      public:
+         void clear();
+
+         /** Returns false and leaves the book unchanged if the removed orders are not in it; resync the market then */
+         bool adjust( const order_type_enum type, const asset_id_type quote_id, const asset_id_type base_id,
+                      const price& level_price, const share_type balance, const int32_t order_count );
+
+         /** Empties one market so it can be rebuilt from its orders; the next update reports the removed levels */
+         void reset_market( const asset_id_type quote_id, const asset_id_type base_id );
+
+         /** Records the levels changed since the last update; does nothing if none changed */
+         void end_update( const uint32_t block_num );
+
+         /** Forgets the levels changed since the last update without recording them, e.g. after a rebuild */
+         void discard_changes( const uint32_t block_num );
+
+         market_depth get_depth( const asset_id_type quote_id, const asset_id_type base_id, const uint32_t levels )const;
+
+         vector<market_depth_update> get_updates( const asset_id_type quote_id, const asset_id_type base_id,
+                                                  const uint64_t after_update_id, const uint32_t limit )const;
+
+      private:
+         typedef pair<asset_id_type, asset_id_type>         market_key; // Quote, base
+         typedef map<price, market_depth_level>             side_levels;
+         typedef pair<uint8_t, price>                       level_key; // Order type, price
+
+         struct market_book
+         {
+            side_levels                         bids;
+            side_levels                         asks;
+            side_levels                         shorts;
+            side_levels                         covers;
+
+            std::deque<market_depth_update>     updates; // Oldest first
+            uint64_t                            pruned_update_id = 0; // Last update no longer kept
+         };
+
+         static side_levels&        get_side( market_book& book, const order_type_enum type );
+         static const side_levels&  get_side( const market_book& book, const order_type_enum type );
+
+         map<market_key, market_book>           _books;
+         map<market_key, set<level_key>>        _changed;
+         uint64_t                               _last_update_id = 0;
+         uint32_t                               _block_num = 0;
+   };
+
+} } // bts::blockchain
+
+FC_REFLECT( bts::blockchain::market_depth_level, (order_price)(balance)(order_count) )
+FC_REFLECT( bts::blockchain::market_depth, (update_id)(block_num)(bids)(asks)(shorts)(covers) )
+FC_REFLECT( bts::blockchain::market_depth_change, (type)(level) )
+FC_REFLECT( bts::blockchain::market_depth_update, (update_id)(block_num)(changes) )
@@ -76,17 +76,20 @@ private:
 
 public:
     vector<market_transaction>    _market_transactions;
+    vector<fc::microseconds>      _pass_durations; // Margin calls, expired covers, asks
 
 private:
     bts::db::cached_level_map<market_index_key, order_record>::iterator         _bid_itr;
     bts::db::cached_level_map<market_index_key, order_record>::iterator         _ask_itr;
     bts::db::cached_level_map<market_index_key, collateral_record>::iterator    _collateral_itr;
 
-    map<market_index_key, order_record>                                         _stuck_shorts;
-    map<pair<price, market_index_key>, order_record>                            _unstuck_shorts;
+    // Shorts are walked from the highest interest rate, skipping those with a limit below the feed
+    bts::db::cached_level_map<market_index_key, order_record>::iterator         _stuck_shorts_itr;
 
-    map<market_index_key, order_record>::reverse_iterator                       _stuck_shorts_iter;
-    map<pair<price, market_index_key>, order_record>::reverse_iterator          _unstuck_shorts_iter;
+    // Shorts with a limit below the feed, from the highest (limit, key) down; limits of another asset pair are never at the feed
+    const std::set<short_limit_index>*                                          _unstuck_shorts = nullptr;
+    std::set<short_limit_index>::const_reverse_iterator                         _unstuck_shorts_itr;
+    const std::set<short_limit_index>                                           _no_limited_shorts;
 
     std::set<expiration_index>::iterator                                        _collateral_expiration_itr;
 };
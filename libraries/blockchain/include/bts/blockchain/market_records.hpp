@@ -3,11 +3,13 @@
 #include <bts/blockchain/asset.hpp>
 #include <bts/blockchain/config.hpp>
 #include <bts/blockchain/types.hpp>
+#include <bts/db/key_encoding.hpp>
 
 #include <fc/exception/exception.hpp>
 #include <fc/io/enum_type.hpp>
 #include <fc/time.hpp>
 
+#include <set>
 #include <tuple>
 
 namespace bts { namespace blockchain {
@@ -52,6 +54,66 @@ namespace bts { namespace blockchain {
 
    };
 
+   /** Orders the shorts of one market that have a limit price by (limit price, key), like the market engine walks them */
+   struct short_limit_index
+   {
+      price              limit_price;
+      market_index_key   key;
+
+      friend bool operator < ( const short_limit_index& a, const short_limit_index& b )
+      {
+         return std::tie( a.limit_price, a.key ) < std::tie( b.limit_price, b.key );
+      }
+      friend bool operator == ( const short_limit_index& a, const short_limit_index& b )
+      {
+         return std::tie( a.limit_price, a.key ) == std::tie( b.limit_price, b.key );
+      }
+   };
+
+   /**
+    *  Moves a walk down a market's limited shorts past the ones whose limit is not below the feed, which the
+    *  market engine matches at the feed price instead.  Only limits of the feed's own asset pair can be at or
+    *  above the feed, so those shorts are contiguous and a single seek skips them; limits of any other pair stay
+    *  in the walk in (limit price, key) order.
+    */
+   inline std::set<short_limit_index>::const_reverse_iterator skip_stuck_shorts( const std::set<short_limit_index>& shorts,
+                                                                                 std::set<short_limit_index>::const_reverse_iterator itr,
+                                                                                 const price& feed_price )
+   {
+      if( itr != shorts.rend() && itr->limit_price >= feed_price )
+         itr = std::set<short_limit_index>::const_reverse_iterator( shorts.lower_bound( short_limit_index{ feed_price, market_index_key() } ) );
+      return itr;
+   }
+
+   /** Locates a market transaction by its market and its position in _market_transactions_db */
+   struct market_history_pair_index
+   {
+      asset_id_type      quote_id;
+      asset_id_type      base_id;
+      uint32_t           block_num;
+      uint32_t           seq;
+
+      friend bool operator < ( const market_history_pair_index& a, const market_history_pair_index& b )
+      {
+         // Within a block seq is reversed, so walking backwards gives the newest block first in execution order
+         return std::tie( a.quote_id, a.base_id, a.block_num, b.seq ) < std::tie( b.quote_id, b.base_id, b.block_num, a.seq );
+      }
+   };
+
+   /** Locates a market transaction by one of the order owners and its position in _market_transactions_db */
+   struct market_history_owner_index
+   {
+      address            owner;
+      uint32_t           block_num;
+      uint32_t           seq;
+
+      friend bool operator < ( const market_history_owner_index& a, const market_history_owner_index& b )
+      {
+         // Reversed seq within a block, like market_history_pair_index
+         return std::tie( a.owner, a.block_num, b.seq ) < std::tie( b.owner, b.block_num, a.seq );
+      }
+   };
+
    struct market_history_key
    {
        enum time_granularity_enum {
@@ -278,3 +340,52 @@ FC_REFLECT( bts::blockchain::market_transaction,
             (base_fees)
           )
 FC_REFLECT_DERIVED( bts::blockchain::order_history_record, (bts::blockchain::market_transaction), (timestamp) )
+
+namespace bts { namespace db {
+
+   /** Order books are stored sorted by quote id, base id, ratio, then owner */
+   template<>
+   struct memcmp_key_encoding<bts::blockchain::market_index_key>
+   {
+      static const bool enabled = true;
+
+      static void encode( key_encoding::writer& w, const bts::blockchain::market_index_key& key )
+      {
+         w.write_int32( key.order_price.quote_asset_id.value );
+         w.write_int32( key.order_price.base_asset_id.value );
+         w.write_uint128( key.order_price.ratio );
+         w.write_bytes( key.owner.addr.data(), key.owner.addr.data_size() );
+      }
+
+      static void decode( key_encoding::reader& r, bts::blockchain::market_index_key& key )
+      {
+         key.order_price.quote_asset_id = r.read_int32();
+         key.order_price.base_asset_id = r.read_int32();
+         key.order_price.ratio = r.read_uint128();
+         r.read_bytes( key.owner.addr.data(), key.owner.addr.data_size() );
+      }
+   };
+
+   template<>
+   struct memcmp_key_encoding<bts::blockchain::market_history_key>
+   {
+      static const bool enabled = true;
+
+      static void encode( key_encoding::writer& w, const bts::blockchain::market_history_key& key )
+      {
+         w.write_int32( key.quote_id.value );
+         w.write_int32( key.base_id.value );
+         w.write_int32( key.granularity );
+         w.write_uint32( key.timestamp.sec_since_epoch() );
+      }
+
+      static void decode( key_encoding::reader& r, bts::blockchain::market_history_key& key )
+      {
+         key.quote_id = r.read_int32();
+         key.base_id = r.read_int32();
+         key.granularity = bts::blockchain::market_history_key::time_granularity_enum( r.read_int32() );
+         key.timestamp = fc::time_point_sec( r.read_uint32() );
+      }
+   };
+
+} } // bts::db
@@ -5,6 +5,42 @@
 
 namespace bts { namespace blockchain {
 
+   class pending_chain_state;
+
+   /**
+    *  The keys a pending transaction looked up while it was evaluated, or the keys a block or transaction
+    *  wrote. Used to decide which pending transactions must be re-evaluated after a new block; anything
+    *  that is not tracked by key (slots, burns, status, market scans, ...) sets the other flag.
+    *
+    *  Assets are tracked in three parts, because nearly every transaction pays fees in the base asset and
+    *  every block pays a delegate from it: the definition (everything but the supply and collected fees),
+    *  the supply and collected fees, and collected fee deltas, which commute with each other.
+    */
+   struct pending_read_set
+   {
+      set<property_id_type>             property_ids;
+      unordered_set<account_id_type>    account_ids;
+      unordered_set<string>             account_names;
+      unordered_set<address>            account_addresses;
+      unordered_set<asset_id_type>      asset_ids;
+      unordered_set<asset_id_type>      asset_supply_ids;
+      unordered_set<asset_id_type>      asset_fee_ids;
+      unordered_set<string>             asset_symbols;
+      unordered_set<slate_id_type>      slate_ids;
+      unordered_set<balance_id_type>    balance_ids;
+      unordered_set<asset_id_type>      feed_quote_ids;
+      set<market_index_key>             order_keys;
+      bool                              other = false;
+
+      void add_writes( const pending_chain_state& state );
+      void add( const pending_read_set& keys );
+
+      /** Not symmetric: fee deltas in keys conflict with supply keys in this set, but not the other way around */
+      bool intersects( const pending_read_set& keys )const;
+      void clear();
+   };
+   typedef std::shared_ptr<pending_read_set> pending_read_set_ptr;
+
    class pending_chain_state : public chain_interface, public std::enable_shared_from_this<pending_chain_state>
    {
       public:
@@ -42,6 +78,13 @@ namespace bts { namespace blockchain {
          void                           build_undo_state( const chain_interface_ptr& undo_state )const;
          void                           apply_changes()const;
 
+         /**
+          *  Same result as apply_changes(), but when the previous state is another pending_chain_state the
+          *  records are moved straight into its maps instead of being copied through the chain_interface
+          *  store path. Leaves this state empty, so use it only when this layer is discarded afterwards.
+          */
+         void                           commit_changes();
+
          template<typename T, typename U>
          void populate_undo_state( const chain_interface_ptr& undo_state, const chain_interface_ptr& prev_state,
                                    const T& store_map, const U& remove_set )const
@@ -78,6 +121,18 @@ namespace bts { namespace blockchain {
 
          void                           check_supplies()const;
 
+         /** Record every key looked up through this state into read_set until it is reset */
+         void                           track_reads( const pending_read_set_ptr& read_set ) { _read_set = read_set; }
+
+         /**
+          *  Adds to an asset's collected fees. While reads are tracked the amount is kept as a delta and folded
+          *  into the previous state when the changes are applied, so only the asset's definition is read.
+          */
+         void                           add_collected_fees( const asset_id_type id, const share_type amount );
+
+         /** Same as get_asset_record(), but records a read of the definition only, not the supply or fees */
+         oasset_record                  get_asset_definition( const asset_id_type id )const;
+
          map<property_id_type, property_record>                             _property_id_to_record;
          set<property_id_type>                                              _property_id_remove;
 
@@ -124,8 +179,17 @@ namespace bts { namespace blockchain {
          map<market_history_key, market_history_record>                     market_history;
 
       private:
+         friend struct pending_read_set;
+
          // Not serialized
          std::weak_ptr<chain_interface>                                     _prev_state;
+         pending_read_set_ptr                                               _read_set;
+         unordered_map<asset_id_type, share_type>                           _collected_fee_deltas;
+         unordered_set<asset_id_type>                                       _asset_supply_only_ids; // Stored with an unchanged definition
+
+         oasset_record                  find_asset( const asset_id_type id )const;
+         void                           fold_collected_fees( oasset_record& record )const;
+         void                           apply_collected_fees( const chain_interface_ptr& prev_state )const;
 
          virtual oproperty_record property_lookup_by_id( const property_id_type )const override;
          virtual void property_insert_into_id_map( const property_id_type, const property_record& )override;
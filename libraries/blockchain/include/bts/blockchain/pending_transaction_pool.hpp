@@ -0,0 +1,119 @@
+#pragma once
+
+#include <bts/blockchain/config.hpp>
+#include <bts/blockchain/transaction.hpp>
+#include <fc/uint128.hpp>
+
+namespace bts { namespace blockchain {
+
+   struct pending_pool_stats
+   {
+      uint32_t                       transaction_count = 0;
+      uint64_t                       total_bytes = 0;
+      uint64_t                       max_bytes = 0;
+      uint32_t                       max_transactions_per_address = 0;
+      uint32_t                       signer_count = 0; // Distinct addresses that signed a pending transaction
+      share_type                     min_fee_per_kilobyte = 0; // Of the next transaction to be evicted
+      optional<time_point_sec>       next_expiration;
+      uint64_t                       evicted_count = 0;
+      uint64_t                       expired_count = 0;
+      uint64_t                       rejected_count = 0;
+      uint64_t                       reused_count = 0; // Saved evaluations kept when the pending state was rebuilt
+      uint64_t                       reevaluated_count = 0;
+   };
+
+   /**
+    *  The transactions waiting to be included in a block, bounded by their total packed size. When it is full a new
+    *  transaction is only taken if it pays more per byte than the transactions evicted to make room for it, and no
+    *  address may sign more than a fixed number of pending transactions. Transactions submitted by this client are
+    *  counted but never evicted. The fees and signers are whatever the chain database last evaluated.
+    */
+   class pending_transaction_pool
+   {
+      public:
+         struct entry
+         {
+            signed_transaction  trx;
+            uint32_t            size = 0;
+            share_type          fees = 0;
+            set<address>        signers;
+            bool                local = false;
+         };
+
+         void set_limits( const uint64_t max_bytes, const uint32_t max_transactions_per_address );
+         void clear();
+
+         bool                   contains( const transaction_id_type& id )const { return _entries.count( id ) > 0; }
+         size_t                 size()const { return _entries.size(); }
+
+         /** Ordered by transaction id, which is the order pending transactions are evaluated in */
+         const map<transaction_id_type, entry>& entries()const { return _entries; }
+
+         /** Throws a subclass of insufficient_relay_fee if insert() would not take the transaction */
+         void check_admission( const uint32_t size, const share_type fees, const set<address>& signers )const;
+
+         /** Returns the transactions evicted to make room, cheapest first */
+         vector<transaction_id_type> insert( const transaction_id_type& id, const signed_transaction& trx,
+                                             const share_type fees, const set<address>& signers, const bool local );
+
+         /** Records the result of evaluating an existing transaction again */
+         void update( const transaction_id_type& id, const share_type fees, const set<address>& signers );
+
+         bool remove( const transaction_id_type& id );
+
+         /** Removes and returns the transactions that expire at or before the given time */
+         vector<transaction_id_type> remove_expired( const time_point_sec now );
+
+         void note_rejected() { ++_rejected_count; }
+         void note_revalidated( const bool reused ) { ++(reused ? _reused_count : _reevaluated_count); }
+
+         pending_pool_stats get_stats()const;
+
+      private:
+         struct fee_rate_key
+         {
+            share_type          fees;
+            uint32_t            size;
+            transaction_id_type id;
+
+            /** Cheapest per byte first */
+            friend bool operator < ( const fee_rate_key& a, const fee_rate_key& b )
+            {
+                const fc::uint128_t lhs = fc::uint128_t( uint64_t( std::max<share_type>( a.fees, 0 ) ) ) * b.size;
+                const fc::uint128_t rhs = fc::uint128_t( uint64_t( std::max<share_type>( b.fees, 0 ) ) ) * a.size;
+                if( lhs != rhs ) return lhs < rhs;
+                return a.id < b.id;
+            }
+         };
+
+         static fee_rate_key    make_fee_rate_key( const transaction_id_type& id, const entry& e );
+
+         void                   add_signers( const set<address>& signers );
+         void                   remove_signers( const set<address>& signers );
+         void                   erase( map<transaction_id_type, entry>::iterator iter );
+
+         /** Returns the cheapest transactions that would have to go to fit size more bytes, or throws */
+         vector<transaction_id_type> select_evictions( const uint32_t size, const share_type fees )const;
+
+         map<transaction_id_type, entry>                     _entries;
+         set<fee_rate_key>                                   _by_fee_rate; // Local transactions are left out
+         set<pair<time_point_sec, transaction_id_type>>      _by_expiration;
+         unordered_map<address, uint32_t>                    _signer_counts;
+
+         uint64_t                                            _total_bytes = 0;
+         uint64_t                                            _max_bytes = BTS_BLOCKCHAIN_MAX_PENDING_POOL_BYTES;
+         uint32_t                                            _max_per_address = BTS_BLOCKCHAIN_MAX_PENDING_TRANSACTIONS_PER_ADDRESS;
+
+         uint64_t                                            _evicted_count = 0;
+         uint64_t                                            _expired_count = 0;
+         uint64_t                                            _rejected_count = 0;
+         uint64_t                                            _reused_count = 0;
+         uint64_t                                            _reevaluated_count = 0;
+   };
+
+} } // bts::blockchain
+
+FC_REFLECT( bts::blockchain::pending_pool_stats,
+            (transaction_count)(total_bytes)(max_bytes)(max_transactions_per_address)(signer_count)
+            (min_fee_per_kilobyte)(next_expiration)(evicted_count)(expired_count)(rejected_count)
+            (reused_count)(reevaluated_count) )
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <bts/blockchain/types.hpp>
+
+#include <fc/crypto/sha256.hpp>
+#include <fc/filesystem.hpp>
+#include <fc/time.hpp>
+
+#include <boost/filesystem/fstream.hpp>
+
+namespace bts { namespace blockchain {
+
+   struct state_snapshot_header
+   {
+      uint32_t          format_version = 0;
+      uint64_t          database_version = 0;
+      uint32_t          block_num = 0;
+      block_id_type     block_id;
+      time_point_sec    timestamp;
+   };
+
+   /**
+    *  Writes the contents of the chain databases as of one block to a binary file, so that a node can
+    *  restore them after an unclean shutdown and replay only the blocks that came after.
+    *
+    *  The file is a header followed by one section per database holding its stored key and value bytes,
+    *  and ends with the sha256 of everything before it. It is written under a temporary name and only
+    *  renamed into place by finish(), so an interrupted write never replaces a good snapshot.
+    */
+   class state_snapshot_writer
+   {
+      public:
+         state_snapshot_writer( const fc::path& filename, const state_snapshot_header& header );
+         ~state_snapshot_writer();
+
+         void begin_section( const string& name );
+         void add_entry( const char* key, uint32_t key_size, const char* value, uint32_t value_size );
+         void end_section();
+
+         void finish();
+
+      private:
+         void write( const char* data, size_t size );
+         void write_uint8( uint8_t value ) { write( (const char*)&value, sizeof( value ) ); }
+         void write_uint32( uint32_t value ) { write( (const char*)&value, sizeof( value ) ); }
+
+         fc::path                           _filename;
+         fc::path                           _temp_filename;
+         boost::filesystem::ofstream        _out;
+         fc::sha256::encoder                _checksum;
+         bool                               _finished = false;
+   };
+
+   /** Verifies the checksum of a file written by state_snapshot_writer and reads it back section by section */
+   class state_snapshot_reader
+   {
+      public:
+         explicit state_snapshot_reader( const fc::path& filename );
+
+         const state_snapshot_header&   header()const { return _header; }
+
+         /** Returns false after the last section */
+         bool                           next_section( string& name );
+
+         /** Returns false at the end of the current section */
+         bool                           next_entry( string& key, string& value );
+
+      private:
+         void       read( char* data, size_t size );
+         uint8_t    read_uint8();
+         uint32_t   read_uint32();
+         string     read_string();
+
+         boost::filesystem::ifstream        _in;
+         state_snapshot_header              _header;
+   };
+
+} } // bts::blockchain
+
+FC_REFLECT( bts::blockchain::state_snapshot_header, (format_version)(database_version)(block_num)(block_id)(timestamp) )
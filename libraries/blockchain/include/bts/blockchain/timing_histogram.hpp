@@ -0,0 +1,101 @@
+#pragma once
+
+#include <fc/reflect/reflect.hpp>
+#include <fc/time.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace bts { namespace blockchain {
+
+   struct timing_summary
+   {
+      uint64_t    count = 0;
+      int64_t     total_us = 0;
+      int64_t     mean_us = 0;
+      int64_t     p50_us = 0;
+      int64_t     p99_us = 0;
+      int64_t     max_us = 0;
+   };
+
+   /**
+    *  Counts durations in buckets that each cover a factor of two in microseconds, so recording is cheap and
+    *  the memory used is fixed. Percentiles are reported as the upper bound of the bucket they fall in.
+    */
+   class timing_histogram
+   {
+      public:
+         void record( const fc::microseconds& duration )
+         {
+            const uint64_t us = uint64_t( std::max<int64_t>( duration.count(), 0 ) );
+
+            size_t bucket = 0;
+            while( bucket + 1 < _buckets.size() && (us >> bucket) != 0 )
+                ++bucket;
+
+            ++_buckets[ bucket ];
+            ++_count;
+            _total_us += us;
+            _max_us = std::max( _max_us, us );
+         }
+
+         void reset()
+         {
+            *this = timing_histogram();
+         }
+
+         timing_summary summary()const
+         {
+            timing_summary result;
+            result.count = _count;
+            result.total_us = int64_t( _total_us );
+            result.mean_us = _count > 0 ? int64_t( _total_us / _count ) : 0;
+            result.p50_us = int64_t( percentile( 0.50 ) );
+            result.p99_us = int64_t( percentile( 0.99 ) );
+            result.max_us = int64_t( _max_us );
+            return result;
+         }
+
+      private:
+         uint64_t percentile( double fraction )const
+         {
+            if( _count == 0 ) return 0;
+
+            const uint64_t rank = std::max<uint64_t>( 1, uint64_t( std::ceil( fraction * _count ) ) );
+            uint64_t seen = 0;
+            for( size_t bucket = 0; bucket < _buckets.size(); ++bucket )
+            {
+                seen += _buckets[ bucket ];
+                if( seen >= rank )
+                    return std::min( _max_us, bucket == 0 ? 0 : (uint64_t( 1 ) << bucket) - 1 );
+            }
+            return _max_us;
+         }
+
+         std::array<uint64_t, 48>   _buckets = {}; // Bucket n holds durations below 2^n us
+         uint64_t                   _count = 0;
+         uint64_t                   _total_us = 0;
+         uint64_t                   _max_us = 0;
+   };
+
+   /** Records the time from construction to destruction, including when unwinding from an exception */
+   class scoped_timer
+   {
+      public:
+         explicit scoped_timer( timing_histogram& histogram )
+         :_histogram( histogram ),_start( fc::time_point::now() ){}
+
+         ~scoped_timer()
+         {
+            _histogram.record( fc::time_point::now() - _start );
+         }
+
+      private:
+         timing_histogram&  _histogram;
+         fc::time_point     _start;
+   };
+
+} } // bts::blockchain
+
+FC_REFLECT( bts::blockchain::timing_summary, (count)(total_us)(mean_us)(p50_us)(p99_us)(max_us) )
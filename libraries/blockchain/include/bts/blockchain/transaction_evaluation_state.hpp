@@ -32,6 +32,9 @@ struct transaction_evaluation_state
         return ptr.get();
     }
 
+    static set<address> recover_signed_addresses( const signed_transaction& trx, const digest_type& chain_id,
+                                                  const bool enforce_canonical = false );
+
     void evaluate( const signed_transaction& trx );
     void evaluate_operation( const operation& op );
 
@@ -71,6 +74,9 @@ struct transaction_evaluation_state
     bool                                           _skip_signature_check = false;
     bool                                           _enforce_canonical_signatures = false;
     bool                                           _skip_vote_adjustment = false;
+    optional<set<address>>                         _preverified_signed_addresses;
+    bool                                           _record_operation_times = false;
+    vector<fc::microseconds>                       _operation_times; // One per operation when recording
 
 private:
     std::weak_ptr<pending_chain_state>             _pending_state;
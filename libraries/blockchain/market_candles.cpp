@@ -0,0 +1,330 @@
+#include <bts/blockchain/config.hpp>
+#include <bts/blockchain/market_candles.hpp>
+
+#include <fc/thread/thread.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace bts { namespace blockchain {
+
+   market_candle_service::candle market_candle_service::candle_series::at( const size_t i )const
+   {
+      candle c;
+      c.start_time = start_time.at( i );
+      c.open = open.at( i );
+      c.high = high.at( i );
+      c.low = low.at( i );
+      c.close = close.at( i );
+      c.base_volume = base_volume.at( i );
+      c.quote_volume = quote_volume.at( i );
+      c.trade_count = trade_count.at( i );
+      return c;
+   }
+
+   void market_candle_service::candle_series::set( const size_t i, const candle& c )
+   {
+      start_time.at( i ) = c.start_time;
+      open.at( i ) = c.open;
+      high.at( i ) = c.high;
+      low.at( i ) = c.low;
+      close.at( i ) = c.close;
+      base_volume.at( i ) = c.base_volume;
+      quote_volume.at( i ) = c.quote_volume;
+      trade_count.at( i ) = c.trade_count;
+   }
+
+   void market_candle_service::candle_series::push_back( const candle& c )
+   {
+      start_time.push_back( c.start_time );
+      open.push_back( c.open );
+      high.push_back( c.high );
+      low.push_back( c.low );
+      close.push_back( c.close );
+      base_volume.push_back( c.base_volume );
+      quote_volume.push_back( c.quote_volume );
+      trade_count.push_back( c.trade_count );
+   }
+
+   void market_candle_service::candle_series::push_front( const candle& c )
+   {
+      start_time.push_front( c.start_time );
+      open.push_front( c.open );
+      high.push_front( c.high );
+      low.push_front( c.low );
+      close.push_front( c.close );
+      base_volume.push_front( c.base_volume );
+      quote_volume.push_front( c.quote_volume );
+      trade_count.push_front( c.trade_count );
+   }
+
+   void market_candle_service::candle_series::pop_back()
+   {
+      start_time.pop_back();
+      open.pop_back();
+      high.pop_back();
+      low.pop_back();
+      close.pop_back();
+      base_volume.pop_back();
+      quote_volume.pop_back();
+      trade_count.pop_back();
+   }
+
+   void market_candle_service::candle_series::pop_front()
+   {
+      start_time.pop_front();
+      open.pop_front();
+      high.pop_front();
+      low.pop_front();
+      close.pop_front();
+      base_volume.pop_front();
+      quote_volume.pop_front();
+      trade_count.pop_front();
+   }
+
+   const vector<uint32_t>& market_candle_service::resolutions()
+   {
+      static const vector<uint32_t> resolutions{ 60, 5 * 60, 15 * 60, 60 * 60, 4 * 60 * 60, 24 * 60 * 60, 7 * 24 * 60 * 60 };
+      return resolutions;
+   }
+
+   market_candle_service::market_candle_service( const chain_database_ptr& chain )
+   :_chain( chain )
+   { try {
+      FC_ASSERT( _chain != nullptr );
+
+      const uint32_t head_block_num = _chain->get_head_block_num();
+      if( head_block_num > BTS_BLOCKCHAIN_MARKET_CANDLE_BACKFILL_BLOCKS )
+          _last_block_num = head_block_num - BTS_BLOCKCHAIN_MARKET_CANDLE_BACKFILL_BLOCKS;
+
+      _chain->add_observer( this );
+
+      // Loading a week of blocks takes a while, so do not hold up the client starting
+      _backfill_done = fc::async( [ this ](){ backfill(); }, "market_candle_backfill" );
+   } FC_CAPTURE_AND_RETHROW() }
+
+   market_candle_service::~market_candle_service()
+   {
+      try
+      {
+          if( _backfill_done.valid() && !_backfill_done.ready() )
+              _backfill_done.cancel_and_wait( "~market_candle_service()" );
+      }
+      catch( const fc::exception& e )
+      {
+          wlog( "Unexpected exception while stopping the market candle backfill: ${e}", ("e",e.to_detail_string()) );
+      }
+      _chain->remove_observer( this );
+   }
+
+   void market_candle_service::backfill()
+   {
+      try
+      {
+          while( true )
+          {
+              rollback_orphaned_blocks();
+
+              const uint32_t head_block_num = _chain->get_head_block_num();
+              if( _last_block_num >= head_block_num )
+                  break;
+
+              apply_stored_blocks( _last_block_num + 1,
+                                   std::min( head_block_num, _last_block_num + BTS_BLOCKCHAIN_MARKET_CANDLE_BACKFILL_BATCH ) );
+              fc::yield();
+          }
+      }
+      catch( const fc::canceled_exception& )
+      {
+          throw;
+      }
+      catch( const fc::exception& e )
+      {
+          elog( "Market candle backfill failed: ${e}", ("e",e.to_detail_string()) );
+      }
+   }
+
+   void market_candle_service::block_pushed( const full_block& block_data )
+   { try {
+      // The backfill checks the head block again before it finishes, so it folds this block in too
+      if( _backfill_done.valid() && !_backfill_done.ready() )
+          return;
+
+      const uint32_t block_num = block_data.block_num;
+
+      // Drop anything left over from a fork we were not told about
+      rollback_to( block_num - 1 );
+
+      // The chain only notifies observers of blocks near the present, so catch up on any it skipped
+      if( _last_block_num + 1 < block_num )
+          apply_stored_blocks( _last_block_num + 1, std::min( block_num - 1, _chain->get_head_block_num() ) );
+
+      apply_block( block_num, block_data.id(), block_data.timestamp, _chain->get_market_transactions( block_num ) );
+   } FC_CAPTURE_AND_RETHROW( (block_data.block_num) ) }
+
+   void market_candle_service::block_popped( const pending_chain_state_ptr& undo_state )
+   { try {
+      // Notifications run later, so the chain may have moved on since
+      rollback_orphaned_blocks();
+   } FC_CAPTURE_AND_RETHROW() }
+
+   /** Undoes every journaled block that is no longer part of the chain, which ignores blocks never folded in */
+   void market_candle_service::rollback_orphaned_blocks()
+   {
+      while( !_undo.empty() && !_chain->is_included_block( _undo.back().block_id ) )
+          rollback_to( _undo.back().block_num - 1 );
+   }
+
+   void market_candle_service::apply_stored_blocks( const uint32_t first_block_num, const uint32_t last_block_num )
+   { try {
+      const uint32_t backfill_start = last_block_num > BTS_BLOCKCHAIN_MARKET_CANDLE_BACKFILL_BLOCKS
+                                      ? last_block_num - BTS_BLOCKCHAIN_MARKET_CANDLE_BACKFILL_BLOCKS + 1 : 1;
+      for( uint32_t block_num = std::max( first_block_num, backfill_start ); block_num <= last_block_num; ++block_num )
+      {
+          const vector<market_transaction> trxs = _chain->get_market_transactions( block_num );
+          if( trxs.empty() ) continue;
+          const signed_block_header header = _chain->get_block_header( block_num );
+          apply_block( block_num, header.id(), header.timestamp, trxs );
+      }
+      _last_block_num = std::max( _last_block_num, last_block_num );
+   } FC_CAPTURE_AND_RETHROW( (first_block_num)(last_block_num) ) }
+
+   void market_candle_service::rollback_to( const uint32_t block_num )
+   {
+      while( !_undo.empty() && _undo.back().block_num > block_num )
+          undo_last_block();
+      _last_block_num = std::min( _last_block_num, block_num );
+   }
+
+   void market_candle_service::apply_block( const uint32_t block_num, const block_id_type& block_id,
+                                            const time_point_sec timestamp, const vector<market_transaction>& trxs )
+   { try {
+      _last_block_num = block_num;
+
+      block_undo undo;
+      undo.block_num = block_num;
+      undo.block_id = block_id;
+      map<series_key, size_t> touched; // Index into undo.series
+
+      for( const market_transaction& trx : trxs )
+      {
+          // Skip automatic cancels
+          if( trx.bid_received.amount == 0 && trx.ask_received.amount == 0 )
+              continue;
+
+          const price& trade_price = trx.bid_index.order_price;
+          const double ratio = atof( trade_price.ratio_string().c_str() );
+
+          for( const uint32_t resolution : resolutions() )
+          {
+              const series_key key( trade_price.quote_asset_id, trade_price.base_asset_id, resolution );
+              const uint32_t start_time = timestamp.sec_since_epoch() - timestamp.sec_since_epoch() % resolution;
+              candle_series& series = _series[ key ];
+
+              if( series.size() > 0 && series.start_time.back() > start_time )
+                  continue;
+
+              if( touched.count( key ) == 0 )
+              {
+                  series_undo change;
+                  change.key = key;
+                  change.prior_size = series.size();
+                  if( series.size() > 0 )
+                      change.prior_last = series.at( series.size() - 1 );
+                  touched[ key ] = undo.series.size();
+                  undo.series.push_back( std::move( change ) );
+              }
+
+              if( series.size() == 0 || series.start_time.back() < start_time )
+              {
+                  candle c;
+                  c.start_time = start_time;
+                  c.open = c.high = c.low = c.close = ratio;
+                  series.push_back( c );
+              }
+
+              candle c = series.at( series.size() - 1 );
+              c.high = std::max( c.high, ratio );
+              c.low = std::min( c.low, ratio );
+              c.close = ratio;
+              c.base_volume += trx.bid_received.amount;
+              c.quote_volume += trx.ask_received.amount;
+              ++c.trade_count;
+              series.set( series.size() - 1, c );
+          }
+      }
+
+      for( series_undo& change : undo.series )
+      {
+          candle_series& series = _series.at( change.key );
+          while( series.size() > BTS_BLOCKCHAIN_MARKET_CANDLE_RETENTION )
+          {
+              change.dropped.push_back( series.at( 0 ) );
+              series.pop_front();
+          }
+      }
+
+      // Blocks without trades changed nothing, so there is nothing to journal
+      if( !undo.series.empty() )
+          _undo.push_back( std::move( undo ) );
+      while( !_undo.empty() && _undo.front().block_num + BTS_BLOCKCHAIN_MAX_UNDO_HISTORY <= block_num )
+          _undo.pop_front();
+   } FC_CAPTURE_AND_RETHROW( (block_num)(timestamp) ) }
+
+   void market_candle_service::undo_last_block()
+   {
+      const block_undo& undo = _undo.back();
+      for( auto iter = undo.series.rbegin(); iter != undo.series.rend(); ++iter )
+      {
+          const series_undo& change = *iter;
+          candle_series& series = _series.at( change.key );
+
+          for( auto dropped_iter = change.dropped.rbegin(); dropped_iter != change.dropped.rend(); ++dropped_iter )
+              series.push_front( *dropped_iter );
+
+          while( series.size() > change.prior_size )
+              series.pop_back();
+
+          if( change.prior_last.valid() )
+              series.set( series.size() - 1, *change.prior_last );
+
+          if( series.size() == 0 )
+              _series.erase( change.key );
+      }
+      _undo.pop_back();
+   }
+
+   market_candles market_candle_service::get_candles( const asset_id_type quote_id, const asset_id_type base_id,
+                                                      const uint32_t resolution_sec, const time_point_sec start_time,
+                                                      const uint32_t limit )const
+   { try {
+      const auto& supported = resolutions();
+      FC_ASSERT( std::find( supported.begin(), supported.end(), resolution_sec ) != supported.end(),
+                 "Resolution must be one of ${r}", ("r",supported) );
+      FC_ASSERT( limit <= 10000, "Limit must be at most 10000!" );
+
+      market_candles result;
+      result.resolution_sec = resolution_sec;
+
+      const auto iter = _series.find( series_key( quote_id, base_id, resolution_sec ) );
+      if( iter == _series.end() )
+          return result;
+
+      const candle_series& series = iter->second;
+      const size_t first = std::lower_bound( series.start_time.begin(), series.start_time.end(),
+                                             start_time.sec_since_epoch() - start_time.sec_since_epoch() % resolution_sec )
+                           - series.start_time.begin();
+      const size_t last = std::min( series.size(), first + limit );
+
+      result.start_time.assign( series.start_time.begin() + first, series.start_time.begin() + last );
+      result.open.assign( series.open.begin() + first, series.open.begin() + last );
+      result.high.assign( series.high.begin() + first, series.high.begin() + last );
+      result.low.assign( series.low.begin() + first, series.low.begin() + last );
+      result.close.assign( series.close.begin() + first, series.close.begin() + last );
+      result.base_volume.assign( series.base_volume.begin() + first, series.base_volume.begin() + last );
+      result.quote_volume.assign( series.quote_volume.begin() + first, series.quote_volume.begin() + last );
+      result.trade_count.assign( series.trade_count.begin() + first, series.trade_count.begin() + last );
+      return result;
+   } FC_CAPTURE_AND_RETHROW( (quote_id)(base_id)(resolution_sec)(start_time)(limit) ) }
+
+} } // bts::blockchain
@@ -0,0 +1,183 @@
+#include <bts/blockchain/config.hpp>
+#include <bts/blockchain/market_depth.hpp>
+
+#include <algorithm>
+
+namespace bts { namespace blockchain {
+
+   market_depth_index::side_levels& market_depth_index::get_side( market_book& book, const order_type_enum type )
+   {
+      switch( type )
+      {
+         case bid_order:   return book.bids;
+         case ask_order:   return book.asks;
+         case short_order: return book.shorts;
+         case cover_order: return book.covers;
+         default:
+            FC_ASSERT( false, "Unsupported order type: ${t}", ("t",type) );
+      }
+   }
+
+   const market_depth_index::side_levels& market_depth_index::get_side( const market_book& book, const order_type_enum type )
+   {
+      return get_side( const_cast<market_book&>( book ), type );
+   }
+
+   void market_depth_index::clear()
+   {
+      _books.clear();
+      _changed.clear();
+   }
+
+   bool market_depth_index::adjust( const order_type_enum type, const asset_id_type quote_id, const asset_id_type base_id,
+                                    const price& level_price, const share_type balance, const int32_t order_count )
+   {
+      const market_key market( quote_id, base_id );
+      side_levels& side = get_side( _books[ market ], type );
+
+      auto iter = side.find( level_price );
+      if( iter == side.end() )
+      {
+          if( order_count <= 0 )
+              return false;
+          market_depth_level level;
+          level.order_price = level_price;
+          iter = side.emplace( level_price, level ).first;
+      }
+      else if( order_count < 0 && iter->second.order_count < uint32_t( -order_count ) )
+      {
+          return false;
+      }
+
+      market_depth_level& level = iter->second;
+      level.balance += balance;
+      level.order_count += order_count;
+
+      if( level.order_count == 0 )
+          side.erase( iter );
+
+      _changed[ market ].emplace( uint8_t( type ), level_price );
+      return true;
+   }
+
+   void market_depth_index::reset_market( const asset_id_type quote_id, const asset_id_type base_id )
+   {
+      const market_key market( quote_id, base_id );
+      const auto book_iter = _books.find( market );
+      if( book_iter == _books.end() )
+          return;
+
+      set<level_key>& changed = _changed[ market ];
+      for( const order_type_enum type : { bid_order, ask_order, short_order, cover_order } )
+      {
+          side_levels& side = get_side( book_iter->second, type );
+          for( const auto& item : side )
+              changed.emplace( uint8_t( type ), item.first );
+          side.clear();
+      }
+   }
+
+   void market_depth_index::end_update( const uint32_t block_num )
+   {
+      _block_num = block_num;
+
+      for( const auto& item : _changed )
+      {
+          market_book& book = _books[ item.first ];
+
+          market_depth_update update;
+          update.update_id = ++_last_update_id;
+          update.block_num = block_num;
+          update.changes.reserve( item.second.size() );
+
+          for( const level_key& key : item.second )
+          {
+              const order_type_enum type = order_type_enum( key.first );
+              const side_levels& side = get_side( book, type );
+
+              market_depth_change change;
+              change.type = type;
+              const auto iter = side.find( key.second );
+              if( iter != side.end() )
+                  change.level = iter->second;
+              else
+                  change.level.order_price = key.second;
+              update.changes.push_back( std::move( change ) );
+          }
+
+          book.updates.push_back( std::move( update ) );
+          while( book.updates.size() > BTS_BLOCKCHAIN_MARKET_DEPTH_UPDATE_HISTORY )
+          {
+              book.pruned_update_id = book.updates.front().update_id;
+              book.updates.pop_front();
+          }
+      }
+
+      _changed.clear();
+   }
+
+   void market_depth_index::discard_changes( const uint32_t block_num )
+   {
+      _block_num = block_num;
+      _changed.clear();
+   }
+
+   market_depth market_depth_index::get_depth( const asset_id_type quote_id, const asset_id_type base_id,
+                                               const uint32_t levels )const
+   { try {
+      market_depth result;
+      result.update_id = _last_update_id;
+      result.block_num = _block_num;
+
+      const auto book_iter = _books.find( market_key( quote_id, base_id ) );
+      if( book_iter == _books.end() )
+          return result;
+
+      const market_book& book = book_iter->second;
+
+      const auto copy_ascending = [ levels ]( const side_levels& side, vector<market_depth_level>& out )
+      {
+          out.reserve( std::min<size_t>( levels, side.size() ) );
+          for( auto iter = side.begin(); iter != side.end() && out.size() < levels; ++iter )
+              out.push_back( iter->second );
+      };
+
+      const auto copy_descending = [ levels ]( const side_levels& side, vector<market_depth_level>& out )
+      {
+          out.reserve( std::min<size_t>( levels, side.size() ) );
+          for( auto iter = side.rbegin(); iter != side.rend() && out.size() < levels; ++iter )
+              out.push_back( iter->second );
+      };
+
+      copy_descending( book.bids, result.bids );
+      copy_ascending( book.asks, result.asks );
+      copy_descending( book.shorts, result.shorts );
+      copy_descending( book.covers, result.covers );
+
+      return result;
+   } FC_CAPTURE_AND_RETHROW( (quote_id)(base_id)(levels) ) }
+
+   vector<market_depth_update> market_depth_index::get_updates( const asset_id_type quote_id, const asset_id_type base_id,
+                                                                const uint64_t after_update_id, const uint32_t limit )const
+   { try {
+      vector<market_depth_update> results;
+
+      const auto book_iter = _books.find( market_key( quote_id, base_id ) );
+      if( book_iter == _books.end() )
+          return results;
+
+      FC_ASSERT( after_update_id <= _last_update_id, "Unknown update ${id}; fetch a new snapshot", ("id",after_update_id) );
+
+      const market_book& book = book_iter->second;
+      FC_ASSERT( after_update_id >= book.pruned_update_id,
+                 "Updates after ${id} are no longer available; fetch a new snapshot", ("id",after_update_id) );
+
+      auto iter = std::upper_bound( book.updates.begin(), book.updates.end(), after_update_id,
+                                    []( const uint64_t id, const market_depth_update& update ) { return id < update.update_id; } );
+      for( ; iter != book.updates.end() && results.size() < limit; ++iter )
+          results.push_back( *iter );
+
+      return results;
+   } FC_CAPTURE_AND_RETHROW( (quote_id)(base_id)(after_update_id)(limit) ) }
+
+} } // bts::blockchain
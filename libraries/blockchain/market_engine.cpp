@@ -83,41 +83,23 @@ bool market_engine::execute( const asset_id_type quote_id, const asset_id_type b
 
             if( _feed_price.valid() )
             {
-                auto short_iter = _db_impl._short_db.lower_bound( market_index_key( next_pair ) );
-                if( short_iter.valid() ) --short_iter;
-                else short_iter = _db_impl._short_db.last();
+                _stuck_shorts_itr = _db_impl._short_db.lower_bound( market_index_key( next_pair ) );
+                if( _stuck_shorts_itr.valid() ) --_stuck_shorts_itr;
+                else _stuck_shorts_itr = _db_impl._short_db.last();
 
-                for( ; short_iter.valid(); --short_iter )
-                {
-                    const market_index_key& key = short_iter.key();
-                    if( key.order_price.quote_asset_id != _quote_id || key.order_price.base_asset_id != _base_id )
-                        break;
-
-                    const order_record& order = short_iter.value();
-                    if( !order.limit_price.valid() )
-                    {
-                        _stuck_shorts[ key ] = order;
-                    }
-                    else
-                    {
-                        if( *order.limit_price >= *_feed_price)
-                            _stuck_shorts[ key ] = order;
-                        else
-                            _unstuck_shorts[ std::make_pair( *order.limit_price, key ) ] = order;
-                    }
-                }
+                const auto limit_index = _db_impl._short_limit_index.find( std::make_pair( _quote_id, _base_id ) );
+                _unstuck_shorts = limit_index != _db_impl._short_limit_index.end() ? &limit_index->second : &_no_limited_shorts;
+                _unstuck_shorts_itr = skip_stuck_shorts( *_unstuck_shorts, _unstuck_shorts->rbegin(), *_feed_price );
             }
         }
 
-        _stuck_shorts_iter = _stuck_shorts.rbegin();
-        _unstuck_shorts_iter = _unstuck_shorts.rbegin();
-
         const expiration_index exp_index{ quote_id, time_point(), market_index_key( current_pair ) };
         _collateral_expiration_itr = _db_impl._collateral_expiration_index.lower_bound( exp_index );
 
         _current_bid.reset();
         for( _current_pass = 0; _current_pass < MARKET_ENGINE_PASS_COUNT; _current_pass++ )
         {
+            const fc::time_point pass_start = fc::time_point::now();
             _current_ask.reset();
             while( true )
             {
@@ -389,6 +371,7 @@ bool market_engine::execute( const asset_id_type quote_id, const asset_id_type b
                 if( lowest_price == price() || lowest_price > mtrx.ask_index.order_price)
                   lowest_price = mtrx.ask_index.order_price;
             }
+            _pass_durations.push_back( fc::time_point::now() - pass_start );
         }
 
         // update any fees collected
@@ -408,7 +391,7 @@ bool market_engine::execute( const asset_id_type quote_id, const asset_id_type b
                                    opening_price, closing_price, timestamp );
         }
 
-        _pending_state->apply_changes();
+        _pending_state->commit_changes();
         return true;
   }
   catch( const fc::exception& e )
@@ -728,29 +711,41 @@ bool market_engine::get_next_bid()
 
 bool market_engine::get_next_short( const omarket_order& bid_being_considered )
 { try {
+    // shorts only take part once there is a feed price
+    if( !_feed_price.valid() )
+        return false;
+
     // first consider shorts at the feed price
-    if( _stuck_shorts_iter != _stuck_shorts.rend() )
+    for( ; _stuck_shorts_itr.valid(); --_stuck_shorts_itr )
     {
-        const market_index_key& key = _stuck_shorts_iter->first;
-        const order_record& order = _stuck_shorts_iter->second;
+        const market_index_key key = _stuck_shorts_itr.key();
+        if( key.order_price.quote_asset_id != _quote_id || key.order_price.base_asset_id != _base_id )
+        {
+            _stuck_shorts_itr.reset();
+            break;
+        }
+
+        const order_record order = _stuck_shorts_itr.value();
+        if( order.limit_price.valid() && !(*order.limit_price >= *_feed_price) )
+            continue;
+
         _current_bid = market_order( short_order, key, order, order.balance, key.order_price );
-        ++_stuck_shorts_iter;
+        --_stuck_shorts_itr;
         return true;
     }
+
     // then check shorts with a limit below the feed
-    else if( _unstuck_shorts_iter != _unstuck_shorts.rend() )
+    if( _unstuck_shorts != nullptr && _unstuck_shorts_itr != _unstuck_shorts->rend() )
     {
-        FC_ASSERT( _feed_price.valid() );
-
-        const price& limit_price = _unstuck_shorts_iter->first.first;
-        const market_index_key& key = _unstuck_shorts_iter->first.second;
-        const order_record& order = _unstuck_shorts_iter->second;
+        const price& limit_price = _unstuck_shorts_itr->limit_price;
+        const market_index_key& key = _unstuck_shorts_itr->key;
 
         // if the limit price is better than a current bid
         if( !bid_being_considered.valid() || limit_price > bid_being_considered->get_price( *_feed_price ) )
         {
+            const order_record order = _db_impl._short_db.fetch( key );
             _current_bid = market_order( short_order, key, order, order.balance, key.order_price );
-            ++_unstuck_shorts_iter;
+            _unstuck_shorts_itr = skip_stuck_shorts( *_unstuck_shorts, ++_unstuck_shorts_itr, *_feed_price );
             return true;
         }
     }
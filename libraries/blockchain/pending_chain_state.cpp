@@ -31,6 +31,7 @@ namespace bts { namespace blockchain {
 
    oprice pending_chain_state::get_active_feed_price( const asset_id_type quote_id )const
    {
+      if( _read_set ) _read_set->feed_quote_ids.insert( quote_id );
       const chain_interface_ptr prev_state = _prev_state.lock();
       FC_ASSERT( prev_state );
       return prev_state->get_active_feed_price( quote_id );
@@ -44,6 +45,7 @@ namespace bts { namespace blockchain {
       apply_records( prev_state, _property_id_to_record, _property_id_remove );
       apply_records( prev_state, _account_id_to_record, _account_id_remove );
       apply_records( prev_state, _asset_id_to_record, _asset_id_remove );
+      apply_collected_fees( prev_state );
       apply_records( prev_state, _slate_id_to_record, _slate_id_remove );
       apply_records( prev_state, _balance_id_to_record, _balance_id_remove );
       apply_records( prev_state, _transaction_id_to_record, _transaction_id_remove );
@@ -62,6 +64,132 @@ namespace bts { namespace blockchain {
       prev_state->set_dirty_markets( _dirty_markets );
    }
 
+   void pending_chain_state::apply_collected_fees( const chain_interface_ptr& prev_state )const
+   {
+      const pending_chain_state_ptr prev_pending = std::dynamic_pointer_cast<pending_chain_state>( prev_state );
+      for( const auto& item : _collected_fee_deltas )
+      {
+          if( prev_pending )
+          {
+              prev_pending->add_collected_fees( item.first, item.second );
+              continue;
+          }
+
+          oasset_record record = prev_state->get_asset_record( item.first );
+          FC_ASSERT( record.valid() );
+          record->collected_fees += item.second;
+          prev_state->store_asset_record( *record );
+      }
+   }
+
+   void pending_chain_state::add_collected_fees( const asset_id_type id, const share_type amount )
+   { try {
+      if( !_read_set )
+      {
+          oasset_record record = get_asset_record( id );
+          if( !record.valid() )
+              FC_CAPTURE_AND_THROW( unknown_asset_id, (id) );
+
+          record->collected_fees += amount;
+          store_asset_record( *record );
+          return;
+      }
+
+      if( !get_asset_definition( id ).valid() )
+          FC_CAPTURE_AND_THROW( unknown_asset_id, (id) );
+
+      _collected_fee_deltas[ id ] += amount;
+   } FC_CAPTURE_AND_RETHROW( (id)(amount) ) }
+
+   namespace detail
+   {
+      /** Moves every entry of src into dest, reusing src's storage when dest has nothing to merge with */
+      template<typename T>
+      void splice_entries( T& dest, T& src )
+      {
+          if( dest.empty() )
+          {
+              std::swap( dest, src );
+              return;
+          }
+          for( auto& item : src ) dest[ item.first ] = std::move( item.second );
+          src.clear();
+      }
+
+      template<typename T>
+      void splice_keys( T& dest, T& src )
+      {
+          if( dest.empty() )
+          {
+              std::swap( dest, src );
+              return;
+          }
+          dest.insert( src.begin(), src.end() );
+          src.clear();
+      }
+
+      /** Equivalent to apply_records() for record types whose store and remove only touch the id map */
+      template<typename T, typename U>
+      void splice_records( T& dest_map, U& dest_remove, T& src_map, U& src_remove )
+      {
+          for( const auto& key : src_remove ) dest_map.erase( key );
+          for( const auto& item : src_map ) dest_remove.erase( item.first );
+          splice_keys( dest_remove, src_remove );
+          splice_entries( dest_map, src_map );
+      }
+   }
+
+   void pending_chain_state::commit_changes()
+   {
+      const chain_interface_ptr prev_state = _prev_state.lock();
+      const pending_chain_state_ptr prev_pending = std::dynamic_pointer_cast<pending_chain_state>( prev_state );
+      if( !prev_pending )
+      {
+          apply_changes();
+          return;
+      }
+
+      // These maintain secondary indexes in the previous state, so they still go through the store path
+      apply_records( prev_state, _account_id_to_record, _account_id_remove );
+      apply_records( prev_state, _asset_id_to_record, _asset_id_remove );
+      apply_collected_fees( prev_state );
+      apply_records( prev_state, _slot_index_to_record, _slot_index_remove );
+      for( const auto& id : _transaction_id_remove ) prev_state->remove<transaction_record>( id );
+
+      detail::splice_records( prev_pending->_property_id_to_record, prev_pending->_property_id_remove,
+                              _property_id_to_record, _property_id_remove );
+      detail::splice_records( prev_pending->_slate_id_to_record, prev_pending->_slate_id_remove,
+                              _slate_id_to_record, _slate_id_remove );
+      detail::splice_records( prev_pending->_balance_id_to_record, prev_pending->_balance_id_remove,
+                              _balance_id_to_record, _balance_id_remove );
+      detail::splice_records( prev_pending->_burn_index_to_record, prev_pending->_burn_index_remove,
+                              _burn_index_to_record, _burn_index_remove );
+      detail::splice_records( prev_pending->_status_index_to_record, prev_pending->_status_index_remove,
+                              _status_index_to_record, _status_index_remove );
+      detail::splice_records( prev_pending->_feed_index_to_record, prev_pending->_feed_index_remove,
+                              _feed_index_to_record, _feed_index_remove );
+
+      for( const auto& item : _transaction_id_to_record ) prev_pending->_transaction_id_remove.erase( item.first );
+      detail::splice_entries( prev_pending->_transaction_id_to_record, _transaction_id_to_record );
+      detail::splice_keys( prev_pending->_transaction_digests, _transaction_digests );
+      _transaction_id_remove.clear();
+
+      for( const auto& item : bids )            prev_pending->_dirty_markets.insert( item.first.order_price.asset_pair() );
+      for( const auto& item : asks )            prev_pending->_dirty_markets.insert( item.first.order_price.asset_pair() );
+      for( const auto& item : shorts )          prev_pending->_dirty_markets.insert( item.first.order_price.asset_pair() );
+      for( const auto& item : collateral )      prev_pending->_dirty_markets.insert( item.first.order_price.asset_pair() );
+      detail::splice_entries( prev_pending->bids, bids );
+      detail::splice_entries( prev_pending->asks, asks );
+      detail::splice_entries( prev_pending->shorts, shorts );
+      detail::splice_entries( prev_pending->collateral, collateral );
+      detail::splice_entries( prev_pending->market_history, market_history );
+
+      prev_pending->set_market_transactions( std::move( market_transactions ) );
+      prev_pending->set_dirty_markets( _dirty_markets );
+
+      *this = pending_chain_state( prev_state );
+   }
+
    otransaction_record pending_chain_state::get_transaction( const transaction_id_type& trx_id, bool exact )const
    {
        return lookup<transaction_record>( trx_id );
@@ -89,6 +217,12 @@ namespace bts { namespace blockchain {
       populate_undo_state( undo_state, prev_state, _property_id_to_record, _property_id_remove );
       populate_undo_state( undo_state, prev_state, _account_id_to_record, _account_id_remove );
       populate_undo_state( undo_state, prev_state, _asset_id_to_record, _asset_id_remove );
+      for( const auto& item : _collected_fee_deltas )
+      {
+         if( _asset_id_to_record.count( item.first ) > 0 ) continue;
+         const oasset_record prev_record = prev_state->lookup<asset_record>( item.first );
+         if( prev_record.valid() ) undo_state->store( item.first, *prev_record );
+      }
       populate_undo_state( undo_state, prev_state, _slate_id_to_record, _slate_id_remove );
       populate_undo_state( undo_state, prev_state, _balance_id_to_record, _balance_id_remove );
       populate_undo_state( undo_state, prev_state, _transaction_id_to_record, _transaction_id_remove );
@@ -140,6 +274,7 @@ namespace bts { namespace blockchain {
 
    oorder_record pending_chain_state::get_bid_record( const market_index_key& key )const
    {
+      if( _read_set ) _read_set->order_keys.insert( key );
       chain_interface_ptr prev_state = _prev_state.lock();
       auto rec_itr = bids.find( key );
       if( rec_itr != bids.end() ) return rec_itr->second;
@@ -149,6 +284,7 @@ namespace bts { namespace blockchain {
 
    omarket_order pending_chain_state::get_lowest_ask_record( const asset_id_type quote_id, const asset_id_type base_id )
    {
+      if( _read_set ) _read_set->other = true;
       chain_interface_ptr prev_state = _prev_state.lock();
       omarket_order result;
       if( prev_state )
@@ -165,6 +301,7 @@ namespace bts { namespace blockchain {
 
    oorder_record pending_chain_state::get_ask_record( const market_index_key& key )const
    {
+      if( _read_set ) _read_set->order_keys.insert( key );
       chain_interface_ptr prev_state = _prev_state.lock();
       auto rec_itr = asks.find( key );
       if( rec_itr != asks.end() ) return rec_itr->second;
@@ -174,6 +311,7 @@ namespace bts { namespace blockchain {
 
    oorder_record pending_chain_state::get_short_record( const market_index_key& key )const
    {
+      if( _read_set ) _read_set->order_keys.insert( key );
       chain_interface_ptr prev_state = _prev_state.lock();
       auto rec_itr = shorts.find( key );
       if( rec_itr != shorts.end() ) return rec_itr->second;
@@ -183,6 +321,7 @@ namespace bts { namespace blockchain {
 
    ocollateral_record pending_chain_state::get_collateral_record( const market_index_key& key )const
    {
+      if( _read_set ) _read_set->order_keys.insert( key );
       chain_interface_ptr prev_state = _prev_state.lock();
       auto rec_itr = collateral.find( key );
       if( rec_itr != collateral.end() ) return rec_itr->second;
@@ -277,6 +416,8 @@ namespace bts { namespace blockchain {
            const asset_record& record = item.second;
            deltas[ record.id ] += record.collected_fees;
        }
+       for( const auto& item : _collected_fee_deltas )
+           deltas[ item.first ] += item.second;
        for( const asset_id_type id : _asset_id_remove )
        {
            const oasset_record prev_record = prev_state->get_asset_record( id );
@@ -370,6 +511,7 @@ namespace bts { namespace blockchain {
 
    oproperty_record pending_chain_state::property_lookup_by_id( const property_id_type id )const
    {
+       if( _read_set ) _read_set->property_ids.insert( id );
        const auto iter = _property_id_to_record.find( id );
        if( iter != _property_id_to_record.end() ) return iter->second;
        if( _property_id_remove.count( id ) > 0 ) return oproperty_record();
@@ -392,6 +534,7 @@ namespace bts { namespace blockchain {
 
    oaccount_record pending_chain_state::account_lookup_by_id( const account_id_type id )const
    {
+       if( _read_set ) _read_set->account_ids.insert( id );
        const auto iter = _account_id_to_record.find( id );
        if( iter != _account_id_to_record.end() ) return iter->second;
        if( _account_id_remove.count( id ) > 0 ) return oaccount_record();
@@ -402,6 +545,7 @@ namespace bts { namespace blockchain {
 
    oaccount_record pending_chain_state::account_lookup_by_name( const string& name )const
    {
+       if( _read_set ) _read_set->account_names.insert( name );
        const auto iter = _account_name_to_id.find( name );
        if( iter != _account_name_to_id.end() ) return _account_id_to_record.at( iter->second );
        const chain_interface_ptr prev_state = _prev_state.lock();
@@ -413,6 +557,7 @@ namespace bts { namespace blockchain {
 
    oaccount_record pending_chain_state::account_lookup_by_address( const address& addr )const
    {
+       if( _read_set ) _read_set->account_addresses.insert( addr );
        const auto iter = _account_address_to_id.find( addr );
        if( iter != _account_address_to_id.end() ) return _account_id_to_record.at( iter->second );
        const chain_interface_ptr prev_state = _prev_state.lock();
@@ -462,29 +607,102 @@ namespace bts { namespace blockchain {
    {
    }
 
-   oasset_record pending_chain_state::asset_lookup_by_id( const asset_id_type id )const
+   oasset_record pending_chain_state::find_asset( const asset_id_type id )const
    {
+       oasset_record record;
        const auto iter = _asset_id_to_record.find( id );
-       if( iter != _asset_id_to_record.end() ) return iter->second;
-       if( _asset_id_remove.count( id ) > 0 ) return oasset_record();
-       const chain_interface_ptr prev_state = _prev_state.lock();
-       if( !prev_state ) return oasset_record();
-       return prev_state->lookup<asset_record>( id );
+       if( iter != _asset_id_to_record.end() )
+       {
+           record = iter->second;
+       }
+       else if( _asset_id_remove.count( id ) == 0 )
+       {
+           const chain_interface_ptr prev_state = _prev_state.lock();
+           if( prev_state ) record = prev_state->lookup<asset_record>( id );
+       }
+       fold_collected_fees( record );
+       return record;
+   }
+
+   void pending_chain_state::fold_collected_fees( oasset_record& record )const
+   {
+       if( !record.valid() ) return;
+       const auto iter = _collected_fee_deltas.find( record->id );
+       if( iter != _collected_fee_deltas.end() ) record->collected_fees += iter->second;
+   }
+
+   oasset_record pending_chain_state::get_asset_definition( const asset_id_type id )const
+   {
+       if( _read_set ) _read_set->asset_ids.insert( id );
+       return find_asset( id );
+   }
+
+   oasset_record pending_chain_state::asset_lookup_by_id( const asset_id_type id )const
+   {
+       if( _read_set )
+       {
+           _read_set->asset_ids.insert( id );
+           _read_set->asset_supply_ids.insert( id );
+       }
+       return find_asset( id );
    }
 
    oasset_record pending_chain_state::asset_lookup_by_symbol( const string& symbol )const
    {
+       if( _read_set ) _read_set->asset_symbols.insert( symbol );
+       oasset_record record;
        const auto iter = _asset_symbol_to_id.find( symbol );
-       if( iter != _asset_symbol_to_id.end() ) return _asset_id_to_record.at( iter->second );
-       const chain_interface_ptr prev_state = _prev_state.lock();
-       if( !prev_state ) return oasset_record();
-       const oasset_record record = prev_state->lookup<asset_record>( symbol );
-       if( record.valid() && _asset_id_remove.count( record->id ) == 0 ) return *record;
-       return oasset_record();
+       if( iter != _asset_symbol_to_id.end() )
+       {
+           record = _asset_id_to_record.at( iter->second );
+       }
+       else
+       {
+           const chain_interface_ptr prev_state = _prev_state.lock();
+           if( prev_state ) record = prev_state->lookup<asset_record>( symbol );
+           if( record.valid() && _asset_id_remove.count( record->id ) > 0 ) record.reset();
+       }
+
+       if( record.valid() && _read_set )
+       {
+           _read_set->asset_ids.insert( record->id );
+           _read_set->asset_supply_ids.insert( record->id );
+       }
+       fold_collected_fees( record );
+       return record;
    }
 
    void pending_chain_state::asset_insert_into_id_map( const asset_id_type id, const asset_record& record )
    {
+       // Block and transaction writes that only move the supply or collected fees must not conflict with readers
+       // of the definition, so remember whether it changed since the previous state
+       const auto iter = _asset_id_to_record.find( id );
+       oasset_record prev_record;
+       if( iter != _asset_id_to_record.end() )
+       {
+           if( _asset_supply_only_ids.count( id ) > 0 ) prev_record = iter->second;
+       }
+       else if( _asset_id_remove.count( id ) == 0 )
+       {
+           const chain_interface_ptr prev_state = _prev_state.lock();
+           if( prev_state ) prev_record = prev_state->lookup<asset_record>( id );
+       }
+
+       bool supply_only = false;
+       if( prev_record.valid() )
+       {
+           asset_record definition = record;
+           definition.current_supply = prev_record->current_supply;
+           definition.collected_fees = prev_record->collected_fees;
+           supply_only = fc::raw::pack( definition ) == fc::raw::pack( *prev_record );
+       }
+
+       if( supply_only ) _asset_supply_only_ids.insert( id );
+       else _asset_supply_only_ids.erase( id );
+
+       // The record was read through this state, so it already includes any pending delta
+       _collected_fee_deltas.erase( id );
+
        _asset_id_remove.erase( id );
        _asset_id_to_record[ id ] = record;
    }
@@ -496,6 +714,8 @@ namespace bts { namespace blockchain {
 
    void pending_chain_state::asset_erase_from_id_map( const asset_id_type id )
    {
+       _asset_supply_only_ids.erase( id );
+       _collected_fee_deltas.erase( id );
        _asset_id_to_record.erase( id );
        _asset_id_remove.insert( id );
    }
@@ -507,6 +727,7 @@ namespace bts { namespace blockchain {
 
    oslate_record pending_chain_state::slate_lookup_by_id( const slate_id_type id )const
    {
+       if( _read_set ) _read_set->slate_ids.insert( id );
        const auto iter = _slate_id_to_record.find( id );
        if( iter != _slate_id_to_record.end() ) return iter->second;
        if( _slate_id_remove.count( id ) > 0 ) return oslate_record();
@@ -529,6 +750,7 @@ namespace bts { namespace blockchain {
 
    obalance_record pending_chain_state::balance_lookup_by_id( const balance_id_type& id )const
    {
+       if( _read_set ) _read_set->balance_ids.insert( id );
        const auto iter = _balance_id_to_record.find( id );
        if( iter != _balance_id_to_record.end() ) return iter->second;
        if( _balance_id_remove.count( id ) > 0 ) return obalance_record();
@@ -583,6 +805,7 @@ namespace bts { namespace blockchain {
 
    oburn_record pending_chain_state::burn_lookup_by_index( const burn_index& index )const
    {
+       if( _read_set ) _read_set->other = true;
        const auto iter = _burn_index_to_record.find( index );
        if( iter != _burn_index_to_record.end() ) return iter->second;
        if( _burn_index_remove.count( index ) > 0 ) return oburn_record();
@@ -605,6 +828,7 @@ namespace bts { namespace blockchain {
 
    ostatus_record pending_chain_state::status_lookup_by_index( const status_index index )const
    {
+       if( _read_set ) _read_set->other = true;
        const auto iter = _status_index_to_record.find( index );
        if( iter != _status_index_to_record.end() ) return iter->second;
        if( _status_index_remove.count( index ) > 0 ) return ostatus_record();
@@ -627,6 +851,7 @@ namespace bts { namespace blockchain {
 
    ofeed_record pending_chain_state::feed_lookup_by_index( const feed_index index )const
    {
+       if( _read_set ) _read_set->feed_quote_ids.insert( index.quote_id );
        const auto iter = _feed_index_to_record.find( index );
        if( iter != _feed_index_to_record.end() ) return iter->second;
        if( _feed_index_remove.count( index ) > 0 ) return ofeed_record();
@@ -649,6 +874,7 @@ namespace bts { namespace blockchain {
 
    oslot_record pending_chain_state::slot_lookup_by_index( const slot_index index )const
    {
+       if( _read_set ) _read_set->other = true;
        const auto iter = _slot_index_to_record.find( index );
        if( iter != _slot_index_to_record.end() ) return iter->second;
        if( _slot_index_remove.count( index ) > 0 ) return oslot_record();
@@ -659,6 +885,7 @@ namespace bts { namespace blockchain {
 
    oslot_record pending_chain_state::slot_lookup_by_timestamp( const time_point_sec timestamp )const
    {
+       if( _read_set ) _read_set->other = true;
        const auto iter = _slot_timestamp_to_delegate.find( timestamp );
        if( iter != _slot_timestamp_to_delegate.end() ) return _slot_index_to_record.at( slot_index( iter->second, timestamp ) );
        const chain_interface_ptr prev_state = _prev_state.lock();
@@ -690,4 +917,118 @@ namespace bts { namespace blockchain {
        _slot_timestamp_to_delegate.erase( timestamp );
    }
 
+   namespace detail
+   {
+      template<typename T>
+      bool keys_intersect( const T& a, const T& b )
+      {
+          const T& smaller = a.size() <= b.size() ? a : b;
+          const T& larger = a.size() <= b.size() ? b : a;
+          for( const auto& key : smaller )
+          {
+              if( larger.count( key ) > 0 )
+                  return true;
+          }
+          return false;
+      }
+
+      template<typename T, typename U>
+      void insert_keys( T& keys, const U& store_map )
+      {
+          for( const auto& item : store_map )
+              keys.insert( item.first );
+      }
+   }
+
+   void pending_read_set::add_writes( const pending_chain_state& state )
+   {
+       detail::insert_keys( property_ids, state._property_id_to_record );
+       property_ids.insert( state._property_id_remove.begin(), state._property_id_remove.end() );
+
+       detail::insert_keys( account_ids, state._account_id_to_record );
+       account_ids.insert( state._account_id_remove.begin(), state._account_id_remove.end() );
+       detail::insert_keys( account_names, state._account_name_to_id );
+       detail::insert_keys( account_addresses, state._account_address_to_id );
+
+       detail::insert_keys( asset_supply_ids, state._asset_id_to_record );
+       for( const auto& item : state._asset_id_to_record )
+       {
+           if( state._asset_supply_only_ids.count( item.first ) == 0 )
+               asset_ids.insert( item.first );
+       }
+       for( const auto& item : state._asset_symbol_to_id )
+       {
+           if( state._asset_supply_only_ids.count( item.second ) == 0 )
+               asset_symbols.insert( item.first );
+       }
+       asset_ids.insert( state._asset_id_remove.begin(), state._asset_id_remove.end() );
+       asset_supply_ids.insert( state._asset_id_remove.begin(), state._asset_id_remove.end() );
+       detail::insert_keys( asset_fee_ids, state._collected_fee_deltas );
+
+       detail::insert_keys( slate_ids, state._slate_id_to_record );
+       slate_ids.insert( state._slate_id_remove.begin(), state._slate_id_remove.end() );
+
+       detail::insert_keys( balance_ids, state._balance_id_to_record );
+       balance_ids.insert( state._balance_id_remove.begin(), state._balance_id_remove.end() );
+
+       for( const auto& item : state._feed_index_to_record )
+           feed_quote_ids.insert( item.first.quote_id );
+       for( const auto& index : state._feed_index_remove )
+           feed_quote_ids.insert( index.quote_id );
+
+       detail::insert_keys( order_keys, state.bids );
+       detail::insert_keys( order_keys, state.asks );
+       detail::insert_keys( order_keys, state.shorts );
+       detail::insert_keys( order_keys, state.collateral );
+
+       // Removed accounts and assets are also reachable by name, and nothing else is tracked by key
+       if( !state._account_id_remove.empty() || !state._asset_id_remove.empty()
+           || !state._burn_index_to_record.empty() || !state._burn_index_remove.empty()
+           || !state._status_index_to_record.empty() || !state._status_index_remove.empty()
+           || !state._slot_index_to_record.empty() || !state._slot_index_remove.empty()
+           || !state._dirty_markets.empty() )
+       {
+           other = true;
+       }
+   }
+
+   void pending_read_set::add( const pending_read_set& keys )
+   {
+       property_ids.insert( keys.property_ids.begin(), keys.property_ids.end() );
+       account_ids.insert( keys.account_ids.begin(), keys.account_ids.end() );
+       account_names.insert( keys.account_names.begin(), keys.account_names.end() );
+       account_addresses.insert( keys.account_addresses.begin(), keys.account_addresses.end() );
+       asset_ids.insert( keys.asset_ids.begin(), keys.asset_ids.end() );
+       asset_supply_ids.insert( keys.asset_supply_ids.begin(), keys.asset_supply_ids.end() );
+       asset_fee_ids.insert( keys.asset_fee_ids.begin(), keys.asset_fee_ids.end() );
+       asset_symbols.insert( keys.asset_symbols.begin(), keys.asset_symbols.end() );
+       slate_ids.insert( keys.slate_ids.begin(), keys.slate_ids.end() );
+       balance_ids.insert( keys.balance_ids.begin(), keys.balance_ids.end() );
+       feed_quote_ids.insert( keys.feed_quote_ids.begin(), keys.feed_quote_ids.end() );
+       order_keys.insert( keys.order_keys.begin(), keys.order_keys.end() );
+       other |= keys.other;
+   }
+
+   bool pending_read_set::intersects( const pending_read_set& keys )const
+   {
+       if( other && keys.other ) return true;
+       return detail::keys_intersect( property_ids, keys.property_ids )
+           || detail::keys_intersect( account_ids, keys.account_ids )
+           || detail::keys_intersect( account_names, keys.account_names )
+           || detail::keys_intersect( account_addresses, keys.account_addresses )
+           || detail::keys_intersect( asset_ids, keys.asset_ids )
+           || detail::keys_intersect( asset_supply_ids, keys.asset_supply_ids )
+           || detail::keys_intersect( asset_supply_ids, keys.asset_fee_ids )
+           || detail::keys_intersect( asset_symbols, keys.asset_symbols )
+           || detail::keys_intersect( slate_ids, keys.slate_ids )
+           || detail::keys_intersect( balance_ids, keys.balance_ids )
+           || detail::keys_intersect( feed_quote_ids, keys.feed_quote_ids )
+           || detail::keys_intersect( order_keys, keys.order_keys );
+   }
+
+   void pending_read_set::clear()
+   {
+       *this = pending_read_set();
+   }
+
 } } // bts::blockchain
@@ -0,0 +1,205 @@
+#include <bts/blockchain/exceptions.hpp>
+#include <bts/blockchain/pending_transaction_pool.hpp>
+
+#include <fc/io/raw.hpp>
+
+namespace bts { namespace blockchain {
+
+   pending_transaction_pool::fee_rate_key pending_transaction_pool::make_fee_rate_key( const transaction_id_type& id,
+                                                                                       const entry& e )
+   {
+      fee_rate_key key;
+      key.fees = e.fees;
+      key.size = e.size;
+      key.id = id;
+      return key;
+   }
+
+   void pending_transaction_pool::set_limits( const uint64_t max_bytes, const uint32_t max_transactions_per_address )
+   { try {
+      FC_ASSERT( max_bytes > 0 );
+      FC_ASSERT( max_transactions_per_address > 0 );
+      _max_bytes = max_bytes;
+      _max_per_address = max_transactions_per_address;
+   } FC_CAPTURE_AND_RETHROW( (max_bytes)(max_transactions_per_address) ) }
+
+   void pending_transaction_pool::clear()
+   {
+      _entries.clear();
+      _by_fee_rate.clear();
+      _by_expiration.clear();
+      _signer_counts.clear();
+      _total_bytes = 0;
+   }
+
+   void pending_transaction_pool::add_signers( const set<address>& signers )
+   {
+      for( const address& signer : signers )
+          ++_signer_counts[ signer ];
+   }
+
+   void pending_transaction_pool::remove_signers( const set<address>& signers )
+   {
+      for( const address& signer : signers )
+      {
+          const auto iter = _signer_counts.find( signer );
+          if( iter == _signer_counts.end() ) continue;
+          if( --iter->second == 0 )
+              _signer_counts.erase( iter );
+      }
+   }
+
+   void pending_transaction_pool::erase( map<transaction_id_type, entry>::iterator iter )
+   {
+      const transaction_id_type& id = iter->first;
+      const entry& e = iter->second;
+
+      if( !e.local )
+          _by_fee_rate.erase( make_fee_rate_key( id, e ) );
+      _by_expiration.erase( std::make_pair( e.trx.expiration, id ) );
+      remove_signers( e.signers );
+      _total_bytes -= e.size;
+
+      _entries.erase( iter );
+   }
+
+   vector<transaction_id_type> pending_transaction_pool::select_evictions( const uint32_t size, const share_type fees )const
+   {
+      vector<transaction_id_type> evictions;
+      if( _total_bytes + size <= _max_bytes )
+          return evictions;
+
+      fee_rate_key incoming;
+      incoming.fees = fees;
+      incoming.size = size;
+
+      uint64_t freed = 0;
+      for( const fee_rate_key& key : _by_fee_rate )
+      {
+          if( _total_bytes + size - freed <= _max_bytes )
+              break;
+
+          if( !( key < incoming ) )
+              FC_CAPTURE_AND_THROW( pending_pool_full, (size)(fees)(key.fees)(key.size) );
+
+          evictions.push_back( key.id );
+          freed += key.size;
+      }
+
+      if( _total_bytes + size - freed > _max_bytes )
+          FC_CAPTURE_AND_THROW( pending_pool_full, (size)(fees)(_total_bytes)(_max_bytes) );
+
+      return evictions;
+   }
+
+   void pending_transaction_pool::check_admission( const uint32_t size, const share_type fees,
+                                                   const set<address>& signers )const
+   {
+      for( const address& signer : signers )
+      {
+          const auto iter = _signer_counts.find( signer );
+          if( iter != _signer_counts.end() && iter->second >= _max_per_address )
+              FC_CAPTURE_AND_THROW( too_many_pending_transactions, (signer)(_max_per_address) );
+      }
+
+      select_evictions( size, fees );
+   }
+
+   vector<transaction_id_type> pending_transaction_pool::insert( const transaction_id_type& id, const signed_transaction& trx,
+                                                                 const share_type fees, const set<address>& signers,
+                                                                 const bool local )
+   { try {
+      FC_ASSERT( !contains( id ) );
+
+      entry e;
+      e.trx = trx;
+      e.size = fc::raw::pack_size( trx );
+      e.fees = fees;
+      e.signers = signers;
+      e.local = local;
+
+      vector<transaction_id_type> evictions;
+      if( !local )
+          evictions = select_evictions( e.size, fees );
+
+      for( const transaction_id_type& evicted_id : evictions )
+          erase( _entries.find( evicted_id ) );
+      _evicted_count += evictions.size();
+
+      if( !local )
+          _by_fee_rate.insert( make_fee_rate_key( id, e ) );
+      _by_expiration.emplace( trx.expiration, id );
+      add_signers( signers );
+      _total_bytes += e.size;
+
+      _entries.emplace( id, std::move( e ) );
+      return evictions;
+   } FC_CAPTURE_AND_RETHROW( (id)(fees)(local) ) }
+
+   void pending_transaction_pool::update( const transaction_id_type& id, const share_type fees, const set<address>& signers )
+   {
+      const auto iter = _entries.find( id );
+      if( iter == _entries.end() ) return;
+
+      entry& e = iter->second;
+      if( !e.local )
+      {
+          _by_fee_rate.erase( make_fee_rate_key( id, e ) );
+          e.fees = fees;
+          _by_fee_rate.insert( make_fee_rate_key( id, e ) );
+      }
+      else
+      {
+          e.fees = fees;
+      }
+
+      remove_signers( e.signers );
+      e.signers = signers;
+      add_signers( e.signers );
+   }
+
+   bool pending_transaction_pool::remove( const transaction_id_type& id )
+   {
+      const auto iter = _entries.find( id );
+      if( iter == _entries.end() ) return false;
+      erase( iter );
+      return true;
+   }
+
+   vector<transaction_id_type> pending_transaction_pool::remove_expired( const time_point_sec now )
+   {
+      vector<transaction_id_type> expired;
+      while( !_by_expiration.empty() && _by_expiration.begin()->first <= now )
+      {
+          const transaction_id_type id = _by_expiration.begin()->second;
+          erase( _entries.find( id ) );
+          expired.push_back( id );
+      }
+      _expired_count += expired.size();
+      return expired;
+   }
+
+   pending_pool_stats pending_transaction_pool::get_stats()const
+   {
+      pending_pool_stats stats;
+      stats.transaction_count = _entries.size();
+      stats.total_bytes = _total_bytes;
+      stats.max_bytes = _max_bytes;
+      stats.max_transactions_per_address = _max_per_address;
+      stats.signer_count = _signer_counts.size();
+      if( !_by_fee_rate.empty() )
+      {
+          const fee_rate_key& cheapest = *_by_fee_rate.begin();
+          stats.min_fee_per_kilobyte = cheapest.fees * 1024 / std::max<uint32_t>( cheapest.size, 1 );
+      }
+      if( !_by_expiration.empty() )
+          stats.next_expiration = _by_expiration.begin()->first;
+      stats.evicted_count = _evicted_count;
+      stats.expired_count = _expired_count;
+      stats.rejected_count = _rejected_count;
+      stats.reused_count = _reused_count;
+      stats.reevaluated_count = _reevaluated_count;
+      return stats;
+   }
+
+} } // bts::blockchain
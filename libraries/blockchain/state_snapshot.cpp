@@ -0,0 +1,163 @@
+#include <bts/blockchain/state_snapshot.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <cstring>
+
+namespace bts { namespace blockchain {
+
+   namespace detail
+   {
+      static const char     state_snapshot_magic[] = { 'B', 'T', 'S', 'S', 'T', 'A', 'T', 'E' };
+
+      static const uint8_t  end_tag = 0;
+      static const uint8_t  item_tag = 1;
+   }
+
+   state_snapshot_writer::state_snapshot_writer( const fc::path& filename, const state_snapshot_header& header )
+   :_filename( filename ),_temp_filename( filename.string() + ".tmp" )
+   { try {
+      _out.open( _temp_filename, std::ios::out | std::ios::binary | std::ios::trunc );
+      FC_ASSERT( _out.is_open(), "unable to create state snapshot" );
+
+      write( detail::state_snapshot_magic, sizeof( detail::state_snapshot_magic ) );
+
+      const vector<char> packed_header = fc::raw::pack( header );
+      write_uint32( uint32_t( packed_header.size() ) );
+      write( packed_header.data(), packed_header.size() );
+   } FC_CAPTURE_AND_RETHROW( (filename)(header) ) }
+
+   state_snapshot_writer::~state_snapshot_writer()
+   {
+      if( _finished ) return;
+
+      // Abandoned partway through; do not leave the partial file behind
+      _out.close();
+      boost::system::error_code ec;
+      boost::filesystem::remove( _temp_filename, ec );
+   }
+
+   void state_snapshot_writer::begin_section( const string& name )
+   {
+      write_uint8( detail::item_tag );
+      write_uint32( uint32_t( name.size() ) );
+      write( name.data(), name.size() );
+   }
+
+   void state_snapshot_writer::add_entry( const char* key, uint32_t key_size, const char* value, uint32_t value_size )
+   {
+      write_uint8( detail::item_tag );
+      write_uint32( key_size );
+      write( key, key_size );
+      write_uint32( value_size );
+      write( value, value_size );
+   }
+
+   void state_snapshot_writer::end_section()
+   {
+      write_uint8( detail::end_tag );
+   }
+
+   void state_snapshot_writer::finish()
+   { try {
+      FC_ASSERT( !_finished );
+      write_uint8( detail::end_tag );
+
+      const fc::sha256 checksum = _checksum.result();
+      _out.write( checksum.data(), checksum.data_size() );
+      _out.close();
+      FC_ASSERT( !_out.fail(), "error writing state snapshot" );
+
+      boost::filesystem::rename( _temp_filename, _filename );
+      _finished = true;
+   } FC_CAPTURE_AND_RETHROW( (_filename) ) }
+
+   void state_snapshot_writer::write( const char* data, size_t size )
+   {
+      _out.write( data, size );
+      _checksum.write( data, size );
+      FC_ASSERT( _out.good(), "error writing state snapshot" );
+   }
+
+   state_snapshot_reader::state_snapshot_reader( const fc::path& filename )
+   { try {
+      _in.open( filename, std::ios::in | std::ios::binary );
+      FC_ASSERT( _in.is_open(), "unable to open state snapshot" );
+
+      const uint64_t file_size = boost::filesystem::file_size( filename );
+      FC_ASSERT( file_size >= sizeof( detail::state_snapshot_magic ) + sizeof( fc::sha256 ), "state snapshot is truncated" );
+
+      // Check the whole file before trusting anything in it
+      const uint64_t data_size = file_size - sizeof( fc::sha256 );
+      fc::sha256::encoder checksum;
+      vector<char> buffer( 1024 * 1024 );
+      for( uint64_t remaining = data_size; remaining > 0; )
+      {
+          const size_t chunk = size_t( std::min<uint64_t>( remaining, buffer.size() ) );
+          read( buffer.data(), chunk );
+          checksum.write( buffer.data(), chunk );
+          remaining -= chunk;
+      }
+
+      fc::sha256 expected_checksum;
+      read( expected_checksum.data(), expected_checksum.data_size() );
+      FC_ASSERT( checksum.result() == expected_checksum, "state snapshot checksum mismatch" );
+
+      _in.clear();
+      _in.seekg( 0 );
+
+      char magic[ sizeof( detail::state_snapshot_magic ) ];
+      read( magic, sizeof( magic ) );
+      FC_ASSERT( memcmp( magic, detail::state_snapshot_magic, sizeof( magic ) ) == 0, "not a state snapshot" );
+
+      const uint32_t header_size = read_uint32();
+      vector<char> packed_header( header_size );
+      read( packed_header.data(), packed_header.size() );
+      _header = fc::raw::unpack<state_snapshot_header>( packed_header );
+   } FC_CAPTURE_AND_RETHROW( (filename) ) }
+
+   bool state_snapshot_reader::next_section( string& name )
+   { try {
+      if( read_uint8() == detail::end_tag ) return false;
+      name = read_string();
+      return true;
+   } FC_CAPTURE_AND_RETHROW() }
+
+   bool state_snapshot_reader::next_entry( string& key, string& value )
+   { try {
+      if( read_uint8() == detail::end_tag ) return false;
+      key = read_string();
+      value = read_string();
+      return true;
+   } FC_CAPTURE_AND_RETHROW() }
+
+   void state_snapshot_reader::read( char* data, size_t size )
+   {
+      _in.read( data, size );
+      FC_ASSERT( _in.good(), "unexpected end of state snapshot" );
+   }
+
+   uint8_t state_snapshot_reader::read_uint8()
+   {
+      uint8_t value = 0;
+      read( (char*)&value, sizeof( value ) );
+      return value;
+   }
+
+   uint32_t state_snapshot_reader::read_uint32()
+   {
+      uint32_t value = 0;
+      read( (char*)&value, sizeof( value ) );
+      return value;
+   }
+
+   string state_snapshot_reader::read_string()
+   {
+      string value( read_uint32(), '\0' );
+      if( !value.empty() ) read( &value[ 0 ], value.size() );
+      return value;
+   }
+
+} } // bts::blockchain
@@ -108,14 +108,7 @@ namespace bts { namespace blockchain {
            }
 
            if( fee.amount != 0 )
-           {
-               oasset_record asset_record = pending_state()->get_asset_record( fee.asset_id );
-               if( !asset_record.valid() )
-                   FC_CAPTURE_AND_THROW( unknown_asset_id, (fee) );
-
-               asset_record->collected_fees += fee.amount;
-               pending_state()->store_asset_record( *asset_record );
-           }
+               pending_state()->add_collected_fees( fee.asset_id, fee.amount );
        }
 
        if( pending_state()->get_head_block_num() >= BTS_V0_9_2_FORK_BLOCK_NUM )
@@ -153,22 +146,24 @@ namespace bts { namespace blockchain {
 
         if( !_skip_signature_check )
         {
-           const auto trx_digest = trx_arg.digest( pending_state()->get_chain_id() );
-           for( const auto& sig : trx_arg.signatures )
+           if( _preverified_signed_addresses.valid() )
+              signed_addresses.insert( _preverified_signed_addresses->begin(), _preverified_signed_addresses->end() );
+           else
            {
-              const auto key = fc::ecc::public_key( sig, trx_digest, _enforce_canonical_signatures ).serialize();
-              signed_addresses.insert( address( key ) );
-              signed_addresses.insert( address( pts_address( key, false, 56 ) ) );
-              signed_addresses.insert( address( pts_address( key, true, 56 ) ) );
-              signed_addresses.insert( address( pts_address( key, false, 0 ) ) );
-              signed_addresses.insert( address( pts_address( key, true, 0 ) ) );
+              const set<address> recovered = recover_signed_addresses( trx_arg, pending_state()->get_chain_id(),
+                                                                       _enforce_canonical_signatures );
+              signed_addresses.insert( recovered.begin(), recovered.end() );
            }
         }
 
         _current_op_index = 0;
+        _operation_times.clear();
         for( const auto& op : trx_arg.operations )
         {
+           const fc::time_point start_time = _record_operation_times ? fc::time_point::now() : fc::time_point();
            evaluate_operation( op );
+           if( _record_operation_times )
+              _operation_times.push_back( fc::time_point::now() - start_time );
            ++_current_op_index;
         }
 
@@ -185,6 +180,23 @@ namespace bts { namespace blockchain {
       }
    } FC_CAPTURE_AND_RETHROW( (trx_arg) ) }
 
+   set<address> transaction_evaluation_state::recover_signed_addresses( const signed_transaction& trx, const digest_type& chain_id,
+                                                                        const bool enforce_canonical )
+   { try {
+      set<address> addresses;
+      const auto trx_digest = trx.digest( chain_id );
+      for( const auto& sig : trx.signatures )
+      {
+         const auto key = fc::ecc::public_key( sig, trx_digest, enforce_canonical ).serialize();
+         addresses.insert( address( key ) );
+         addresses.insert( address( pts_address( key, false, 56 ) ) );
+         addresses.insert( address( pts_address( key, true, 56 ) ) );
+         addresses.insert( address( pts_address( key, false, 0 ) ) );
+         addresses.insert( address( pts_address( key, true, 0 ) ) );
+      }
+      return addresses;
+   } FC_CAPTURE_AND_RETHROW( (trx)(chain_id)(enforce_canonical) ) }
+
    void transaction_evaluation_state::evaluate_operation( const operation& op )
    { try {
       operation_factory::instance().evaluate( *this, op );
@@ -227,7 +239,7 @@ namespace bts { namespace blockchain {
            }
            else
            {
-               const oasset_record asset_record = pending_state()->get_asset_record( fee.asset_id );
+               const oasset_record asset_record = pending_state()->get_asset_definition( fee.asset_id );
                FC_ASSERT( asset_record.valid() );
 
                // Tally BitAsset fees using feed price discounted by 33%
@@ -111,6 +111,11 @@ signed_transactions client_impl::blockchain_list_pending_transactions() const
    return trxs;
 }
 
+pending_pool_stats detail::client_impl::blockchain_get_pending_pool_stats() const
+{
+   return _chain_db->get_pending_pool_stats();
+}
+
 uint32_t detail::client_impl::blockchain_get_block_count() const
 {
    return _chain_db->get_head_block_num();
@@ -375,7 +380,8 @@ unordered_map<balance_id_type, balance_record> detail::client_impl::blockchain_l
     return result;
 } FC_CAPTURE_AND_RETHROW( (raw_addr)(after) ) }
 
-fc::variant_object detail::client_impl::blockchain_list_address_transactions( const string& raw_addr, uint32_t after_block )const
+fc::variant_object detail::client_impl::blockchain_list_address_transactions( const string& raw_addr, uint32_t after_block,
+                                                                             uint32_t limit )const
 { try {
    fc::mutable_variant_object results;
 
@@ -385,15 +391,9 @@ fc::variant_object detail::client_impl::blockchain_list_address_transactions( co
    } catch (...) {
       addr = address( pts_address( raw_addr ) );
    }
-   auto transactions = _chain_db->fetch_address_transactions( addr );
-   ilog("Found ${num} transactions for ${addr}", ("num", transactions.size())("addr", raw_addr));
-
-   if( after_block > 0 )
-      transactions.erase(std::remove_if(transactions.begin(), transactions.end(),
-                                        [after_block](const blockchain::transaction_record& t) -> bool {
-         return t.chain_location.block_num <= after_block;
-      }), transactions.end());
-   ilog("Found ${num} transactions after block ${after_block}", ("num", transactions.size())("after_block", after_block));
+   const auto transactions = _chain_db->fetch_address_transactions( addr, after_block, limit );
+   ilog("Found ${num} transactions for ${addr} after block ${after_block}",
+        ("num", transactions.size())("addr", raw_addr)("after_block", after_block));
 
    for( const auto& trx : transactions )
    {
@@ -403,7 +403,7 @@ fc::variant_object detail::client_impl::blockchain_list_address_transactions( co
    }
 
    return results;
-} FC_CAPTURE_AND_RETHROW( (raw_addr)(after_block) ) }
+} FC_CAPTURE_AND_RETHROW( (raw_addr)(after_block)(limit) ) }
 
 unordered_map<balance_id_type, balance_record> detail::client_impl::blockchain_list_key_balances( const public_key_type& key )const
 { try {
@@ -576,6 +576,13 @@ vector<market_order> client_impl::blockchain_market_list_covers( const string& q
    return _chain_db->get_market_covers( quote_symbol, base_symbol, limit );
 }
 
+vector<market_order> client_impl::blockchain_list_margin_positions_at_risk( const string& quote_symbol,
+                                                                           uint32_t max_drop_percent,
+                                                                           uint32_t limit )const
+{
+   return _chain_db->get_margin_positions_at_risk( _chain_db->get_asset_id( quote_symbol ), max_drop_percent, limit );
+}
+
 share_type client_impl::blockchain_market_get_asset_collateral( const string& symbol )const
 {
    return _chain_db->get_asset_collateral( symbol );
@@ -663,6 +670,33 @@ market_history_points client_impl::blockchain_market_price_history( const std::s
                                                start_time, duration, granularity );
 }
 
+market_candles client_impl::blockchain_market_candles( const std::string& quote_symbol,
+                                                       const std::string& base_symbol,
+                                                       uint32_t resolution,
+                                                       const fc::time_point& start_time,
+                                                       uint32_t limit )const
+{
+   FC_ASSERT( _market_candles != nullptr );
+   return _market_candles->get_candles( _chain_db->get_asset_id( quote_symbol ), _chain_db->get_asset_id( base_symbol ),
+                                        resolution, start_time, limit );
+}
+
+market_depth client_impl::blockchain_market_depth( const std::string& quote_symbol,
+                                                   const std::string& base_symbol,
+                                                   uint32_t levels )const
+{
+   return _chain_db->get_market_depth( _chain_db->get_asset_id( quote_symbol ), _chain_db->get_asset_id( base_symbol ), levels );
+}
+
+std::vector<market_depth_update> client_impl::blockchain_market_depth_updates( const std::string& quote_symbol,
+                                                                               const std::string& base_symbol,
+                                                                               uint64_t after_update_id,
+                                                                               uint32_t limit )const
+{
+   return _chain_db->get_market_depth_updates( _chain_db->get_asset_id( quote_symbol ), _chain_db->get_asset_id( base_symbol ),
+                                               after_update_id, limit );
+}
+
 map<transaction_id_type, transaction_record> client_impl::blockchain_get_block_transactions( const string& block )const
 {
    vector<transaction_record> transactions;
@@ -1295,6 +1295,9 @@ void client::open( const path& data_dir, const fc::optional<fc::path>& genesis_f
     try
     {
        if( my->_config.statistics_enabled ) ulog( "Additional blockchain statistics enabled" );
+       my->_chain_db->set_state_cache_entries( my->_config.state_cache_entries );
+       my->_chain_db->set_pending_pool_limits( my->_config.pending_pool_max_bytes, my->_config.pending_pool_max_per_address );
+       my->_chain_db->set_pending_journal_enabled( my->_config.pending_journal_enabled );
        my->_chain_db->open( data_dir / "chain", genesis_file_path, my->_config.statistics_enabled, replay_status_callback );
     }
     catch( const db::level_map_open_failure& e )
@@ -1317,6 +1320,8 @@ void client::open( const path& data_dir, const fc::optional<fc::path>& genesis_f
        my->_chain_db->open( data_dir / "chain", genesis_file_path, my->_config.statistics_enabled, replay_status_callback );
     }
 
+    my->_market_candles = std::make_shared<market_candle_service>( my->_chain_db );
+
     my->_wallet = std::make_shared<bts::wallet::wallet>( my->_chain_db, my->_config.wallet_enabled );
     my->_wallet->set_data_directory( data_dir / "wallets" );
 
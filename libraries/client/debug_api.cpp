@@ -41,6 +41,14 @@ fc::variants client_impl::debug_list_matching_errors() const
     return _chain_db->debug_get_matching_errors();
 }
 
+fc::variant_object client_impl::debug_block_timing_stats( bool reset )
+{
+   fc::mutable_variant_object stats;
+   for( const auto& item : _chain_db->debug_get_block_timing_stats( reset ) )
+      stats( item.first, item.second );
+   return stats;
+}
+
 fc::variant_object client_impl::debug_get_call_statistics() const
 {
    return _p2p_node->get_call_statistics();
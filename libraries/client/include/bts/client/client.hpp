@@ -86,6 +86,10 @@ namespace bts { namespace client {
 
         optional<fc::path>  genesis_config;
         bool                statistics_enabled = false;
+        uint32_t            state_cache_entries = 0; // Records kept in memory per large chain database; zero for all
+        uint64_t            pending_pool_max_bytes = BTS_BLOCKCHAIN_MAX_PENDING_POOL_BYTES;
+        uint32_t            pending_pool_max_per_address = BTS_BLOCKCHAIN_MAX_PENDING_TRANSACTIONS_PER_ADDRESS;
+        bool                pending_journal_enabled = true; // Keep pending transactions across restarts
 
         vector<string>      default_peers = SEED_NODES;
         uint16_t            maximum_number_of_connections = BTS_NET_DEFAULT_MAX_CONNECTIONS;
@@ -211,6 +215,10 @@ FC_REFLECT( bts::client::config,
         (rpc)
         (genesis_config)
         (statistics_enabled)
+        (state_cache_entries)
+        (pending_pool_max_bytes)
+        (pending_pool_max_per_address)
+        (pending_journal_enabled)
         (default_peers)
         (maximum_number_of_connections)
         (use_upnp)
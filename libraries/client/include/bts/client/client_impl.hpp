@@ -1,5 +1,6 @@
 #pragma once
 
+#include <bts/blockchain/market_candles.hpp>
 #include <bts/cli/cli.hpp>
 #include <bts/client/notifier.hpp>
 #include <bts/net/chain_server.hpp>
@@ -221,6 +222,7 @@ public:
    std::unique_ptr<bts::net::chain_server>                 _chain_server = nullptr;
    std::unique_ptr<bts::net::upnp_service>                 _upnp_service = nullptr;
    chain_database_ptr                                      _chain_db = nullptr;
+   market_candle_service_ptr                               _market_candles = nullptr;
    unordered_map<transaction_id_type, signed_transaction>  _pending_trxs;
    wallet_ptr                                              _wallet = nullptr;
    fc::time_point                                          _last_sync_status_message_time;
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <fc/exception/exception.hpp>
+
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+namespace bts { namespace db {
+
+  /**
+   *  Eviction policies for the bounded cache of fast_level_map. A policy tracks the keys currently
+   *  cached and provides:
+   *
+   *  @code
+   *  void touch( const K& key );   // key was inserted or read
+   *  void erase( const K& key );   // key left the cache
+   *  K    victim();                // key to evict next; only called when keys are tracked
+   *  void clear();
+   *  @endcode
+   */
+
+  /** Evicts the least recently used key */
+  template<typename K>
+  class lru_eviction
+  {
+     public:
+        void touch( const K& key )
+        {
+            const auto iter = _index.find( key );
+            if( iter != _index.end() )
+            {
+                _order.splice( _order.begin(), _order, iter->second );
+                return;
+            }
+            _order.push_front( key );
+            _index.emplace( key, _order.begin() );
+        }
+
+        void erase( const K& key )
+        {
+            const auto iter = _index.find( key );
+            if( iter == _index.end() ) return;
+            _order.erase( iter->second );
+            _index.erase( iter );
+        }
+
+        K victim()const
+        {
+            FC_ASSERT( !_order.empty() );
+            return _order.back();
+        }
+
+        void clear()
+        {
+            _order.clear();
+            _index.clear();
+        }
+
+     private:
+        std::list<K>                                                _order; // Most recently used first
+        std::unordered_map<K, typename std::list<K>::iterator>      _index;
+  };
+
+  /**
+   *  Approximates LRU with one reference bit per key and a hand sweeping over the keys, so that a
+   *  hit only sets a flag instead of reordering a list
+   */
+  template<typename K>
+  class clock_eviction
+  {
+     public:
+        void touch( const K& key )
+        {
+            const auto iter = _index.find( key );
+            if( iter != _index.end() )
+            {
+                _slots[ iter->second ].referenced = true;
+                return;
+            }
+
+            size_t slot = _slots.size();
+            if( !_free_slots.empty() )
+            {
+                slot = _free_slots.back();
+                _free_slots.pop_back();
+                _slots[ slot ] = entry{ key, false, true };
+            }
+            else
+            {
+                _slots.push_back( entry{ key, false, true } );
+            }
+            _index.emplace( key, slot );
+        }
+
+        void erase( const K& key )
+        {
+            const auto iter = _index.find( key );
+            if( iter == _index.end() ) return;
+            _slots[ iter->second ].used = false;
+            _free_slots.push_back( iter->second );
+            _index.erase( iter );
+        }
+
+        K victim()
+        {
+            FC_ASSERT( !_index.empty() );
+            while( true )
+            {
+                if( _hand >= _slots.size() ) _hand = 0;
+                entry& e = _slots[ _hand++ ];
+                if( !e.used ) continue;
+                if( !e.referenced ) return e.key;
+                e.referenced = false;
+            }
+        }
+
+        void clear()
+        {
+            _slots.clear();
+            _free_slots.clear();
+            _index.clear();
+            _hand = 0;
+        }
+
+     private:
+        struct entry
+        {
+            K       key;
+            bool    referenced;
+            bool    used;
+        };
+
+        std::vector<entry>                  _slots;
+        std::vector<size_t>                 _free_slots;
+        std::unordered_map<K, size_t>       _index;
+        size_t                              _hand = 0;
+  };
+
+} } // bts::db
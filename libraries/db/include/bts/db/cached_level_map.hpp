@@ -208,6 +208,21 @@ namespace bts { namespace db {
            return iterator( _cache.lower_bound(key), _cache.begin(), _cache.end() );
         }
 
+        // Flushes first so that the iterator sees everything in the cache
+        std::shared_ptr<ldb::Iterator> raw_iterator()
+        { try {
+            if( !_dirty_store.empty() || !_dirty_remove.empty() )
+                flush();
+            return _db.raw_iterator();
+        } FC_CAPTURE_AND_RETHROW() }
+
+        // Bypasses the cache; only for filling a freshly created database, which must be reopened afterwards
+        void store_raw( const std::vector<std::pair<std::string, std::string>>& entries )
+        { try {
+            FC_ASSERT( _cache.empty() );
+            _db.store_raw( entries );
+        } FC_CAPTURE_AND_RETHROW() }
+
         // TODO: Iterate over cache instead
         void export_to_json( const fc::path& path )const
         { try {
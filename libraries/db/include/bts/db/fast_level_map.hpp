@@ -1,33 +1,137 @@
 #pragma once
+#include <bts/db/cache_eviction.hpp>
 #include <bts/db/level_map.hpp>
 
+#include <unordered_set>
+
 namespace bts { namespace db {
 
-template<typename K, typename V>
+/**
+ *  Keeps the records of a level_map in an unordered_map for fast lookups.
+ *
+ *  By default every record is loaded when the map is opened. Opening with a cache limit instead keeps at most
+ *  that many clean records in memory: lookups read through to LevelDB and the hot set is trimmed according to
+ *  EvictionPolicy. While LevelDB is toggled off, a bounded map keeps its writes in memory as dirty records and
+ *  writes them in batches, since it cannot hold the whole database.
+ */
+template<typename K, typename V, typename EvictionPolicy = lru_eviction<K>>
 class fast_level_map
 {
-    level_map<K, V>             _ldb;
+    typedef std::unordered_map<K, V> cache_type;
+
+    mutable level_map<K, V>     _ldb; // Read through from const lookups when bounded
     fc::optional<fc::path>      _ldb_path;
     bool                        _ldb_enabled = true;
 
-    std::unordered_map<K, V>    _cache;
+    size_t                      _cache_limit = 0; // Zero keeps every record in memory
+    mutable cache_type          _cache;
+    mutable EvictionPolicy      _eviction; // Tracks clean records only; dirty records stay cached until written
+    std::unordered_set<K>       _dirty_store;
+    std::unordered_set<K>       _dirty_remove;
+    size_t                      _size = 0; // Number of records when bounded
 
 public:
+    /**
+     *  Visits every record in no particular order. When bounded, records are streamed from LevelDB (skipping
+     *  those with unwritten changes) followed by the dirty records, so only the current record is in memory.
+     */
+    class unordered_iterator
+    {
+        public:
+            typedef std::pair<const K, V> value_type;
+
+            const value_type& operator*()const { return *operator->(); }
+
+            const value_type* operator->()const
+            {
+                if( _map == nullptr ) return &*_cache_iter;
+                return _current.get();
+            }
+
+            unordered_iterator& operator++()
+            {
+                if( _map == nullptr )
+                {
+                    ++_cache_iter;
+                    return *this;
+                }
+
+                if( !_in_dirty ) ++_ldb_iter;
+                else ++_dirty_iter;
+                skip_to_valid();
+                return *this;
+            }
+
+            bool operator==( const unordered_iterator& other )const
+            {
+                if( _map == nullptr ) return _cache_iter == other._cache_iter;
+                return _current == other._current;
+            }
+
+            bool operator!=( const unordered_iterator& other )const
+            {
+                return !( *this == other );
+            }
+
+        private:
+            friend class fast_level_map;
+
+            void skip_to_valid()
+            {
+                for( ; !_in_dirty; ++_ldb_iter )
+                {
+                    if( !_ldb_iter.valid() )
+                    {
+                        _in_dirty = true;
+                        _dirty_iter = _map->_dirty_store.begin();
+                        break;
+                    }
+
+                    const K key = _ldb_iter.key();
+                    if( _map->_dirty_store.count( key ) == 0 && _map->_dirty_remove.count( key ) == 0 )
+                    {
+                        _current = std::make_shared<value_type>( key, _ldb_iter.value() );
+                        return;
+                    }
+                }
+
+                if( _dirty_iter != _map->_dirty_store.end() )
+                    _current = std::make_shared<value_type>( *_dirty_iter, _map->_cache.at( *_dirty_iter ) );
+                else
+                    _current.reset();
+            }
+
+            typename cache_type::const_iterator                 _cache_iter;
+
+            const fast_level_map*                               _map = nullptr; // Only set when bounded
+            typename level_map<K, V>::iterator                  _ldb_iter;
+            typename std::unordered_set<K>::const_iterator      _dirty_iter;
+            bool                                                _in_dirty = false;
+            std::shared_ptr<value_type>                         _current;
+    };
 
     ~fast_level_map()
     {
         close();
     }
 
-    void open( const fc::path& path )
+    void open( const fc::path& path, size_t cache_limit = 0 )
     { try {
         FC_ASSERT( !_ldb_path.valid() );
         _ldb_path = path;
         _ldb.open( *_ldb_path );
+        _cache_limit = cache_limit;
+
+        if( bounded() )
+        {
+            _size = _ldb.size();
+            return;
+        }
+
         _cache.reserve( _ldb.size() );
         for( auto iter = _ldb.begin(); iter.valid(); ++iter )
             _cache.emplace( iter.key(), iter.value() );
-    } FC_CAPTURE_AND_RETHROW( (path) ) }
+    } FC_CAPTURE_AND_RETHROW( (path)(cache_limit) ) }
 
     void close()
     { try {
@@ -38,15 +142,30 @@ public:
             _ldb_path = fc::optional<fc::path>();
         }
         _cache.clear();
+        _eviction.clear();
+        _dirty_store.clear();
+        _dirty_remove.clear();
+        _size = 0;
     } FC_CAPTURE_AND_RETHROW() }
 
+    bool bounded()const
+    {
+        return _cache_limit > 0;
+    }
+
     void toggle_leveldb( const bool enabled )
     { try {
         FC_ASSERT( _ldb_path.valid() );
         if( enabled == _ldb_enabled )
             return;
 
-        if( enabled )
+        if( bounded() )
+        {
+            // LevelDB holds the records that are not cached, so it stays open and only the writes are deferred
+            if( enabled )
+                flush();
+        }
+        else if( enabled )
         {
             _ldb.open( *_ldb_path );
             auto batch = _ldb.create_batch();
@@ -63,50 +182,172 @@ public:
         _ldb_enabled = enabled;
     } FC_CAPTURE_AND_RETHROW( (enabled) ) }
 
+    /** Writes the dirty records of a bounded map */
+    void flush()
+    { try {
+        if( _dirty_store.empty() && _dirty_remove.empty() )
+            return;
+
+        auto batch = _ldb.create_batch();
+        for( const K& key : _dirty_store )
+            batch.store( key, _cache.at( key ) );
+        for( const K& key : _dirty_remove )
+            batch.remove( key );
+        batch.commit();
+
+        for( const K& key : _dirty_store )
+            _eviction.touch( key );
+        _dirty_store.clear();
+        _dirty_remove.clear();
+
+        evict();
+    } FC_CAPTURE_AND_RETHROW() }
+
     void store( const K& key, const V& value )
     { try {
+        if( !bounded() )
+        {
+            _cache[ key ] = value;
+            if( _ldb_enabled )
+                _ldb.store( key, value );
+            return;
+        }
+
+        if( count( key ) == 0 )
+            ++_size;
+
         _cache[ key ] = value;
         if( _ldb_enabled )
+        {
             _ldb.store( key, value );
+            _eviction.touch( key );
+            evict();
+        }
+        else
+        {
+            _eviction.erase( key );
+            _dirty_remove.erase( key );
+            _dirty_store.insert( key );
+            if( _dirty_store.size() + _dirty_remove.size() >= _cache_limit )
+                flush();
+        }
     } FC_CAPTURE_AND_RETHROW( (key)(value) ) }
 
     void remove( const K& key )
     { try {
+        if( !bounded() )
+        {
+            _cache.erase( key );
+            if( _ldb_enabled )
+                _ldb.remove( key );
+            return;
+        }
+
+        if( count( key ) != 0 )
+            --_size;
+
         _cache.erase( key );
+        _eviction.erase( key );
         if( _ldb_enabled )
+        {
             _ldb.remove( key );
+        }
+        else
+        {
+            _dirty_store.erase( key );
+            _dirty_remove.insert( key );
+            if( _dirty_store.size() + _dirty_remove.size() >= _cache_limit )
+                flush();
+        }
     } FC_CAPTURE_AND_RETHROW( (key) ) }
 
-    auto empty()const -> decltype( _cache.empty() )
-    {
-        return _cache.empty();
-    }
+    fc::optional<V> fetch_optional( const K& key )const
+    { try {
+        const auto iter = _cache.find( key );
+        if( iter != _cache.end() )
+        {
+            if( bounded() && _dirty_store.count( key ) == 0 )
+                _eviction.touch( key );
+            return iter->second;
+        }
 
-    auto size()const -> decltype( _cache.size() )
-    {
-        return _cache.size();
-    }
+        if( !bounded() || _dirty_remove.count( key ) != 0 )
+            return fc::optional<V>();
 
-    auto count( const K& key )const -> decltype( _cache.count( key ) )
-    {
-        return _cache.count( key );
-    }
+        const fc::optional<V> value = _ldb.fetch_optional( key );
+        if( value.valid() )
+        {
+            _cache.emplace( key, *value );
+            _eviction.touch( key );
+            evict();
+        }
+        return value;
+    } FC_CAPTURE_AND_RETHROW( (key) ) }
 
-    auto unordered_begin()const -> decltype( _cache.cbegin() )
+    bool empty()const
     {
-        return _cache.cbegin();
+        return size() == 0;
     }
 
-    auto unordered_end()const -> decltype( _cache.cend() )
+    size_t size()const
     {
-        return _cache.cend();
+        return bounded() ? _size : _cache.size();
     }
 
-    auto unordered_find( const K& key )const -> decltype( _cache.find( key ) )
+    size_t count( const K& key )const
+    { try {
+        if( _cache.find( key ) != _cache.end() )
+            return 1;
+
+        if( !bounded() || _dirty_remove.count( key ) != 0 )
+            return 0;
+
+        return _ldb.find( key ).valid() ? 1 : 0;
+    } FC_CAPTURE_AND_RETHROW( (key) ) }
+
+    unordered_iterator unordered_begin()const
+    { try {
+        unordered_iterator iter;
+        if( !bounded() )
+        {
+            iter._cache_iter = _cache.cbegin();
+            return iter;
+        }
+
+        iter._map = this;
+        iter._ldb_iter = _ldb.begin();
+        iter.skip_to_valid();
+        return iter;
+    } FC_CAPTURE_AND_RETHROW() }
+
+    unordered_iterator unordered_end()const
     {
-        return _cache.find( key );
+        unordered_iterator iter;
+        if( !bounded() )
+        {
+            iter._cache_iter = _cache.cend();
+            return iter;
+        }
+
+        iter._map = this;
+        iter._in_dirty = true;
+        iter._dirty_iter = _dirty_store.end();
+        return iter;
     }
 
+    auto raw_iterator()const -> decltype( _ldb.raw_iterator() )
+    { try {
+        FC_ASSERT( _ldb_enabled );
+        return _ldb.raw_iterator();
+    } FC_CAPTURE_AND_RETHROW() }
+
+    // Bypasses the cache; only for filling a freshly created database, which must be reopened afterwards
+    void store_raw( const std::vector<std::pair<std::string, std::string>>& entries )
+    { try {
+        FC_ASSERT( _ldb_enabled && _cache.empty() );
+        _ldb.store_raw( entries );
+    } FC_CAPTURE_AND_RETHROW() }
+
     auto ordered_first()const -> decltype( _ldb.begin() )
     { try {
         return _ldb.begin();
@@ -121,6 +362,17 @@ public:
     { try {
         return _ldb.lower_bound( key );
     } FC_CAPTURE_AND_RETHROW( (key) ) }
+
+private:
+    void evict()const
+    {
+        while( _cache.size() - _dirty_store.size() > _cache_limit )
+        {
+            const K key = _eviction.victim();
+            _eviction.erase( key );
+            _cache.erase( key );
+        }
+    }
 };
 
 } } // bts::db
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <fc/exception/exception.hpp>
+#include <fc/io/raw.hpp>
+#include <fc/uint128.hpp>
+
+#include <cstring>
+#include <vector>
+
+namespace bts { namespace db {
+
+  /**
+   *  By default keys are stored using fc::raw and LevelDB has to unpack both keys on every
+   *  comparison. Specializing this trait for a key type opts it into an encoding where a plain
+   *  bytewise comparison of the encoded keys gives the same order as the key's operator <, so
+   *  the databases can use LevelDB's builtin bytewise comparator instead.
+   *
+   *  A specialization must set enabled to true and provide:
+   *
+   *  @code
+   *  static void encode( key_encoding::writer& w, const Key& key );
+   *  static void decode( key_encoding::reader& r, Key& key );
+   *  @endcode
+   *
+   *  Existing databases are converted by try_upgrade_key_encoding() the first time they are opened,
+   *  so opting in a type rewrites every database keyed by it; only opt in types of specific databases.
+   */
+  template<typename Key>
+  struct memcmp_key_encoding
+  {
+      static const bool enabled = false;
+  };
+
+  namespace key_encoding
+  {
+      /** Fixed width, big endian writer; signed values have their sign bit flipped */
+      class writer
+      {
+         public:
+            void write_uint8( uint8_t v )   { bytes.push_back( char( v ) ); }
+            void write_uint32( uint32_t v ) { for( int i = 3; i >= 0; --i ) write_uint8( uint8_t( v >> (8 * i) ) ); }
+            void write_uint64( uint64_t v ) { for( int i = 7; i >= 0; --i ) write_uint8( uint8_t( v >> (8 * i) ) ); }
+            void write_int32( int32_t v )   { write_uint32( uint32_t( v ) ^ 0x80000000u ); }
+            void write_int64( int64_t v )   { write_uint64( uint64_t( v ) ^ 0x8000000000000000ull ); }
+
+            void write_uint128( const fc::uint128& v )
+            {
+                write_uint64( v.high_bits() );
+                write_uint64( v.low_bits() );
+            }
+
+            /** Only valid for fixed size values whose operator < is a memcmp of their bytes, e.g. fc hashes */
+            void write_bytes( const char* data, size_t size ) { bytes.insert( bytes.end(), data, data + size ); }
+
+            std::vector<char> bytes;
+      };
+
+      class reader
+      {
+         public:
+            reader( const char* data, size_t size ):_pos( data ),_end( data + size ){}
+
+            uint8_t read_uint8()
+            {
+                FC_ASSERT( _pos < _end, "encoded key is too short" );
+                return uint8_t( *_pos++ );
+            }
+
+            uint32_t read_uint32()
+            {
+                uint32_t v = 0;
+                for( int i = 0; i < 4; ++i ) v = (v << 8) | read_uint8();
+                return v;
+            }
+
+            uint64_t read_uint64()
+            {
+                uint64_t v = 0;
+                for( int i = 0; i < 8; ++i ) v = (v << 8) | read_uint8();
+                return v;
+            }
+
+            int32_t read_int32() { return int32_t( read_uint32() ^ 0x80000000u ); }
+            int64_t read_int64() { return int64_t( read_uint64() ^ 0x8000000000000000ull ); }
+
+            fc::uint128 read_uint128()
+            {
+                const uint64_t hi = read_uint64();
+                const uint64_t lo = read_uint64();
+                return fc::uint128( hi, lo );
+            }
+
+            void read_bytes( char* data, size_t size )
+            {
+                FC_ASSERT( size_t( _end - _pos ) >= size, "encoded key is too short" );
+                memcpy( data, _pos, size );
+                _pos += size;
+            }
+
+            size_t remaining()const { return _end - _pos; }
+
+         private:
+            const char* _pos;
+            const char* _end;
+      };
+  } // key_encoding
+
+  /**
+   *  Converts keys to and from their stored representation; used by the level_map family so
+   *  the choice of encoding is made once per key type at compile time.
+   */
+  template<typename Key, bool MemcmpOrdered = memcmp_key_encoding<Key>::enabled>
+  struct key_codec
+  {
+      static const bool memcmp_ordered = false;
+
+      static std::vector<char> pack( const Key& key )
+      {
+          return fc::raw::pack( key );
+      }
+
+      static void unpack( const char* data, size_t size, Key& key )
+      {
+          fc::datastream<const char*> ds( data, size );
+          fc::raw::unpack( ds, key );
+      }
+  };
+
+  template<typename Key>
+  struct key_codec<Key, true>
+  {
+      static const bool memcmp_ordered = true;
+
+      static std::vector<char> pack( const Key& key )
+      {
+          key_encoding::writer w;
+          memcmp_key_encoding<Key>::encode( w, key );
+          return std::move( w.bytes );
+      }
+
+      static void unpack( const char* data, size_t size, Key& key )
+      {
+          key_encoding::reader r( data, size );
+          memcmp_key_encoding<Key>::decode( r, key );
+          FC_ASSERT( r.remaining() == 0, "unexpected trailing bytes in encoded key" );
+      }
+  };
+
+} } // bts::db
@@ -6,6 +6,7 @@
 #include <leveldb/write_batch.h>
 
 #include <bts/db/exception.hpp>
+#include <bts/db/key_encoding.hpp>
 #include <bts/db/upgrade_leveldb.hpp>
 
 #include <fc/filesystem.hpp>
@@ -21,6 +22,9 @@ namespace bts { namespace db {
 
   /**
    *  @brief implements a high-level API on top of Level DB that stores items using fc::raw / reflection
+   *
+   *  Keys are stored using fc::raw unless the key type specializes memcmp_key_encoding, in which case
+   *  the memcmp ordered encoding and LevelDB's bytewise comparator are used.
    */
   template<typename Key, typename Value>
   class level_map
@@ -31,7 +35,7 @@ namespace bts { namespace db {
            FC_ASSERT( !is_open(), "Database is already open!" );
 
            ldb::Options opts;
-           opts.comparator = &_comparer;
+           opts.comparator = key_codec<Key>::memcmp_ordered ? ldb::BytewiseComparator() : &_comparer;
            opts.create_if_missing = create;
            opts.max_open_files = 64;
            opts.compression = leveldb::kNoCompression;
@@ -55,6 +59,18 @@ namespace bts { namespace db {
            _iter_options.fill_cache = false;
            _sync_options.sync = true;
 
+           // Before the directory is created, so a swap interrupted by a crash can still be finished
+           if( key_codec<Key>::memcmp_ordered )
+           {
+               try_upgrade_key_encoding( dir, &_comparer, []( const ldb::Slice& old_key ) -> std::string
+               {
+                   Key key;
+                   key_codec<Key, false>::unpack( old_key.data(), old_key.size(), key );
+                   const std::vector<char> new_key = key_codec<Key>::pack( key );
+                   return std::string( new_key.begin(), new_key.end() );
+               } );
+           }
+
            // Given path must exist to succeed toNativeAnsiPath
            fc::create_directories( dir );
            std::string ldbPath = dir.to_native_ansi_path();
@@ -96,7 +112,7 @@ namespace bts { namespace db {
         { try {
            FC_ASSERT( is_open(), "Database is not open!" );
 
-           std::vector<char> kslice = fc::raw::pack( k );
+           std::vector<char> kslice = key_codec<Key>::pack( k );
            ldb::Slice ks( kslice.data(), kslice.size() );
            std::string value;
            auto status = _db->Get( _read_options, ks, &value );
@@ -126,8 +142,7 @@ namespace bts { namespace db {
              Key key()const
              {
                  Key tmp_key;
-                 fc::datastream<const char*> ds2( _it->key().data(), _it->key().size() );
-                 fc::raw::unpack( ds2, tmp_key );
+                 key_codec<Key>::unpack( _it->key().data(), _it->key().size(), tmp_key );
                  return tmp_key;
              }
 
@@ -184,9 +199,10 @@ namespace bts { namespace db {
             * memory allocation to seralize the key.
             */
            fc::array<char,256+sizeof(Key)>  stack_buffer;
+           std::vector<char> kslice;
 
-           size_t pack_size = fc::raw::pack_size(key);
-           if( pack_size <= stack_buffer.size() )
+           size_t pack_size = key_codec<Key>::memcmp_ordered ? 0 : fc::raw::pack_size(key);
+           if( !key_codec<Key>::memcmp_ordered && pack_size <= stack_buffer.size() )
            {
               fc::datastream<char*> ds( stack_buffer.data, stack_buffer.size() );
               fc::raw::pack( ds ,key );
@@ -194,7 +210,7 @@ namespace bts { namespace db {
            }
            else
            {
-              auto kslice = fc::raw::pack( key );
+              kslice = key_codec<Key>::pack( key );
               key_slice = ldb::Slice( kslice.data(), kslice.size() );
            }
 
@@ -211,7 +227,7 @@ namespace bts { namespace db {
         { try {
            FC_ASSERT( is_open(), "Database is not open!" );
 
-           std::vector<char> kslice = fc::raw::pack( key );
+           std::vector<char> kslice = key_codec<Key>::pack( key );
            ldb::Slice key_slice( kslice.data(), kslice.size() );
 
            iterator itr( _db->NewIterator( _iter_options ) );
@@ -239,8 +255,7 @@ namespace bts { namespace db {
            {
              return false;
            }
-           fc::datastream<const char*> ds2( it->key().data(), it->key().size() );
-           fc::raw::unpack( ds2, k );
+           key_codec<Key>::unpack( it->key().data(), it->key().size(), k );
            return true;
         } FC_RETHROW_EXCEPTIONS( warn, "error reading last item from database" ); }
 
@@ -258,8 +273,7 @@ namespace bts { namespace db {
            fc::datastream<const char*> ds( it->value().data(), it->value().size() );
            fc::raw::unpack( ds, v );
 
-           fc::datastream<const char*> ds2( it->key().data(), it->key().size() );
-           fc::raw::unpack( ds2, k );
+           key_codec<Key>::unpack( it->key().data(), it->key().size(), k );
            return true;
         } FC_RETHROW_EXCEPTIONS( warn, "error reading last item from database" ); }
 
@@ -322,7 +336,7 @@ namespace bts { namespace db {
 
                 void store( const Key& k, const Value& v )
                 {
-                  std::vector<char> kslice = fc::raw::pack(k);
+                  std::vector<char> kslice = key_codec<Key>::pack(k);
                   ldb::Slice ks(kslice.data(), kslice.size());
 
                   auto vec = fc::raw::pack(v);
@@ -333,7 +347,7 @@ namespace bts { namespace db {
 
                 void remove( const Key& k )
                 {
-                  std::vector<char> kslice = fc::raw::pack(k);
+                  std::vector<char> kslice = key_codec<Key>::pack(k);
                   ldb::Slice ks(kslice.data(), kslice.size());
                   _batch.Delete(ks);
                 }
@@ -349,7 +363,7 @@ namespace bts { namespace db {
         { try {
            FC_ASSERT( is_open(), "Database is not open!" );
 
-           std::vector<char> kslice = fc::raw::pack( k );
+           std::vector<char> kslice = key_codec<Key>::pack( k );
            ldb::Slice ks( kslice.data(), kslice.size() );
 
            auto vec = fc::raw::pack(v);
@@ -366,7 +380,7 @@ namespace bts { namespace db {
         { try {
            FC_ASSERT( is_open(), "Database is not open!" );
 
-           std::vector<char> kslice = fc::raw::pack( k );
+           std::vector<char> kslice = key_codec<Key>::pack( k );
            ldb::Slice ks( kslice.data(), kslice.size() );
            auto status = _db->Delete( sync ? _sync_options : _write_options, ks );
            if( !status.ok() )
@@ -375,6 +389,36 @@ namespace bts { namespace db {
            }
         } FC_RETHROW_EXCEPTIONS( warn, "error removing ${key}", ("key",k) ); }
 
+        /**
+         *  Iterates the stored key and value bytes without unpacking them, positioned at the first entry.
+         *  The iterator keeps seeing the database as it was when this was called; it must be destroyed
+         *  before the database is closed.
+         */
+        std::shared_ptr<ldb::Iterator> raw_iterator()const
+        { try {
+           FC_ASSERT( is_open(), "Database is not open!" );
+
+           std::shared_ptr<ldb::Iterator> iter( _db->NewIterator( _iter_options ) );
+           iter->SeekToFirst();
+           return iter;
+        } FC_CAPTURE_AND_RETHROW() }
+
+        /** Writes entries previously read with raw_iterator() in a single batch */
+        void store_raw( const std::vector<std::pair<std::string, std::string>>& entries )
+        { try {
+           FC_ASSERT( is_open(), "Database is not open!" );
+
+           ldb::WriteBatch batch;
+           for( const auto& entry : entries )
+               batch.Put( entry.first, entry.second );
+
+           auto status = _db->Write( _write_options, &batch );
+           if( !status.ok() )
+           {
+               FC_THROW_EXCEPTION( level_map_failure, "database error: ${msg}", ("msg", status.ToString() ) );
+           }
+        } FC_CAPTURE_AND_RETHROW( (entries.size()) ) }
+
         void export_to_json( const fc::path& path )const
         { try {
             FC_ASSERT( is_open(), "Database is not open!" );
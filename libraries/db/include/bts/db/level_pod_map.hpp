@@ -5,6 +5,7 @@
 #include <leveldb/db.h>
 
 #include <bts/db/exception.hpp>
+#include <bts/db/key_encoding.hpp>
 #include <bts/db/upgrade_leveldb.hpp>
 
 #include <fc/filesystem.hpp>
@@ -15,9 +16,44 @@ namespace bts { namespace db {
 
   namespace ldb = leveldb;
 
+  namespace detail
+  {
+      template<typename Key, bool MemcmpOrdered = memcmp_key_encoding<Key>::enabled>
+      struct pod_key_codec
+      {
+          static ldb::Slice slice( const Key& k, std::vector<char>& )
+          {
+              return ldb::Slice( (char*)&k, sizeof(k) );
+          }
+
+          static Key unpack( const ldb::Slice& s )
+          {
+              FC_ASSERT( sizeof(Key) == s.size() );
+              return *((Key*)s.data());
+          }
+      };
+
+      template<typename Key>
+      struct pod_key_codec<Key, true>
+      {
+          static ldb::Slice slice( const Key& k, std::vector<char>& encoded )
+          {
+              encoded = key_codec<Key>::pack( k );
+              return ldb::Slice( encoded.data(), encoded.size() );
+          }
+
+          static Key unpack( const ldb::Slice& s )
+          {
+              Key k;
+              key_codec<Key>::unpack( s.data(), s.size(), k );
+              return k;
+          }
+      };
+  } // detail
+
   /**
    *  @brief implements a high-level API on top of Level DB that stores items using fc::raw / reflection
-   *  @note Key must be a POD type
+   *  @note Key must be a POD type; it is stored as raw memory unless it specializes memcmp_key_encoding
    */
   template<typename Key, typename Value>
   class level_pod_map
@@ -28,7 +64,7 @@ namespace bts { namespace db {
            FC_ASSERT( !is_open(), "Database is already open!" );
 
            ldb::Options opts;
-           opts.comparator = &_comparer;
+           opts.comparator = key_codec<Key>::memcmp_ordered ? ldb::BytewiseComparator() : &_comparer;
            opts.create_if_missing = create;
            opts.max_open_files = 64;
            opts.compression = leveldb::kNoCompression;
@@ -52,6 +88,17 @@ namespace bts { namespace db {
            _iter_options.fill_cache = false;
            _sync_options.sync = true;
 
+           // Before the directory is created, so a swap interrupted by a crash can still be finished
+           if( key_codec<Key>::memcmp_ordered )
+           {
+               try_upgrade_key_encoding( dir, &_comparer, []( const ldb::Slice& old_key ) -> std::string
+               {
+                   std::vector<char> new_key;
+                   detail::pod_key_codec<Key>::slice( detail::pod_key_codec<Key, false>::unpack( old_key ), new_key );
+                   return std::string( new_key.begin(), new_key.end() );
+               } );
+           }
+
            // Given path must exist to succeed toNativeAnsiPath
            fc::create_directories( dir );
            std::string ldbPath = dir.to_native_ansi_path();
@@ -93,7 +140,7 @@ namespace bts { namespace db {
         { try {
            FC_ASSERT( is_open(), "Database is not open!" );
 
-           ldb::Slice key_slice( (char*)&key, sizeof(key) );
+           const key_slice_holder key_slice( key );
            std::string value;
            auto status = _db->Get( _read_options, key_slice, &value );
            if( status.IsNotFound() )
@@ -121,8 +168,7 @@ namespace bts { namespace db {
 
              Key key()const
              {
-                 FC_ASSERT( sizeof(Key) == _it->key().size() );
-                 return *((Key*)_it->key().data());
+                 return unpack_key( _it->key() );
              }
 
              Value value()const
@@ -170,7 +216,7 @@ namespace bts { namespace db {
         { try {
            FC_ASSERT( is_open(), "Database is not open!" );
 
-           ldb::Slice key_slice( (char*)&key, sizeof(key) );
+           const key_slice_holder key_slice( key );
            iterator itr( _db->NewIterator( _iter_options ) );
            itr._it->Seek( key_slice );
            if( itr.valid() && itr.key() == key )
@@ -184,7 +230,7 @@ namespace bts { namespace db {
         { try {
            FC_ASSERT( is_open(), "Database is not open!" );
 
-           ldb::Slice key_slice( (char*)&key, sizeof(key) );
+           const key_slice_holder key_slice( key );
            iterator itr( _db->NewIterator( _iter_options ) );
            itr._it->Seek( key_slice );
            if( itr.valid()  )
@@ -205,8 +251,7 @@ namespace bts { namespace db {
            {
              return false;
            }
-           FC_ASSERT( sizeof( Key) == it->key().size() );
-           k = *((Key*)it->key().data());
+           k = unpack_key( it->key() );
            return true;
         } FC_RETHROW_EXCEPTIONS( warn, "error reading last item from database" ); }
 
@@ -224,8 +269,7 @@ namespace bts { namespace db {
            fc::datastream<const char*> ds( it->value().data(), it->value().size() );
            fc::raw::unpack( ds, v );
 
-           FC_ASSERT( sizeof( Key) == it->key().size() );
-           k = *((Key*)it->key().data());
+           k = unpack_key( it->key() );
            return true;
         } FC_RETHROW_EXCEPTIONS( warn, "error reading last item from database" ); }
 
@@ -233,7 +277,7 @@ namespace bts { namespace db {
         { try {
            FC_ASSERT( is_open(), "Database is not open!" );
 
-           ldb::Slice ks( (char*)&k, sizeof(k) );
+           const key_slice_holder ks( k );
            auto vec = fc::raw::pack(v);
            ldb::Slice vs( vec.data(), vec.size() );
 
@@ -248,7 +292,7 @@ namespace bts { namespace db {
         { try {
            FC_ASSERT( is_open(), "Database is not open!" );
 
-           ldb::Slice ks( (char*)&k, sizeof(k) );
+           const key_slice_holder ks( k );
            auto status = _db->Delete( sync ? _sync_options : _write_options, ks );
            if( status.IsNotFound() )
            {
@@ -261,6 +305,24 @@ namespace bts { namespace db {
         } FC_RETHROW_EXCEPTIONS( warn, "error removing ${key}", ("key",k) ); }
 
      private:
+        /** Refers to the key's memory directly unless the key uses the memcmp ordered encoding */
+        class key_slice_holder
+        {
+           public:
+             key_slice_holder( const Key& k ):_slice( detail::pod_key_codec<Key>::slice( k, _encoded ) ){}
+
+             operator const ldb::Slice&()const { return _slice; }
+
+           private:
+             std::vector<char> _encoded;
+             ldb::Slice        _slice;
+        };
+
+        static Key unpack_key( const ldb::Slice& s )
+        {
+            return detail::pod_key_codec<Key>::unpack( s );
+        }
+
         class key_compare : public leveldb::Comparator
         {
           public:
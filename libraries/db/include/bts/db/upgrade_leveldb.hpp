@@ -112,4 +112,16 @@ namespace bts { namespace db {
 
     void try_upgrade_db( const fc::path& dir, leveldb::DB* dbase, const char* record_type, size_t record_type_size );
 
+    /**
+     * Databases whose key type opts into memcmp_key_encoding are ordered with LevelDB's bytewise
+     * comparator. Databases created before that were ordered by old_comparator and stored fc::raw
+     * packed keys, so they are rewritten once with each key converted by encode_key. A KEY_ENCODING
+     * file is left in the directory to mark that the conversion has been done.
+     *
+     * Must be called before the database is opened.
+     */
+    typedef std::function<std::string( const leveldb::Slice& )> encode_key_function;
+    void try_upgrade_key_encoding( const fc::path& dir, const leveldb::Comparator* old_comparator,
+                                   const encode_key_function& encode_key );
+
 } } // namespace db
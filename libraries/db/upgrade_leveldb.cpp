@@ -1,5 +1,6 @@
 #include <bts/db/exception.hpp>
 #include <bts/db/upgrade_leveldb.hpp>
+#include <leveldb/write_batch.h>
 #include <fc/log/logger.hpp>
 #include <boost/filesystem.hpp>
 #include <fstream>
@@ -94,4 +95,107 @@ namespace bts { namespace db {
 
       }
     }
+
+    void try_upgrade_key_encoding( const fc::path& dir, const leveldb::Comparator* old_comparator,
+                                   const encode_key_function& encode_key )
+    {
+      static const char* const key_encoding_name = "memcmp";
+
+      const auto write_key_encoding = [&]( const fc::path& db_dir )
+      {
+        boost::filesystem::ofstream os( db_dir / "KEY_ENCODING" );
+        os << key_encoding_name << std::endl;
+      };
+
+      //the database is swapped with its converted copy by renaming; finish a swap interrupted by a crash
+      const fc::path new_dir = dir.parent_path() / (dir.filename().string() + ".key_upgrade");
+      const fc::path old_dir = dir.parent_path() / (dir.filename().string() + ".key_upgrade_old");
+      if( !boost::filesystem::exists( dir / "CURRENT" ) && boost::filesystem::exists( old_dir ) )
+      {
+        //an empty directory left in the database's place is not a database
+        boost::filesystem::remove_all( dir );
+
+        //the converted copy is complete once it has its KEY_ENCODING file
+        if( boost::filesystem::exists( new_dir / "KEY_ENCODING" ) )
+          boost::filesystem::rename( new_dir, dir );
+        else
+        {
+          boost::filesystem::remove_all( new_dir );
+          boost::filesystem::rename( old_dir, dir );
+        }
+      }
+      boost::filesystem::remove_all( old_dir );
+
+      const fc::path key_encoding_filename = dir / "KEY_ENCODING";
+      if( boost::filesystem::exists( key_encoding_filename ) )
+        return;
+
+      //if the database does not exist yet, it will be created with the new encoding
+      if( boost::filesystem::exists( dir / "CURRENT" ) )
+      {
+        ilog("Upgrading key encoding of database ${db}",("db",dir.preferred_string()));
+
+        leveldb::Options old_options;
+        old_options.comparator = old_comparator;
+        leveldb::DB* old_db = nullptr;
+        auto status = leveldb::DB::Open( old_options, dir.to_native_ansi_path(), &old_db );
+        if( !status.ok() )
+          FC_THROW_EXCEPTION( exception, "database error: ${msg}", ("msg", status.ToString() ) );
+        std::unique_ptr<leveldb::DB> old_dbase( old_db );
+
+        boost::filesystem::remove_all( new_dir );
+
+        leveldb::Options new_options;
+        new_options.create_if_missing = true;
+        new_options.compression = leveldb::kNoCompression;
+        leveldb::DB* new_db = nullptr;
+        status = leveldb::DB::Open( new_options, new_dir.to_native_ansi_path(), &new_db );
+        if( !status.ok() )
+          FC_THROW_EXCEPTION( exception, "database error: ${msg}", ("msg", status.ToString() ) );
+        std::unique_ptr<leveldb::DB> new_dbase( new_db );
+
+        std::unique_ptr<leveldb::Iterator> dbase_itr( old_dbase->NewIterator( leveldb::ReadOptions() ) );
+        leveldb::WriteBatch batch;
+        uint32_t batch_size = 0;
+        for( dbase_itr->SeekToFirst(); dbase_itr->Valid(); dbase_itr->Next() )
+        {
+          batch.Put( encode_key( dbase_itr->key() ), dbase_itr->value() );
+          if( ++batch_size % 1000 == 0 )
+          {
+            status = new_dbase->Write( leveldb::WriteOptions(), &batch );
+            if( !status.ok() )
+              FC_THROW_EXCEPTION( exception, "database error: ${msg}", ("msg", status.ToString() ) );
+            batch.Clear();
+          }
+        }
+        if( !dbase_itr->status().ok() )
+          FC_THROW_EXCEPTION( exception, "database error: ${msg}", ("msg", dbase_itr->status().ToString() ) );
+
+        leveldb::WriteOptions sync_options;
+        sync_options.sync = true;
+        status = new_dbase->Write( sync_options, &batch );
+        if( !status.ok() )
+          FC_THROW_EXCEPTION( exception, "database error: ${msg}", ("msg", status.ToString() ) );
+
+        dbase_itr.reset();
+        old_dbase.reset();
+        new_dbase.reset();
+
+        //carry over the value type version so try_upgrade_db still sees it
+        const fc::path record_type_filename = dir / "RECORD_TYPE";
+        if( boost::filesystem::exists( record_type_filename ) )
+          boost::filesystem::copy_file( record_type_filename, new_dir / "RECORD_TYPE" );
+        write_key_encoding( new_dir );
+
+        //keep the old database until the converted one is in its place
+        boost::filesystem::rename( dir, old_dir );
+        boost::filesystem::rename( new_dir, dir );
+        boost::filesystem::remove_all( old_dir );
+        return;
+      }
+
+      boost::filesystem::create_directories( dir );
+      write_key_encoding( dir );
+    }
+
 } } // namespace bts;:db
@@ -1,6 +1,8 @@
 #include <algorithm>
 #include <bts/net/chain_downloader.hpp>
 #include <bts/net/chain_server_commands.hpp>
+#include <bts/net/compression.hpp>
+#include <bts/net/config.hpp>
 
 #include <fc/network/tcp_socket.hpp>
 #include <fc/io/raw_variant.hpp>
@@ -49,6 +51,54 @@ namespace bts { namespace net {
               }
           } FC_RETHROW_EXCEPTIONS(error, "") }
 
+          /** Asks the server for compressed batches; returns false if it only knows how to send blocks one by one */
+          bool request_compressed_blocks(uint32_t first_block_number)
+          {
+              if (first_block_number & COMPRESSED_BLOCKS_FLAG)
+                  return false;
+
+              fc::raw::pack(*_client_socket, get_blocks_from_number);
+              fc::raw::pack(*_client_socket, first_block_number | COMPRESSED_BLOCKS_FLAG);
+
+              uint32_t reply = 0;
+              fc::raw::unpack(*_client_socket, reply);
+              if (reply == COMPRESSED_BLOCKS_ACK)
+                  return true;
+              FC_ASSERT(reply == 0, "Unexpected reply to a compressed block request", ("reply", reply));
+              ilog("Server at ${remote} doesn't send compressed blocks", ("remote", _client_socket->remote_endpoint()));
+              return false;
+          }
+
+          uint32_t receive_compressed_blocks(const std::function<void (const blockchain::full_block&, uint32_t)>& new_block_callback,
+                                             fc::time_point& checkpoint)
+          {
+              uint32_t blocks_in = 0;
+              compressed_block_batch batch;
+              fc::raw::unpack(*_client_socket, batch);
+              while (batch.block_count > 0)
+              {
+                  checkpoint = fc::time_point::now();
+                  // a batch ends with the block that takes it past the batch size, which can be no bigger than a message
+                  FC_ASSERT(batch.uncompressed_size <= BTS_NET_CHAIN_SERVER_MAX_BATCH_SIZE,
+                            "Server sent an oversized block batch", ("size", batch.uncompressed_size));
+                  std::vector<char> packed_blocks = decompress_data(batch.compressed_blocks, batch.uncompressed_size);
+
+                  fc::datastream<const char*> ds(packed_blocks.data(), packed_blocks.size());
+                  for (uint32_t i = 0; i < batch.block_count; ++i)
+                  {
+                      checkpoint = fc::time_point::now();
+                      blockchain::full_block block;
+                      fc::raw::unpack(ds, block);
+
+                      new_block_callback(block, batch.blocks_remaining + batch.block_count - i);
+                      ++blocks_in;
+                  }
+
+                  fc::raw::unpack(*_client_socket, batch);
+              }
+              return blocks_in;
+          }
+
           void get_all_blocks(std::function<void (const blockchain::full_block&, uint32_t)> new_block_callback,
                               uint32_t first_block_number)
           { try {
@@ -70,14 +120,20 @@ namespace bts { namespace net {
                        ulog("Starting fast-sync of blocks from ${num}", ("num", first_block_number));
                        auto start_time = fc::time_point::now();
 
-                       fc::raw::pack(*_client_socket, get_blocks_from_number);
-                       fc::raw::pack(*_client_socket, first_block_number);
-
                        uint32_t blocks_to_retrieve = 0;
                        uint32_t blocks_in = 0;
-                       fc::raw::unpack(*_client_socket, blocks_to_retrieve);
-                       ilog("Server at ${remote} is sending us ${num} blocks.",
-                            ("remote", _client_socket->remote_endpoint())("num", blocks_to_retrieve));
+                       if (request_compressed_blocks(first_block_number))
+                       {
+                           blocks_in = receive_compressed_blocks(new_block_callback, checkpoint);
+                       }
+                       else
+                       {
+                           fc::raw::pack(*_client_socket, get_blocks_from_number);
+                           fc::raw::pack(*_client_socket, first_block_number);
+                           fc::raw::unpack(*_client_socket, blocks_to_retrieve);
+                           ilog("Server at ${remote} is sending us ${num} blocks.",
+                                ("remote", _client_socket->remote_endpoint())("num", blocks_to_retrieve));
+                       }
 
                        while(blocks_to_retrieve > 0)
                        {
@@ -1,6 +1,8 @@
 #include <bts/net/stcp_socket.hpp>
 #include <bts/net/chain_server.hpp>
 #include <bts/net/chain_server_commands.hpp>
+#include <bts/net/compression.hpp>
+#include <bts/net/config.hpp>
 
 #include <fc/io/raw_variant.hpp>
 #include <fc/thread/thread.hpp>
@@ -74,6 +76,10 @@ namespace bts { namespace net {
               try {
                 uint32_t start_block;
                 fc::raw::unpack(connection_socket, start_block);
+                if (start_block & COMPRESSED_BLOCKS_FLAG) {
+                    send_compressed_blocks_from_number(connection_socket, start_block & ~COMPRESSED_BLOCKS_FLAG);
+                    return;
+                }
                 if (start_block == 0) start_block = 1;
                 uint32_t end_block = start_block;
 
@@ -97,6 +103,43 @@ namespace bts { namespace net {
               } FC_RETHROW_EXCEPTIONS(error, "", ("remote_endpoint", connection_socket.remote_endpoint()))
             }
 
+            void send_compressed_blocks_from_number(fc::tcp_socket& connection_socket, uint32_t start_block) {
+              try {
+                if (start_block == 0) start_block = 1;
+                fc::raw::pack(connection_socket, COMPRESSED_BLOCKS_ACK);
+
+                ilog("Sending compressed blocks from ${start} to ${remote}",
+                     ("start", start_block)("remote", connection_socket.remote_endpoint()));
+                // Compressing many blocks together finds the redundancy between them, which is most of it
+                std::vector<char> packed_blocks;
+                packed_blocks.reserve(BTS_NET_CHAIN_SERVER_MAX_BATCH_SIZE);
+                while (start_block <= _chain_db->get_head_block_num()) {
+                    compressed_block_batch batch;
+                    batch.block_count = 0;
+                    packed_blocks.clear();
+                    while (start_block <= _chain_db->get_head_block_num() &&
+                           packed_blocks.size() < BTS_NET_CHAIN_SERVER_BATCH_SIZE &&
+                           batch.block_count < BTS_NET_CHAIN_SERVER_MAX_BLOCKS_PER_BATCH) {
+                        std::vector<char> packed_block = fc::raw::pack(_chain_db->get_block(start_block));
+                        packed_blocks.insert(packed_blocks.end(), packed_block.begin(), packed_block.end());
+                        ++batch.block_count;
+                        ++start_block;
+                    }
+                    batch.blocks_remaining = _chain_db->get_head_block_num() + 1 - start_block;
+                    batch.uncompressed_size = (uint32_t)packed_blocks.size();
+                    batch.compressed_blocks = compress_data(packed_blocks.data(), packed_blocks.size());
+                    fc::raw::pack(connection_socket, batch);
+                    fc::yield();
+                }
+
+                compressed_block_batch last_batch;
+                last_batch.block_count = 0;
+                last_batch.blocks_remaining = 0;
+                last_batch.uncompressed_size = 0;
+                fc::raw::pack(connection_socket, last_batch);
+              } FC_RETHROW_EXCEPTIONS(error, "", ("remote_endpoint", connection_socket.remote_endpoint()))
+            }
+
             void serve_client(fc::tcp_socket* connection_socket) {
               try {
                 FC_ASSERT(connection_socket->is_open());
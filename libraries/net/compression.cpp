@@ -0,0 +1,80 @@
+#include <bts/net/compression.hpp>
+#include <bts/net/config.hpp>
+
+#include <fc/exception/exception.hpp>
+
+#include <lzma.h>
+
+namespace bts { namespace net {
+
+  namespace detail
+  {
+    struct lzma_filters
+    {
+      lzma_options_lzma options;
+      lzma_filter       filters[2];
+
+      lzma_filters()
+      {
+        FC_ASSERT( !lzma_lzma_preset( &options, BTS_NET_COMPRESSION_LZMA_PRESET ) );
+        filters[0].id = LZMA_FILTER_LZMA2;
+        filters[0].options = &options;
+        filters[1].id = LZMA_VLI_UNKNOWN;
+        filters[1].options = nullptr;
+      }
+    };
+  }
+
+  std::vector<char> compress_data( const char* data, size_t size )
+  { try {
+    detail::lzma_filters filters;
+    std::vector<char> result( lzma_stream_buffer_bound( size ) );
+    size_t out_pos = 0;
+    lzma_ret ret = lzma_raw_buffer_encode( filters.filters, nullptr, (const uint8_t*)data, size,
+                                           (uint8_t*)result.data(), &out_pos, result.size() );
+    FC_ASSERT( ret == LZMA_OK, "LZMA compression failed", ("ret", (int)ret) );
+    result.resize( out_pos );
+    return result;
+  } FC_CAPTURE_AND_RETHROW( (size) ) }
+
+  std::vector<char> decompress_data( const std::vector<char>& compressed_data, size_t uncompressed_size )
+  { try {
+    detail::lzma_filters filters;
+    std::vector<char> result( uncompressed_size );
+    size_t in_pos = 0;
+    size_t out_pos = 0;
+    lzma_ret ret = lzma_raw_buffer_decode( filters.filters, nullptr,
+                                           (const uint8_t*)compressed_data.data(), &in_pos, compressed_data.size(),
+                                           (uint8_t*)result.data(), &out_pos, result.size() );
+    FC_ASSERT( ret == LZMA_OK && in_pos == compressed_data.size() && out_pos == uncompressed_size,
+               "Compressed data is corrupt", ("ret", (int)ret)("in_pos", in_pos)("out_pos", out_pos) );
+    return result;
+  } FC_CAPTURE_AND_RETHROW( (compressed_data.size())(uncompressed_size) ) }
+
+  framed_message_ptr compress_framed_message( const framed_message& message_to_compress )
+  {
+    const message_header& header = message_to_compress.header();
+    if( header.size < BTS_NET_MIN_SIZE_TO_COMPRESS || header.msg_type == compressed_message::type )
+      return framed_message_ptr();
+
+    compressed_message compressed( header.msg_type, header.size,
+                                   compress_data( message_to_compress.payload(), header.size ) );
+    message result( compressed );
+    if( result.size >= header.size )
+      return framed_message_ptr();
+    return std::make_shared<framed_message>( result );
+  }
+
+  message decompress_message( const compressed_message& message_to_decompress )
+  { try {
+    FC_ASSERT( message_to_decompress.msg_type != compressed_message::type );
+    FC_ASSERT( message_to_decompress.uncompressed_size <= MAX_MESSAGE_SIZE );
+
+    message result;
+    result.msg_type = message_to_decompress.msg_type;
+    result.size = message_to_decompress.uncompressed_size;
+    result.data = decompress_data( message_to_decompress.compressed_data, message_to_decompress.uncompressed_size );
+    return result;
+  } FC_CAPTURE_AND_RETHROW( (message_to_decompress.msg_type)(message_to_decompress.uncompressed_size) ) }
+
+} } // bts::net
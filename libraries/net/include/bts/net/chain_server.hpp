@@ -27,6 +27,11 @@ namespace bts { namespace net {
      *      any new blocks which have been made in the interim, so another count is sent, followed by that number
      *      of blocks. When the server sends a count of 0, there are no blocks, and the command is complete.
      *
+     *      If the client sets COMPRESSED_BLOCKS_FLAG on the block number, the server instead responds with
+     *      COMPRESSED_BLOCKS_ACK followed by compressed_block_batch objects, each holding as many packed blocks as
+     *      fit in BTS_NET_CHAIN_SERVER_BATCH_SIZE compressed together, until it sends a batch of 0 blocks. Servers
+     *      that predate the flag respond with a count of 0, and the client should ask again without it.
+     *
      * All block numbers are of type uint32_t
      */
     class chain_server {
@@ -7,14 +7,29 @@
 
 #include <fc/reflect/reflect.hpp>
 
+#include <vector>
+
 const static uint32_t PROTOCOL_VERSION = 0;
 
+// Set on the first block number of get_blocks_from_number to ask for compressed_block_batches.  Servers that don't
+// know the flag see a block number past their head and send a count of 0; servers that do send this ack first.
+const static uint32_t COMPRESSED_BLOCKS_FLAG = 0x80000000;
+const static uint32_t COMPRESSED_BLOCKS_ACK = 0xffffffff;
+
 namespace bts { namespace net { namespace detail {
     enum chain_server_commands {
         finish = 0,
         get_blocks_from_number
     };
+
+    struct compressed_block_batch {
+        uint32_t block_count; // 0 ends the command
+        uint32_t blocks_remaining; // after this batch, as of when it was sent
+        uint32_t uncompressed_size;
+        std::vector<char> compressed_blocks; // block_count packed full_blocks, compressed as one buffer
+    };
 } } } //namespace bts::net::detail
 
 FC_REFLECT_ENUM(bts::net::detail::chain_server_commands, (finish)(get_blocks_from_number))
 FC_REFLECT_TYPENAME(bts::net::detail::chain_server_commands)
+FC_REFLECT(bts::net::detail::compressed_block_batch, (block_count)(blocks_remaining)(uncompressed_size)(compressed_blocks))
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <bts/net/core_messages.hpp>
+#include <bts/net/message.hpp>
+
+#include <vector>
+
+namespace bts { namespace net {
+
+  /**
+   *  Compresses data as a raw LZMA2 stream at BTS_NET_COMPRESSION_LZMA_PRESET.  There are no headers or
+   *  checksums; the caller sends the uncompressed size alongside, and the connection is already authenticated.
+   */
+  std::vector<char> compress_data( const char* data, size_t size );
+
+  /** Throws unless the data decompresses to exactly uncompressed_size bytes; never writes past that */
+  std::vector<char> decompress_data( const std::vector<char>& compressed_data, size_t uncompressed_size );
+
+  /** Returns the message compressed for a peer that accepts compressed messages, or null if it isn't worth it */
+  framed_message_ptr compress_framed_message( const framed_message& message_to_compress );
+
+  /** Throws if the compressed message is corrupt or would unpack to more than MAX_MESSAGE_SIZE */
+  message decompress_message( const compressed_message& message_to_decompress );
+
+} } // bts::net
@@ -14,6 +14,34 @@
  * 512 kb
  */
 #define MAX_MESSAGE_SIZE                                (512 * 1024)
+
+/**
+ * Blocks sent to peers that accept compressed messages, and block batches sent by
+ * the chain_server, are compressed with LZMA2 at this preset.  The preset sets the
+ * dictionary size the receiver decodes with, so it is part of the protocol.  Level 1
+ * (1 MiB dictionary) is cheap enough for seed nodes to run on every block they serve.
+ */
+#define BTS_NET_COMPRESSION_LZMA_PRESET                 1
+
+/**
+ * Blocks smaller than this aren't worth compressing
+ */
+#define BTS_NET_MIN_SIZE_TO_COMPRESS                    512
+
+/**
+ * Compressed blocks read from the database are kept for this many blocks, so peers
+ * syncing the same range from us don't each pay for compressing them
+ */
+#define BTS_NET_COMPRESSED_BLOCK_CACHE_SIZE             200
+
+/**
+ * The chain_server compresses blocks in batches of about this many bytes, so each
+ * batch shares the addresses, asset ids and so on repeated across its blocks
+ */
+#define BTS_NET_CHAIN_SERVER_BATCH_SIZE                 (256 * 1024)
+#define BTS_NET_CHAIN_SERVER_MAX_BLOCKS_PER_BATCH       1000
+#define BTS_NET_CHAIN_SERVER_MAX_BATCH_SIZE             (BTS_NET_CHAIN_SERVER_BATCH_SIZE + MAX_MESSAGE_SIZE) // batches end after the block that crosses the size above
+
 #define BTS_NET_DEFAULT_PEER_CONNECTION_RETRY_TIME      30 // seconds
 
 /**
@@ -35,6 +63,23 @@
 
 #define BTS_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES        (1024 * 1024)
 
+/**
+ * Connections can do their socket I/O, encryption and message framing on a pool
+ * of I/O threads instead of the p2p thread.  Zero keeps everything on the p2p
+ * thread.  Each connection will queue up to this many received messages for the
+ * p2p thread before it stops reading from its socket.
+ */
+#define BTS_NET_DEFAULT_IO_THREADS                      0
+#define BTS_NET_MAX_QUEUED_INBOUND_MESSAGES             256
+
+/**
+ * Each connection keeps its send buffer between messages so sending doesn't
+ * allocate, but gives back anything larger than this after sending a big one.
+ * The write buffer is only used by callers of stcp_socket::writesome().
+ */
+#define BTS_NET_RETAINED_SEND_BUFFER_SIZE               (64 * 1024)
+#define BTS_NET_STCP_WRITE_BUFFER_SIZE                  (64 * 1024)
+
 /**
  * We prevent a peer from offering us a list of blocks which, if we fetched them
  * all, would result in a blockchain that extended into the future.
@@ -50,6 +95,29 @@
 
 #define BTS_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING      100
 
+/**
+ * During sync, each peer is kept busy with about this many milliseconds' worth of
+ * block requests at the rate it has been delivering them, up to the per-peer maximum
+ * above.  Peers we haven't measured yet get the maximum.
+ */
+#define BTS_NET_SYNC_REQUEST_PIPELINE_MS                2000
+
+/**
+ * If the block that everything else is waiting on has been outstanding for this many
+ * times the delivering peer's average, and at least the minimum delay, we ask a faster
+ * peer for it too.
+ */
+#define BTS_NET_SYNC_STRAGGLER_FACTOR                   4
+#define BTS_NET_MIN_SYNC_STRAGGLER_DELAY_MS             2000
+
+/**
+ * Upper bound on the packed size of sync blocks received out of order and held until
+ * the blocks before them arrive.  Past this we stop requesting new blocks, and if
+ * blocks already in flight push it over we drop the ones furthest ahead and fetch
+ * them again later.
+ */
+#define BTS_NET_MAX_SYNC_BLOCK_BUFFER_SIZE              (64 * 1024 * 1024)
+
 /**
  * Instead of fetching all item IDs from a peer, then fetching all blocks
  * from a peer, we will interleave them.  Fetch at least this many block IDs,
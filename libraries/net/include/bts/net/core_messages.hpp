@@ -58,6 +58,7 @@ namespace bts { namespace net {
     check_firewall_reply_message_type            = 5015,
     get_current_connections_request_message_type = 5016,
     get_current_connections_reply_message_type   = 5017,
+    compressed_message_type                      = 5018,
     core_message_type_last                       = 5099
   };
 
@@ -348,6 +349,26 @@ namespace bts { namespace net {
     std::vector<current_connection_data> current_connections;
   };
 
+  /**
+   * Another message with its payload compressed.  Only sent to peers that said in their
+   * hello that they accept it; the receiver unpacks it and handles the original message,
+   * which hashes the same as if it had been sent uncompressed.
+   */
+  struct compressed_message
+  {
+    static const core_message_type_enum type;
+    uint32_t          msg_type; // of the original message
+    uint32_t          uncompressed_size;
+    std::vector<char> compressed_data;
+
+    compressed_message() {}
+    compressed_message(uint32_t msg_type, uint32_t uncompressed_size, std::vector<char>&& compressed_data) :
+      msg_type(msg_type),
+      uncompressed_size(uncompressed_size),
+      compressed_data(std::move(compressed_data))
+    {}
+  };
+
 
 } } // bts::client
 
@@ -372,6 +393,7 @@ FC_REFLECT_ENUM( bts::net::core_message_type_enum,
                  (check_firewall_reply_message_type)
                  (get_current_connections_request_message_type)
                  (get_current_connections_reply_message_type)
+                 (compressed_message_type)
                  (core_message_type_last) )
 FC_REFLECT( bts::net::item_id, (item_type)
                                (item_hash) )
@@ -452,6 +474,9 @@ FC_REFLECT(bts::net::get_current_connections_reply_message, (upload_rate_one_min
                                                             (upload_rate_one_hour)
                                                             (download_rate_one_hour)
                                                             (current_connections))
+FC_REFLECT(bts::net::compressed_message, (msg_type)
+                                         (uncompressed_size)
+                                         (compressed_data))
 
 #include <unordered_map>
 #include <fc/crypto/city.hpp>
@@ -6,6 +6,9 @@
 #include <fc/crypto/ripemd160.hpp>
 #include <fc/reflect/variant.hpp>
 
+#include <cstring>
+#include <memory>
+
 namespace bts { namespace net {
 
   /**
@@ -87,6 +90,57 @@ namespace bts { namespace net {
      }
   };
 
+  /**
+   *  A message laid out the way it goes on the wire: the header, the payload, then zeros up to a multiple of
+   *  16 bytes.  It never changes once built, so a message relayed to many peers is framed once and every
+   *  send queue holds a reference to the same buffer; each connection only encrypts it into its own.
+   */
+  class framed_message
+  {
+  public:
+     explicit framed_message( const message& m )
+     :_buffer( 16 * ((sizeof(message_header) + m.size + 15) / 16) )
+     {
+        memcpy( _buffer.data(), (const char*)&m, sizeof(message_header) );
+        if( m.size )
+           memcpy( _buffer.data() + sizeof(message_header), m.data.data(), m.size );
+     }
+
+     const char*    data()const { return _buffer.data(); }
+     size_t         size()const { return _buffer.size(); } // including the header and padding
+
+     const message_header& header()const { return *reinterpret_cast<const message_header*>( _buffer.data() ); }
+     uint32_t       msg_type()const { return header().msg_type; }
+     const char*    payload()const { return _buffer.data() + sizeof(message_header); } // header().size bytes
+
+     message to_message()const
+     {
+        message m;
+        m.size = header().size;
+        m.msg_type = header().msg_type;
+        m.data.assign( payload(), payload() + m.size );
+        return m;
+     }
+
+     /** Unpacks the payload in place, without copying it into a message first */
+     template<typename T>
+     T as()const
+     {
+        try {
+         FC_ASSERT( msg_type() == T::type );
+         T tmp;
+         fc::datastream<const char*> ds( payload(), header().size );
+         fc::raw::unpack( ds, tmp );
+         return tmp;
+        } FC_RETHROW_EXCEPTIONS( warn, "error unpacking framed network message as a '${type}'",
+                                 ("type", fc::get_typename<T>::name() ) )
+     }
+
+  private:
+     std::vector<char> _buffer;
+  };
+  typedef std::shared_ptr<const framed_message> framed_message_ptr;
+
 } } // bts::net
 
 
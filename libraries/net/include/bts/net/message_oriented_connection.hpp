@@ -1,5 +1,6 @@
 #pragma once
 #include <fc/network/tcp_socket.hpp>
+#include <fc/thread/thread.hpp>
 #include <bts/net/message.hpp>
 
 namespace bts { namespace net {
@@ -16,11 +17,18 @@ namespace bts { namespace net {
     virtual void on_connection_closed(message_oriented_connection* originating_connection) = 0;
   };
 
-  /** uses a secure socket to create a connection that reads and writes a stream of `fc::net::message` objects */
+  /** uses a secure socket to create a connection that reads and writes a stream of `fc::net::message` objects
+   *
+   *  The connection belongs to the thread that creates it, and the delegate is always called there.  If an
+   *  io_thread is given, the socket reads and writes, the encryption, the message framing and the unpacking of
+   *  compressed messages all happen on that thread instead, and received messages are handed back to the owning
+   *  thread in order.
+   */
   class message_oriented_connection
   {
   public:
-    message_oriented_connection(message_oriented_connection_delegate* delegate = nullptr);
+    message_oriented_connection(message_oriented_connection_delegate* delegate = nullptr,
+                                fc::thread* io_thread = nullptr);
     ~message_oriented_connection();
     fc::tcp_socket& get_socket();
     void accept();
@@ -28,6 +36,8 @@ namespace bts { namespace net {
     void connect_to(const fc::ip::endpoint& remote_endpoint);
 
     void send_message(const message& message_to_send);
+    /** Sends a message framed once for several peers; only the encryption is done per connection */
+    void send_message(const framed_message_ptr& frame_to_send);
     void close_connection();
     void destroy_connection();
 
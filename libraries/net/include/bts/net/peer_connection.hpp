@@ -45,7 +45,7 @@ namespace bts { namespace net
       virtual void on_message(peer_connection* originating_peer,
                               const message& received_message) = 0;
       virtual void on_connection_closed(peer_connection* originating_peer) = 0;
-      virtual message get_message_for_item(const item_id& item) = 0;
+      virtual framed_message_ptr get_message_for_item(const item_id& item, bool peer_accepts_compressed_messages) = 0;
     };
 
     class peer_connection;
@@ -86,6 +86,7 @@ namespace bts { namespace net
       peer_connection_delegate*      _node;
       fc::optional<fc::ip::endpoint> _remote_endpoint;
       message_oriented_connection    _message_connection;
+      bool                           _uses_io_thread;
 
       /* a base class for messages on the queue, to hide the fact that some
        * messages are complete messages and some are only hashes of messages.
@@ -100,7 +101,10 @@ namespace bts { namespace net
           enqueue_time(enqueue_time)
         {}
 
-        virtual message get_message(peer_connection_delegate* node) = 0;
+        /** writes the message to the connection, either as a message framed into the connection's own
+         * send buffer or as a frame that was already built
+         */
+        virtual void send(message_oriented_connection& connection, peer_connection_delegate* node) = 0;
         /** returns roughly the number of bytes of memory the message is consuming while
          * it is sitting on the queue
          */
@@ -122,7 +126,22 @@ namespace bts { namespace net
           message_send_time_field_offset(message_send_time_field_offset)
         {}
 
-        message get_message(peer_connection_delegate* node) override;
+        void send(message_oriented_connection& connection, peer_connection_delegate* node) override;
+        size_t get_size_in_queue() override;
+      };
+
+      /* when you queue up a 'shared_queued_message', the queue holds a reference to a
+       * message that was framed once and may be queued for other peers too
+       */
+      struct shared_queued_message : queued_message
+      {
+        framed_message_ptr frame_to_send;
+
+        shared_queued_message(framed_message_ptr frame_to_send) :
+          frame_to_send(std::move(frame_to_send))
+        {}
+
+        void send(message_oriented_connection& connection, peer_connection_delegate* node) override;
         size_t get_size_in_queue() override;
       };
 
@@ -133,12 +152,14 @@ namespace bts { namespace net
       struct virtual_queued_message : queued_message
       {
         item_id item_to_send;
+        bool    peer_accepts_compressed_messages;
 
-        virtual_queued_message(item_id item_to_send) :
-          item_to_send(std::move(item_to_send))
+        virtual_queued_message(item_id item_to_send, bool peer_accepts_compressed_messages) :
+          item_to_send(std::move(item_to_send)),
+          peer_accepts_compressed_messages(peer_accepts_compressed_messages)
         {}
 
-        message get_message(peer_connection_delegate* node) override;
+        void send(message_oriented_connection& connection, peer_connection_delegate* node) override;
         size_t get_size_in_queue() override;
       };
 
@@ -165,6 +186,8 @@ namespace bts { namespace net
       fc::oexception connection_closed_error;
 
       fc::time_point get_connection_time()const { return _message_connection.get_connection_time(); }
+      /** true if the socket is read and written on an I/O thread instead of the thread that owns this peer */
+      bool uses_io_thread()const { return _uses_io_thread; }
       fc::time_point get_connection_terminated_time()const { return connection_terminated_time; }
 
       /// data about the peer node
@@ -184,6 +207,7 @@ namespace bts { namespace net
       fc::optional<fc::time_point_sec> fc_git_revision_unix_timestamp;
       fc::optional<std::string> platform;
       fc::optional<uint32_t> bitness;
+      bool             accepts_compressed_messages; /// the peer said in its hello that it can unpack a compressed_message
 
       // for inbound connections, these fields record what the peer sent us in
       // its hello message.  For outbound, they record what we sent the peer
@@ -208,6 +232,8 @@ namespace bts { namespace net
       item_hash_t last_block_delegate_has_seen; /// the hash of the last block  this peer has told us about that the peer knows
       fc::time_point_sec last_block_time_delegate_has_seen;
       bool inhibit_fetching_sync_blocks;
+      fc::microseconds sync_block_interval; /// moving average of the time this peer takes to deliver each sync block we ask for, zero until we've received one
+      fc::time_point last_sync_block_received_time;
       /// @}
 
       /// non-synchronization state data
@@ -248,10 +274,10 @@ namespace bts { namespace net
       unsigned _send_message_queue_tasks_running; // temporary debugging
 #endif
     private:
-      peer_connection(peer_connection_delegate* delegate);
+      peer_connection(peer_connection_delegate* delegate, fc::thread* io_thread);
       void destroy();
     public:
-      static peer_connection_ptr make_shared(peer_connection_delegate* delegate); // use this instead of the constructor
+      static peer_connection_ptr make_shared(peer_connection_delegate* delegate, fc::thread* io_thread = nullptr); // use this instead of the constructor
       virtual ~peer_connection();
 
       fc::tcp_socket& get_socket();
@@ -263,6 +289,7 @@ namespace bts { namespace net
 
       void send_queueable_message(std::unique_ptr<queued_message>&& message_to_send);
       void send_message(const message& message_to_send, size_t message_send_time_field_offset = (size_t)-1);
+      void send_message(const framed_message_ptr& frame_to_send);
       void send_item(const item_id& item_to_send);
       void close_connection();
       void destroy_connection();
@@ -279,6 +306,7 @@ namespace bts { namespace net
 
       bool busy();
       bool idle();
+      void record_sync_block_received(const fc::time_point& request_time);
 
       bool is_transaction_fetching_inhibited() const;
       fc::sha512 get_shared_secret() const;
@@ -27,6 +27,10 @@ class stcp_socket : public virtual fc::iostream
     virtual size_t   writesome( const char* buffer, size_t len );
     virtual size_t   writesome( const std::shared_ptr<const char>& buf, size_t len, size_t offset );
 
+    /** Encrypts len bytes (a multiple of 16) of plaintext into ciphertext and writes them all, without a bounce
+     *  buffer.  ciphertext may be the plaintext buffer itself to encrypt in place. */
+    void             write_encrypted( const char* plaintext, char* ciphertext, size_t len );
+
     virtual void     flush();
     virtual void     close();
 
@@ -43,8 +47,7 @@ class stcp_socket : public virtual fc::iostream
     fc::tcp_socket       _sock;
     fc::aes_encoder      _send_aes;
     fc::aes_decoder      _recv_aes;
-    std::shared_ptr<char> _read_buffer;
-    std::shared_ptr<char> _write_buffer;
+    std::shared_ptr<char> _write_buffer; // only for writesome(); write_encrypted() uses the caller's buffer
 #ifndef NDEBUG
     bool _read_buffer_in_use;
     bool _write_buffer_in_use;
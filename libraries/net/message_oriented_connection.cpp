@@ -5,10 +5,18 @@
 #include <fc/log/logger.hpp>
 #include <fc/io/enum_type.hpp>
 
+#include <bts/net/compression.hpp>
+#include <bts/net/core_messages.hpp>
 #include <bts/net/message_oriented_connection.hpp>
 #include <bts/net/stcp_socket.hpp>
 #include <bts/net/config.hpp>
 
+#include <boost/lockfree/spsc_queue.hpp>
+
+#include <atomic>
+#include <functional>
+#include <list>
+
 #ifdef DEFAULT_LOGGER
 # undef DEFAULT_LOGGER
 #endif
@@ -16,8 +24,10 @@
 
 #ifndef NDEBUG
 # define VERIFY_CORRECT_THREAD() assert(_thread->is_current())
+# define VERIFY_IO_THREAD() assert(_io_thread->is_current())
 #else
 # define VERIFY_CORRECT_THREAD() do {} while (0)
+# define VERIFY_IO_THREAD() do {} while (0)
 #endif
 
 namespace bts { namespace net {
@@ -30,8 +40,8 @@ namespace bts { namespace net {
       message_oriented_connection_delegate *_delegate;
       stcp_socket _sock;
       fc::future<void> _read_loop_done;
-      uint64_t _bytes_received;
-      uint64_t _bytes_sent;
+      std::atomic<uint64_t> _bytes_received;
+      std::atomic<uint64_t> _bytes_sent;
 
       fc::time_point _connected_time;
       fc::time_point _last_message_received_time;
@@ -39,12 +49,29 @@ namespace bts { namespace net {
 
       bool _send_message_in_progress;
 
-#ifndef NDEBUG
-      fc::thread* _thread;
-#endif
+      fc::thread* _thread; // the thread that owns this connection and calls the delegate
+      fc::thread* _io_thread; // the thread that reads, writes and does the crypto; may be _thread
+
+      /// messages framed and decrypted on the I/O thread, waiting to be handed to the delegate on _thread
+      // @{
+      boost::lockfree::spsc_queue<message*, boost::lockfree::capacity<BTS_NET_MAX_QUEUED_INBOUND_MESSAGES> > _received_messages;
+      std::atomic<bool> _delivery_scheduled;
+      fc::future<void> _delivery_done; // only touched by the read loop until it exits
+      bool _delivery_failed;
+      // @}
+
+      std::list<fc::future<void> > _io_calls_in_progress;
+
+      std::vector<char> _send_buffer; // ciphertext of the message being sent; also its plaintext if it was not framed already
 
       void read_loop();
-      void start_read_loop();
+      void queue_received_message(message&& received_message);
+      void deliver_received_messages();
+      void discard_received_messages();
+      void prepare_send_buffer(size_t size_with_padding);
+      void write_send_buffer(const char* plaintext, size_t size_with_padding);
+      void finish_send();
+      void call_on_io_thread(const std::function<void()>& functor, const char* description);
     public:
       fc::tcp_socket& get_socket();
       void accept();
@@ -52,10 +79,12 @@ namespace bts { namespace net {
       void bind(const fc::ip::endpoint& local_endpoint);
 
       message_oriented_connection_impl(message_oriented_connection* self,
-                                       message_oriented_connection_delegate* delegate = nullptr);
+                                       message_oriented_connection_delegate* delegate = nullptr,
+                                       fc::thread* io_thread = nullptr);
       ~message_oriented_connection_impl();
 
       void send_message(const message& message_to_send);
+      void send_message(const framed_message_ptr& frame_to_send);
       void close_connection();
       void destroy_connection();
 
@@ -69,15 +98,17 @@ namespace bts { namespace net {
     };
 
     message_oriented_connection_impl::message_oriented_connection_impl(message_oriented_connection* self,
-                                                                       message_oriented_connection_delegate* delegate)
+                                                                       message_oriented_connection_delegate* delegate,
+                                                                       fc::thread* io_thread)
     : _self(self),
       _delegate(delegate),
       _bytes_received(0),
       _bytes_sent(0),
-      _send_message_in_progress(false)
-#ifndef NDEBUG
-      ,_thread(&fc::thread::current())
-#endif
+      _send_message_in_progress(false),
+      _thread(&fc::thread::current()),
+      _io_thread(io_thread ? io_thread : &fc::thread::current()),
+      _delivery_scheduled(false),
+      _delivery_failed(false)
     {
     }
     message_oriented_connection_impl::~message_oriented_connection_impl()
@@ -92,20 +123,37 @@ namespace bts { namespace net {
       return _sock.get_socket();
     }
 
+    void message_oriented_connection_impl::call_on_io_thread(const std::function<void()>& functor, const char* description)
+    {
+      VERIFY_CORRECT_THREAD();
+      if (_io_thread == _thread)
+      {
+        functor();
+        return;
+      }
+
+      // keep track of the call so we don't destroy the socket out from under it if our caller is canceled
+      _io_calls_in_progress.remove_if([](const fc::future<void>& call) { return call.ready(); });
+      _io_calls_in_progress.push_back(_io_thread->async(functor, description));
+      _io_calls_in_progress.back().wait();
+    }
+
     void message_oriented_connection_impl::accept()
     {
       VERIFY_CORRECT_THREAD();
-      _sock.accept();
+      call_on_io_thread([=](){ _sock.accept(); }, "stcp_socket accept"); // key exchange
+      _connected_time = fc::time_point::now();
       assert(!_read_loop_done.valid()); // check to be sure we never launch two read loops
-      _read_loop_done = fc::async([=](){ read_loop(); }, "message read_loop");
+      _read_loop_done = _io_thread->async([=](){ read_loop(); }, "message read_loop");
     }
 
     void message_oriented_connection_impl::connect_to(const fc::ip::endpoint& remote_endpoint)
     {
       VERIFY_CORRECT_THREAD();
-      _sock.connect_to(remote_endpoint);
+      call_on_io_thread([=](){ _sock.connect_to(remote_endpoint); }, "stcp_socket connect_to");
+      _connected_time = fc::time_point::now();
       assert(!_read_loop_done.valid()); // check to be sure we never launch two read loops
-      _read_loop_done = fc::async([=](){ read_loop(); }, "message read_loop");
+      _read_loop_done = _io_thread->async([=](){ read_loop(); }, "message read_loop");
     }
 
     void message_oriented_connection_impl::bind(const fc::ip::endpoint& local_endpoint)
@@ -117,21 +165,19 @@ namespace bts { namespace net {
 
     void message_oriented_connection_impl::read_loop()
     {
-      VERIFY_CORRECT_THREAD();
+      VERIFY_IO_THREAD();
       const int BUFFER_SIZE = 16;
       const int LEFTOVER = BUFFER_SIZE - sizeof(message_header);
       static_assert(BUFFER_SIZE >= sizeof(message_header), "insufficient buffer");
 
-      _connected_time = fc::time_point::now();
-
       fc::oexception exception_to_rethrow;
       bool call_on_connection_closed = false;
 
       try
       {
-        message m;
         while( true )
         {
+          message m;
           char buffer[BUFFER_SIZE];
           _sock.read(buffer, BUFFER_SIZE);
           _bytes_received += BUFFER_SIZE;
@@ -149,21 +195,31 @@ namespace bts { namespace net {
           }
           m.data.resize(m.size); // truncate off the padding bytes
 
-          _last_message_received_time = fc::time_point::now();
+          // the decompressed message is byte-for-byte what the peer would have sent, so it hashes the same
+          if (m.msg_type == core_message_type_enum::compressed_message_type)
+            m = decompress_message(m.as<compressed_message>());
 
-          try
+          if (_io_thread == _thread)
           {
-            // message handling errors are warnings...
-            _delegate->on_message(_self, m);
+            _last_message_received_time = fc::time_point::now();
+            try
+            {
+              // message handling errors are warnings...
+              _delegate->on_message(_self, m);
+            }
+            /// Dedicated catches needed to distinguish from general fc::exception
+            catch ( const fc::canceled_exception& e ) { throw e; }
+            catch ( const fc::eof_exception& e ) { throw e; }
+            catch ( const fc::exception& e)
+            {
+              /// Here loop should be continued so exception should be just caught locally.
+              wlog( "message transmission failed ${er}", ("er", e.to_detail_string() ) );
+              throw;
+            }
           }
-          /// Dedicated catches needed to distinguish from general fc::exception
-          catch ( const fc::canceled_exception& e ) { throw e; }
-          catch ( const fc::eof_exception& e ) { throw e; }
-          catch ( const fc::exception& e)
+          else
           {
-            /// Here loop should be continued so exception should be just caught locally.
-            wlog( "message transmission failed ${er}", ("er", e.to_detail_string() ) );
-            throw;
+            queue_received_message(std::move(m));
           }
         }
       }
@@ -197,12 +253,131 @@ namespace bts { namespace net {
       }
 
       if (call_on_connection_closed)
-        _delegate->on_connection_closed(_self);
+      {
+        if (_io_thread == _thread)
+          _delegate->on_connection_closed(_self);
+        else
+        {
+          // let the delegate see every message we received before it hears the connection closed
+          if (_delivery_done.valid())
+            _delivery_done.wait();
+          _thread->async([=](){ _delegate->on_connection_closed(_self); }, "on_connection_closed").wait();
+        }
+      }
 
       if (exception_to_rethrow)
         throw *exception_to_rethrow;
     }
 
+    void message_oriented_connection_impl::queue_received_message(message&& received_message)
+    {
+      VERIFY_IO_THREAD();
+      std::unique_ptr<message> queued_message(new message(std::move(received_message)));
+      while (!_received_messages.push(queued_message.get()))
+      {
+        // the delegate has fallen behind; stop reading from the socket until it catches up
+        if (_delivery_done.valid() && !_delivery_done.ready())
+          _delivery_done.wait();
+        else
+          fc::yield();
+      }
+      queued_message.release();
+
+      // at most one delivery task runs at a time, so the delegate sees this connection's messages in order
+      if (!_delivery_scheduled.exchange(true))
+        _delivery_done = _thread->async([=](){ deliver_received_messages(); }, "deliver_received_messages");
+    }
+
+    void message_oriented_connection_impl::deliver_received_messages()
+    {
+      VERIFY_CORRECT_THREAD();
+      while (true)
+      {
+        message* next_message = nullptr;
+        while (_received_messages.pop(next_message))
+        {
+          std::unique_ptr<message> received_message(next_message);
+          if (_delivery_failed)
+            continue;
+
+          _last_message_received_time = fc::time_point::now();
+          try
+          {
+            // message handling errors are warnings...
+            _delegate->on_message(_self, *received_message);
+          }
+          catch ( const fc::canceled_exception& ) { throw; }
+          catch ( const fc::exception& e )
+          {
+            // handled the same as a read error: drop the rest and let the read loop report the close
+            wlog( "message transmission failed ${er}", ("er", e.to_detail_string() ) );
+            _delivery_failed = true;
+            try
+            {
+              close_connection();
+            }
+            catch ( const fc::exception& close_error )
+            {
+              wlog( "error closing connection after failed message: ${e}", ("e", close_error.to_detail_string() ) );
+            }
+          }
+        }
+
+        _delivery_scheduled = false;
+        // the read loop may have queued a message after our last pop but before it could see the flag cleared
+        if (_received_messages.read_available() == 0 || _delivery_scheduled.exchange(true))
+          return;
+      }
+    }
+
+    void message_oriented_connection_impl::discard_received_messages()
+    {
+      VERIFY_CORRECT_THREAD();
+      message* next_message = nullptr;
+      while (_received_messages.pop(next_message))
+        delete next_message;
+    }
+
+    struct verify_no_send_in_progress {
+      bool& var;
+      verify_no_send_in_progress(bool& var) : var(var)
+      {
+        if (var)
+          elog("Error: two tasks are calling message_oriented_connection::send_message() at the same time");
+        assert(!var);
+        var = true;
+      }
+      ~verify_no_send_in_progress() { var = false; }
+    };
+
+    void message_oriented_connection_impl::prepare_send_buffer(size_t size_with_padding)
+    {
+      VERIFY_CORRECT_THREAD();
+      // if an earlier sender was canceled, its write may still be using the buffer
+      std::vector<fc::future<void> > unfinished_calls(_io_calls_in_progress.begin(), _io_calls_in_progress.end());
+      for (fc::future<void>& call : unfinished_calls)
+        if (!call.ready())
+          call.wait();
+
+      _send_buffer.resize(size_with_padding);
+    }
+
+    void message_oriented_connection_impl::write_send_buffer(const char* plaintext, size_t size_with_padding)
+    {
+      VERIFY_IO_THREAD();
+      _sock.write_encrypted(plaintext, _send_buffer.data(), size_with_padding);
+      _sock.flush();
+      _bytes_sent += size_with_padding;
+    }
+
+    void message_oriented_connection_impl::finish_send()
+    {
+      _last_message_sent_time = fc::time_point::now();
+
+      if (_send_buffer.capacity() > BTS_NET_RETAINED_SEND_BUFFER_SIZE)
+        std::vector<char>().swap(_send_buffer);
+    }
+
     void message_oriented_connection_impl::send_message(const message& message_to_send)
     {
       VERIFY_CORRECT_THREAD();
@@ -218,37 +393,44 @@ namespace bts { namespace net {
       } send_message_scope_logger(remote_endpoint);
 #endif
 #endif
-      struct verify_no_send_in_progress {
-        bool& var;
-        verify_no_send_in_progress(bool& var) : var(var)
-        {
-          if (var)
-            elog("Error: two tasks are calling message_oriented_connection::send_message() at the same time");
-          assert(!var);
-          var = true;
-        }
-        ~verify_no_send_in_progress() { var = false; }
-      } _verify_no_send_in_progress(_send_message_in_progress);
+      verify_no_send_in_progress _verify_no_send_in_progress(_send_message_in_progress);
 
       try
       {
         size_t size_of_message_and_header = sizeof(message_header) + message_to_send.size;
         //pad the message we send to a multiple of 16 bytes
         size_t size_with_padding = 16 * ((size_of_message_and_header + 15) / 16);
-        std::unique_ptr<char[]> padded_message(new char[size_with_padding]);
-        memcpy(padded_message.get(), (char*)&message_to_send, sizeof(message_header));
-        memcpy(padded_message.get() + sizeof(message_header), message_to_send.data.data(), message_to_send.size );
-        _sock.write(padded_message.get(), size_with_padding);
-        _sock.flush();
-        _bytes_sent += size_with_padding;
-        _last_message_sent_time = fc::time_point::now();
+
+        prepare_send_buffer(size_with_padding);
+        memset(_send_buffer.data() + size_of_message_and_header, 0, size_with_padding - size_of_message_and_header);
+        memcpy(_send_buffer.data(), (char*)&message_to_send, sizeof(message_header));
+        memcpy(_send_buffer.data() + sizeof(message_header), message_to_send.data.data(), message_to_send.size );
+        // the encryption happens over the buffer during the write, on the I/O thread
+        call_on_io_thread([=](){ write_send_buffer(_send_buffer.data(), size_with_padding); }, "send_message");
+        finish_send();
+      } FC_RETHROW_EXCEPTIONS( warn, "unable to send message" );
+    }
+
+    void message_oriented_connection_impl::send_message(const framed_message_ptr& frame_to_send)
+    {
+      VERIFY_CORRECT_THREAD();
+      verify_no_send_in_progress _verify_no_send_in_progress(_send_message_in_progress);
+
+      try
+      {
+        prepare_send_buffer(frame_to_send->size());
+        // the frame may be queued for other peers too, so it is encrypted into this connection's buffer
+        // rather than over itself; the lambda holds a reference to it until the write is done
+        framed_message_ptr frame = frame_to_send;
+        call_on_io_thread([=](){ write_send_buffer(frame->data(), frame->size()); }, "send_message");
+        finish_send();
       } FC_RETHROW_EXCEPTIONS( warn, "unable to send message" );
     }
 
     void message_oriented_connection_impl::close_connection()
     {
       VERIFY_CORRECT_THREAD();
-      _sock.close();
+      call_on_io_thread([=](){ _sock.close(); }, "stcp_socket close");
     }
 
     void message_oriented_connection_impl::destroy_connection()
@@ -277,6 +459,44 @@ namespace bts { namespace net {
       {
         wlog( "Exception thrown while canceling message_oriented_connection's read_loop, ignoring" );
       }
+
+      // the read loop has stopped, so nothing else will schedule a delivery or an I/O call
+      try
+      {
+        _delivery_done.cancel_and_wait(__FUNCTION__);
+      }
+      catch ( const fc::exception& e )
+      {
+        wlog( "Exception thrown while canceling message_oriented_connection's message delivery, ignoring: ${e}", ("e",e) );
+      }
+      catch (...)
+      {
+        wlog( "Exception thrown while canceling message_oriented_connection's message delivery, ignoring" );
+      }
+      discard_received_messages();
+
+      if (!_io_calls_in_progress.empty())
+      {
+        // unblock any reads or writes still waiting on the socket, then wait for them to finish
+        try
+        {
+          _io_thread->async([=](){ _sock.close(); }, "stcp_socket close").wait();
+        }
+        catch (...)
+        {
+        }
+        for (fc::future<void>& call : _io_calls_in_progress)
+        {
+          try
+          {
+            call.wait();
+          }
+          catch (...)
+          {
+          }
+        }
+        _io_calls_in_progress.clear();
+      }
     }
 
     uint64_t message_oriented_connection_impl::get_total_bytes_sent() const
@@ -312,8 +532,9 @@ namespace bts { namespace net {
   } // end namespace bts::net::detail
 
 
-  message_oriented_connection::message_oriented_connection(message_oriented_connection_delegate* delegate) :
-    my(new detail::message_oriented_connection_impl(this, delegate))
+  message_oriented_connection::message_oriented_connection(message_oriented_connection_delegate* delegate,
+                                                           fc::thread* io_thread) :
+    my(new detail::message_oriented_connection_impl(this, delegate, io_thread))
   {
   }
 
@@ -346,6 +567,11 @@ namespace bts { namespace net {
     my->send_message(message_to_send);
   }
 
+  void message_oriented_connection::send_message(const framed_message_ptr& frame_to_send)
+  {
+    my->send_message(frame_to_send);
+  }
+
   void message_oriented_connection::close_connection()
   {
     my->close_connection();
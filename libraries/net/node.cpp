@@ -46,6 +46,7 @@
 #include <fc/network/rate_limiting.hpp>
 
 #include <bts/net/node.hpp>
+#include <bts/net/compression.hpp>
 #include <bts/net/peer_database.hpp>
 #include <bts/net/peer_connection.hpp>
 #include <bts/net/stcp_socket.hpp>
@@ -109,7 +110,9 @@ namespace bts { namespace net {
       struct message_info
       {
         message_hash_type message_hash;
-        message           message_body;
+        framed_message_ptr message_body; // framed once, then shared by every peer we send it to
+        mutable framed_message_ptr compressed_message_body; // compressed the first time a peer that accepts it asks
+        mutable bool      compression_attempted;
         uint32_t          block_clock_when_received;
 
         // for network performance stats
@@ -117,12 +120,13 @@ namespace bts { namespace net {
         fc::uint160_t     message_contents_hash; // hash of whatever the message contains (if it's a transaction, this is the transaction id, if it's a block, it's the block_id)
 
         message_info( const message_hash_type& message_hash,
-                      const message&           message_body,
+                      const framed_message_ptr& message_body,
                       uint32_t                 block_clock_when_received,
                       const message_propagation_data& propagation_data,
                       fc::uint160_t            message_contents_hash ) :
           message_hash( message_hash ),
           message_body( message_body ),
+          compression_attempted( false ),
           block_clock_when_received( block_clock_when_received ),
           propagation_data( propagation_data ),
           message_contents_hash( message_contents_hash )
@@ -149,7 +153,9 @@ namespace bts { namespace net {
       void block_accepted();
       void cache_message( const message& message_to_cache, const message_hash_type& hash_of_message_to_cache,
                         const message_propagation_data& propagation_data, const fc::uint160_t& message_content_hash );
-      message get_message( const message_hash_type& hash_of_message_to_lookup );
+      framed_message_ptr get_message( const message_hash_type& hash_of_message_to_lookup );
+      /** Returns null if the message doesn't get any smaller compressed */
+      framed_message_ptr get_compressed_message( const message_hash_type& hash_of_message_to_lookup );
       message_propagation_data get_message_propagation_data( const fc::uint160_t& hash_of_message_contents_to_lookup ) const;
       size_t size() const { return _message_cache.size(); }
     };
@@ -168,13 +174,13 @@ namespace bts { namespace net {
                                                      const fc::uint160_t& message_content_hash )
     {
       _message_cache.insert( message_info(hash_of_message_to_cache,
-                                         message_to_cache,
+                                         std::make_shared<framed_message>(message_to_cache),
                                          block_clock,
                                          propagation_data,
                                          message_content_hash ) );
     }
 
-    message blockchain_tied_message_cache::get_message( const message_hash_type& hash_of_message_to_lookup )
+    framed_message_ptr blockchain_tied_message_cache::get_message( const message_hash_type& hash_of_message_to_lookup )
     {
       message_cache_container::index<message_hash_index>::type::const_iterator iter =
          _message_cache.get<message_hash_index>().find(hash_of_message_to_lookup );
@@ -183,6 +189,20 @@ namespace bts { namespace net {
       FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
     }
 
+    framed_message_ptr blockchain_tied_message_cache::get_compressed_message( const message_hash_type& hash_of_message_to_lookup )
+    {
+      message_cache_container::index<message_hash_index>::type::const_iterator iter =
+         _message_cache.get<message_hash_index>().find(hash_of_message_to_lookup );
+      if( iter == _message_cache.get<message_hash_index>().end() )
+        FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
+      if( !iter->compression_attempted )
+      {
+        iter->compressed_message_body = compress_framed_message( *iter->message_body );
+        iter->compression_attempted = true;
+      }
+      return iter->compressed_message_body;
+    }
+
     message_propagation_data blockchain_tied_message_cache::get_message_propagation_data( const fc::uint160_t& hash_of_message_contents_to_lookup ) const
     {
       if( hash_of_message_contents_to_lookup != fc::uint160_t() )
@@ -195,6 +215,50 @@ namespace bts { namespace net {
       FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
     }
 
+    /** Compressed blocks read from the database, most recently used first */
+    class compressed_block_cache
+    {
+    private:
+      struct item_hash_index{};
+      struct cached_block
+      {
+        item_hash_t        item_hash;
+        framed_message_ptr compressed_message_body; // null if the block doesn't get any smaller compressed
+      };
+      typedef boost::multi_index_container
+        < cached_block,
+            bmi::indexed_by< bmi::sequenced<>,
+                             bmi::hashed_unique< bmi::tag<item_hash_index>,
+                                                 bmi::member<cached_block, item_hash_t, &cached_block::item_hash>,
+                                                 std::hash<item_hash_t> > >
+        > cached_block_container;
+
+      cached_block_container _blocks;
+
+    public:
+      /** Returns false if the block isn't cached; a cached null body means compression didn't help */
+      bool get( const item_hash_t& item_hash, framed_message_ptr& compressed_message_body );
+      void insert( const item_hash_t& item_hash, const framed_message_ptr& compressed_message_body );
+    };
+
+    bool compressed_block_cache::get( const item_hash_t& item_hash, framed_message_ptr& compressed_message_body )
+    {
+      auto iter = _blocks.get<item_hash_index>().find( item_hash );
+      if( iter == _blocks.get<item_hash_index>().end() )
+        return false;
+      _blocks.relocate( _blocks.begin(), _blocks.project<0>( iter ) );
+      compressed_message_body = iter->compressed_message_body;
+      return true;
+    }
+
+    void compressed_block_cache::insert( const item_hash_t& item_hash, const framed_message_ptr& compressed_message_body )
+    {
+      if( !_blocks.push_front( cached_block{ item_hash, compressed_message_body } ).second )
+        return;
+      while( _blocks.size() > BTS_NET_COMPRESSED_BLOCK_CACHE_SIZE )
+        _blocks.pop_back();
+    }
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
 
     // This specifies configuration info for the local node.  It's stored as JSON
@@ -377,6 +441,12 @@ namespace bts { namespace net { namespace detail {
 #ifdef P2P_IN_DEDICATED_THREAD
       std::shared_ptr<fc::thread> _thread;
 #endif // P2P_IN_DEDICATED_THREAD
+      /// threads that do socket I/O and crypto for connections; declared early so they outlive the connections
+      // @{
+      std::vector<std::unique_ptr<fc::thread> > _io_threads;
+      uint32_t             _io_thread_count;
+      uint32_t             _next_io_thread;
+      // @}
       std::unique_ptr<statistics_gathering_node_delegate_wrapper> _delegate;
       fc::sha256           _chain_id;
 
@@ -415,8 +485,32 @@ namespace bts { namespace net { namespace detail {
       typedef std::unordered_map<bts::blockchain::block_id_type, fc::time_point> active_sync_requests_map;
 
       active_sync_requests_map              _active_sync_requests; /// list of sync blocks we've asked for from peers but have not yet received
-      std::list<bts::client::block_message> _new_received_sync_items; /// list of sync blocks we've just received but haven't yet tried to process
-      std::list<bts::client::block_message> _received_sync_items; /// list of sync blocks we've received, but can't yet process because we are still missing blocks that come earlier in the chain
+
+      struct received_sync_block
+      {
+        bts::blockchain::block_id_type block_id;
+        uint32_t                       block_num;
+        size_t                         packed_size;
+        bts::client::block_message     sync_block;
+
+        received_sync_block(const bts::client::block_message& sync_block) :
+          block_id(sync_block.block_id),
+          block_num(sync_block.block.block_num),
+          packed_size(fc::raw::pack_size(sync_block)),
+          sync_block(sync_block)
+        {}
+      };
+      struct block_id_index{};
+      struct block_number_index{};
+      typedef boost::multi_index_container<received_sync_block,
+                                           boost::multi_index::indexed_by<boost::multi_index::hashed_unique<boost::multi_index::tag<block_id_index>,
+                                                                                                            boost::multi_index::member<received_sync_block, bts::blockchain::block_id_type, &received_sync_block::block_id>,
+                                                                                                            std::hash<bts::blockchain::block_id_type> >,
+                                                                          boost::multi_index::ordered_non_unique<boost::multi_index::tag<block_number_index>,
+                                                                                                                 boost::multi_index::member<received_sync_block, uint32_t, &received_sync_block::block_num> > > > received_sync_block_container;
+
+      received_sync_block_container         _received_sync_blocks; /// sync blocks we've received, but can't yet process because we are still missing blocks that come earlier in the chain
+      size_t                                _received_sync_blocks_size; /// total packed size of _received_sync_blocks
       // @}
 
       fc::future<void> _process_backlog_of_sync_blocks_done;
@@ -491,8 +585,10 @@ namespace bts { namespace net { namespace detail {
       std::vector<uint32_t> _hard_fork_block_numbers; /// list of all block numbers where there are hard forks
 
       blockchain_tied_message_cache _message_cache; /// cache message we have received and might be required to provide to other peers via inventory requests
+      compressed_block_cache _compressed_block_cache; /// blocks read from the database and compressed for a peer
 
       fc::rate_limiting_group _rate_limiter;
+      bool _bandwidth_limited; /// set_total_bandwidth_limit() was given a limit; only sockets on this thread honor it
 
       uint32_t _last_reported_number_of_connections; // number of connections last reported to the client (to avoid sending duplicate messages)
 
@@ -538,6 +634,8 @@ namespace bts { namespace net { namespace detail {
       unsigned _maximum_number_of_blocks_to_handle_at_one_time;
       unsigned _maximum_number_of_sync_blocks_to_prefetch;
       unsigned _maximum_blocks_per_peer_during_syncing;
+      size_t   _maximum_sync_block_buffer_size;
+      bool     _send_compressed_blocks; // to peers that say they accept compressed messages
 
       std::list<fc::future<void> > _handle_message_calls_in_progress;
 
@@ -550,6 +648,8 @@ namespace bts { namespace net { namespace detail {
       void trigger_p2p_network_connect_loop();
 
       bool have_already_received_sync_item( const item_hash_t& item_hash );
+      bool is_sync_block_needed_next( const item_hash_t& item_hash );
+      unsigned get_sync_request_allowance( const peer_connection_ptr& peer ) const;
       void request_sync_item_from_peer( const peer_connection_ptr& peer, const item_hash_t& item_to_request );
       void request_sync_items_from_peer( const peer_connection_ptr& peer, const std::vector<item_hash_t>& items_to_request );
       void fetch_sync_items_loop();
@@ -571,6 +671,7 @@ namespace bts { namespace net { namespace detail {
 
       bool is_accepting_new_connections();
       bool is_wanting_new_connections();
+      fc::thread* get_io_thread_for_new_connection();
       uint32_t get_number_of_connections();
       peer_connection_ptr get_peer_by_node_id(const node_id_t& id);
 
@@ -713,7 +814,7 @@ namespace bts { namespace net { namespace detail {
       void                       set_total_bandwidth_limit( uint32_t upload_bytes_per_second, uint32_t download_bytes_per_second );
       void                       disable_peer_advertising();
       fc::variant_object         get_call_statistics() const;
-      message                    get_message_for_item(const item_id& item) override;
+      framed_message_ptr         get_message_for_item(const item_id& item, bool peer_accepts_compressed_messages) override;
 
       fc::variant_object         network_get_info() const;
       fc::variant_object         network_get_usage_stats() const;
@@ -758,10 +859,13 @@ namespace bts { namespace net { namespace detail {
 #ifdef P2P_IN_DEDICATED_THREAD
       _thread(std::make_shared<fc::thread>("p2p")),
 #endif // P2P_IN_DEDICATED_THREAD
+      _io_thread_count(BTS_NET_DEFAULT_IO_THREADS),
+      _next_io_thread(0),
       _delegate(nullptr),
       _is_firewalled(firewalled_state::unknown),
       _potential_peer_database_updated(false),
       _sync_items_to_fetch_updated(false),
+      _received_sync_blocks_size(0),
       _suspend_fetching_sync_blocks(false),
       _items_to_fetch_updated(false),
       _items_to_fetch_sequence_counter(0),
@@ -773,6 +877,7 @@ namespace bts { namespace net { namespace detail {
       _most_recent_blocks_accepted(_maximum_number_of_connections),
       _total_number_of_unfetched_items(0),
       _rate_limiter(0, 0),
+      _bandwidth_limited(false),
       _last_reported_number_of_connections(0),
       _peer_advertising_disabled(false),
       _average_network_read_speed_seconds(60),
@@ -786,7 +891,9 @@ namespace bts { namespace net { namespace detail {
       _node_is_shutting_down(false),
       _maximum_number_of_blocks_to_handle_at_one_time(MAXIMUM_NUMBER_OF_BLOCKS_TO_HANDLE_AT_ONE_TIME),
       _maximum_number_of_sync_blocks_to_prefetch(MAXIMUM_NUMBER_OF_BLOCKS_TO_PREFETCH),
-      _maximum_blocks_per_peer_during_syncing(BTS_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING)
+      _maximum_blocks_per_peer_during_syncing(BTS_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING),
+      _maximum_sync_block_buffer_size(BTS_NET_MAX_SYNC_BLOCK_BUFFER_SIZE),
+      _send_compressed_blocks(true)
     {
       _rate_limiter.set_actual_rate_time_constant(fc::seconds(2));
       fc::rand_pseudo_bytes(&_node_id.data[0], (int)_node_id.size());
@@ -955,10 +1062,27 @@ namespace bts { namespace net { namespace detail {
     bool node_impl::have_already_received_sync_item( const item_hash_t& item_hash )
     {
       VERIFY_CORRECT_THREAD();
-      return std::find_if(_received_sync_items.begin(), _received_sync_items.end(),
-                          [&item_hash]( const bts::client::block_message& message ) { return message.block_id == item_hash; } ) != _received_sync_items.end() ||
-             std::find_if(_new_received_sync_items.begin(), _new_received_sync_items.end(),
-                          [&item_hash]( const bts::client::block_message& message ) { return message.block_id == item_hash; } ) != _new_received_sync_items.end();                          ;
+      return _received_sync_blocks.get<block_id_index>().find(item_hash) != _received_sync_blocks.get<block_id_index>().end();
+    }
+
+    // true if the item is the first one some peer still needs us to process
+    bool node_impl::is_sync_block_needed_next( const item_hash_t& item_hash )
+    {
+      VERIFY_CORRECT_THREAD();
+      for (const peer_connection_ptr& peer : _active_connections)
+        if (!peer->ids_of_items_to_get.empty() && peer->ids_of_items_to_get.front() == item_hash)
+          return true;
+      return false;
+    }
+
+    // the number of sync blocks we keep requested from a peer: enough to keep it busy for the pipeline
+    // time at the rate it has been delivering them
+    unsigned node_impl::get_sync_request_allowance( const peer_connection_ptr& peer ) const
+    {
+      if (peer->sync_block_interval == fc::microseconds())
+        return _maximum_blocks_per_peer_during_syncing;
+      int64_t blocks = fc::milliseconds(BTS_NET_SYNC_REQUEST_PIPELINE_MS).count() / peer->sync_block_interval.count();
+      return (unsigned)std::max<int64_t>(1, std::min<int64_t>(blocks, _maximum_blocks_per_peer_during_syncing));
     }
 
     void node_impl::request_sync_item_from_peer( const peer_connection_ptr& peer, const item_hash_t& item_to_request )
@@ -966,7 +1090,7 @@ namespace bts { namespace net { namespace detail {
       VERIFY_CORRECT_THREAD();
       dlog( "requesting item ${item_hash} from peer ${endpoint}", ("item_hash", item_to_request )("endpoint", peer->get_remote_endpoint() ) );
       item_id item_id_to_request( bts::client::block_message_type, item_to_request );
-      _active_sync_requests.insert( active_sync_requests_map::value_type(item_to_request, fc::time_point::now() ) );
+      _active_sync_requests[item_to_request] = fc::time_point::now();
       peer->sync_items_requested_from_peer.insert( peer_connection::item_to_time_map_type::value_type(item_id_to_request, fc::time_point::now() ) );
       std::vector<item_hash_t> items_to_fetch;
       peer->send_message( fetch_items_message(item_id_to_request.item_type, std::vector<item_hash_t>{item_id_to_request.item_hash} ) );
@@ -979,7 +1103,8 @@ namespace bts { namespace net { namespace detail {
             ("item_count", items_to_request.size())("items_to_request", items_to_request)("endpoint", peer->get_remote_endpoint()) );
       for (const item_hash_t& item_to_request : items_to_request)
       {
-        _active_sync_requests.insert( active_sync_requests_map::value_type(item_to_request, fc::time_point::now() ) );
+        // a block asked of a second peer because the first was too slow counts from the new request
+        _active_sync_requests[item_to_request] = fc::time_point::now();
         item_id item_id_to_request( bts::client::block_message_type, item_to_request );
         peer->sync_items_requested_from_peer.insert( peer_connection::item_to_time_map_type::value_type(item_id_to_request, fc::time_point::now() ) );
       }
@@ -1002,34 +1127,95 @@ namespace bts { namespace net { namespace detail {
             ASSERT_TASK_NOT_PREEMPTED();
             std::set<item_hash_t> sync_items_to_request;
 
-            // for each idle peer that we're syncing with
+            // the peers we're syncing with that can take more block requests.  Peers aren't made to drain
+            // their requests before getting more, each is kept about BTS_NET_SYNC_REQUEST_PIPELINE_MS ahead
+            std::vector<peer_connection_ptr> sync_peers;
             for( const peer_connection_ptr& peer : _active_connections )
-            {
               if( peer->we_need_sync_items_from_peer &&
-                  sync_item_requests_to_send.find(peer) == sync_item_requests_to_send.end() && // if we've already scheduled a request for this peer, don't consider scheduling another
-                  peer->idle() )
+                  !peer->inhibit_fetching_sync_blocks &&
+                  peer->items_requested_from_peer.empty() &&
+                  !peer->item_ids_requested_from_peer &&
+                  peer->sync_items_requested_from_peer.size() < get_sync_request_allowance(peer) )
+                sync_peers.push_back(peer);
+
+            // fastest first, so the blocks we need soonest go to the peers that will deliver them soonest and
+            // each slower peer takes the range after it.  Peers we haven't measured yet go last.
+            std::stable_sort(sync_peers.begin(), sync_peers.end(),
+                             [](const peer_connection_ptr& a, const peer_connection_ptr& b) {
+                               if (a->sync_block_interval == fc::microseconds())
+                                 return false;
+                               return b->sync_block_interval == fc::microseconds() || a->sync_block_interval < b->sync_block_interval;
+                             });
+
+            // if blocks after the one we need next have arrived but it hasn't, and the peer we asked is well past
+            // when it should have delivered it, ask a faster peer for it too.  Whichever copy arrives second is dropped
+            if( !_received_sync_blocks.empty() )
+              for( const peer_connection_ptr& peer : _active_connections )
+              {
+                if( peer->ids_of_items_to_get.empty() )
+                  continue;
+                const item_hash_t& next_item = peer->ids_of_items_to_get.front();
+                auto active_request_iter = _active_sync_requests.find(next_item);
+                if( active_request_iter == _active_sync_requests.end() ||
+                    sync_items_to_request.find(next_item) != sync_items_to_request.end() )
+                  continue;
+
+                item_id next_item_id(bts::client::block_message_type, next_item);
+                fc::microseconds slowest_holder_interval;
+                for( const peer_connection_ptr& holder : _active_connections )
+                  if( holder->sync_items_requested_from_peer.find(next_item_id) != holder->sync_items_requested_from_peer.end() )
+                    slowest_holder_interval = std::max(slowest_holder_interval, holder->sync_block_interval);
+                fc::microseconds straggler_delay = std::max(fc::milliseconds(BTS_NET_MIN_SYNC_STRAGGLER_DELAY_MS),
+                                                            fc::microseconds(slowest_holder_interval.count() * BTS_NET_SYNC_STRAGGLER_FACTOR));
+                if( fc::time_point::now() - active_request_iter->second < straggler_delay )
+                  continue;
+
+                for( const peer_connection_ptr& faster_peer : sync_peers )
+                  if( faster_peer->sync_block_interval != fc::microseconds() &&
+                      (slowest_holder_interval == fc::microseconds() || faster_peer->sync_block_interval < slowest_holder_interval) &&
+                      !faster_peer->ids_of_items_to_get.empty() &&
+                      faster_peer->ids_of_items_to_get.front() == next_item &&
+                      faster_peer->sync_items_requested_from_peer.find(next_item_id) == faster_peer->sync_items_requested_from_peer.end() )
+                  {
+                    dlog("sync block ${id} has been outstanding for ${delay} us, also asking peer ${endpoint}",
+                         ("id", next_item)("delay", (fc::time_point::now() - active_request_iter->second).count())
+                         ("endpoint", faster_peer->get_remote_endpoint()));
+                    sync_item_requests_to_send[faster_peer].push_back(next_item);
+                    sync_items_to_request.insert(next_item);
+                    break;
+                  }
+              }
+
+            // don't ask for new blocks while the ones waiting on earlier blocks are already using all the memory we allow
+            if( _received_sync_blocks_size < _maximum_sync_block_buffer_size )
+              for( const peer_connection_ptr& peer : sync_peers )
               {
-                if (!peer->inhibit_fetching_sync_blocks)
+                auto scheduled_iter = sync_item_requests_to_send.find(peer);
+                size_t requests_in_flight = peer->sync_items_requested_from_peer.size() +
+                                            (scheduled_iter == sync_item_requests_to_send.end() ? 0 : scheduled_iter->second.size());
+                unsigned allowance = get_sync_request_allowance(peer);
+                if( requests_in_flight >= allowance )
+                  continue;
+
+                // loop through the items it has that we don't yet have on our blockchain, but only as far ahead of the
+                // next block as we're willing to hold blocks
+                size_t window = std::min<size_t>(peer->ids_of_items_to_get.size(), _maximum_number_of_sync_blocks_to_prefetch);
+                for( size_t i = 0; i < window; ++i )
                 {
-                  // loop through the items it has that we don't yet have on our blockchain
-                  for( unsigned i = 0; i < peer->ids_of_items_to_get.size(); ++i )
+                  item_hash_t item_to_potentially_request = peer->ids_of_items_to_get[i];
+                  // if we don't already have this item in our temporary storage and we haven't requested from another syncing peer
+                  if( !have_already_received_sync_item(item_to_potentially_request) && // already got it, but for some reson it's still in our list of items to fetch
+                      sync_items_to_request.find(item_to_potentially_request) == sync_items_to_request.end() &&  // we have already decided to request it from another peer during this iteration
+                      _active_sync_requests.find(item_to_potentially_request) == _active_sync_requests.end() ) // we've requested it in a previous iteration and we're still waiting for it to arrive
                   {
-                    item_hash_t item_to_potentially_request = peer->ids_of_items_to_get[i];
-                    // if we don't already have this item in our temporary storage and we haven't requested from another syncing peer
-                    if( !have_already_received_sync_item(item_to_potentially_request) && // already got it, but for some reson it's still in our list of items to fetch
-                        sync_items_to_request.find(item_to_potentially_request) == sync_items_to_request.end() &&  // we have already decided to request it from another peer during this iteration
-                        _active_sync_requests.find(item_to_potentially_request) == _active_sync_requests.end() ) // we've requested it in a previous iteration and we're still waiting for it to arrive
-                    {
-                      // then schedule a request from this peer
-                      sync_item_requests_to_send[peer].push_back(item_to_potentially_request);
-                      sync_items_to_request.insert( item_to_potentially_request );
-                      if (sync_item_requests_to_send[peer].size() >= _maximum_blocks_per_peer_during_syncing)
-                        break;
-                    }
+                    // then schedule a request from this peer
+                    sync_item_requests_to_send[peer].push_back(item_to_potentially_request);
+                    sync_items_to_request.insert( item_to_potentially_request );
+                    if (++requests_in_flight >= allowance)
+                      break;
                   }
                 }
               }
-            }
           } // end non-preemptable section
 
           // make all the requests we scheduled in the loop above
@@ -1523,6 +1709,23 @@ namespace bts { namespace net { namespace detail {
       return !_p2p_network_connect_loop_done.canceled() && get_number_of_connections() < _desired_number_of_connections;
     }
 
+    fc::thread* node_impl::get_io_thread_for_new_connection()
+    {
+      VERIFY_CORRECT_THREAD();
+      if (_io_thread_count == 0)
+        return nullptr;
+
+      // the rate limiter can only throttle sockets read and written on this thread
+      if (_bandwidth_limited)
+        return nullptr;
+
+      // threads are started as they are first needed; lowering the count just stops assigning the extras
+      const uint32_t thread_index = _next_io_thread++ % _io_thread_count;
+      while (_io_threads.size() <= thread_index)
+        _io_threads.push_back(std::unique_ptr<fc::thread>(new fc::thread("p2p_io_" + std::to_string(_io_threads.size()))));
+      return _io_threads[thread_index].get();
+    }
+
     uint32_t node_impl::get_number_of_connections()
     {
       VERIFY_CORRECT_THREAD();
@@ -1671,6 +1874,11 @@ namespace bts { namespace net { namespace detail {
       case core_message_type_enum::get_current_connections_reply_message_type:
         on_get_current_connections_reply_message(originating_peer, received_message.as<get_current_connections_reply_message>());
         break;
+      case core_message_type_enum::compressed_message_type:
+        // the connection unpacks compressed messages as it reads them, so this one was nested in another
+        wlog("ignoring a compressed message nested in another from peer ${endpoint}",
+             ("endpoint", originating_peer->get_remote_endpoint()));
+        break;
 
       default:
         // ignore any message in between core_message_type_first and _last that we don't handle above
@@ -1705,6 +1913,7 @@ namespace bts { namespace net { namespace detail {
       user_data["platform"] = "other";
 #endif
       user_data["bitness"] = sizeof(void*) * 8;
+      user_data["accepts_compressed_messages"] = true;
 
       user_data["node_id"] = _node_id;
 
@@ -1734,6 +1943,8 @@ namespace bts { namespace net { namespace detail {
         originating_peer->platform = user_data["platform"].as_string();
       if (user_data.contains("bitness"))
         originating_peer->bitness = user_data["bitness"].as<uint32_t>();
+      if (user_data.contains("accepts_compressed_messages"))
+        originating_peer->accepts_compressed_messages = user_data["accepts_compressed_messages"].as_bool();
       if (user_data.contains("node_id"))
         originating_peer->node_id = user_data["node_id"].as<node_id_t>();
       if (user_data.contains("last_known_fork_block_number"))
@@ -2456,21 +2667,38 @@ namespace bts { namespace net { namespace detail {
       }
     }
 
-    message node_impl::get_message_for_item(const item_id& item)
+    framed_message_ptr node_impl::get_message_for_item(const item_id& item, bool peer_accepts_compressed_messages)
     {
+      // only blocks are big enough to be worth compressing
+      bool compress = peer_accepts_compressed_messages && _send_compressed_blocks && item.item_type == block_message_type;
       try
       {
+        if (compress)
+          if (framed_message_ptr compressed_message = _message_cache.get_compressed_message(item.item_hash))
+            return compressed_message;
         return _message_cache.get_message(item.item_hash);
       }
       catch (fc::key_not_found_exception&)
       {}
       try
       {
-        return _delegate->get_item(item);
+        framed_message_ptr compressed_message;
+        if (compress && _compressed_block_cache.get(item.item_hash, compressed_message) && compressed_message)
+          return compressed_message;
+
+        framed_message_ptr requested_message = std::make_shared<framed_message>(_delegate->get_item(item));
+        if (compress)
+        {
+          compressed_message = compress_framed_message(*requested_message);
+          _compressed_block_cache.insert(item.item_hash, compressed_message);
+          if (compressed_message)
+            return compressed_message;
+        }
+        return requested_message;
       }
       catch (fc::key_not_found_exception&)
       {}
-      return item_not_available_message(item);
+      return std::make_shared<framed_message>(message(item_not_available_message(item)));
     }
 
     void node_impl::on_fetch_items_message(peer_connection* originating_peer, const fetch_items_message& fetch_items_message_received)
@@ -2481,17 +2709,17 @@ namespace bts { namespace net { namespace detail {
            ("type", fetch_items_message_received.item_type)
            ("endpoint", originating_peer->get_remote_endpoint()));
 
-      fc::optional<message> last_block_message_sent;
+      framed_message_ptr last_block_message_sent;
 
-      std::list<message> reply_messages;
+      std::list<framed_message_ptr> reply_messages;
       for (const item_hash_t& item_hash : fetch_items_message_received.items_to_fetch)
       {
         try
         {
-          message requested_message = _message_cache.get_message(item_hash);
+          framed_message_ptr requested_message = _message_cache.get_message(item_hash);
           dlog("received item request for item ${id} from peer ${endpoint}, returning the item from my message cache",
                ("endpoint", originating_peer->get_remote_endpoint())
-               ("id", requested_message.id()));
+               ("id", item_hash));
           reply_messages.push_back(requested_message);
           if (fetch_items_message_received.item_type == block_message_type)
             last_block_message_sent = requested_message;
@@ -2505,10 +2733,10 @@ namespace bts { namespace net { namespace detail {
         item_id item_to_fetch(fetch_items_message_received.item_type, item_hash);
         try
         {
-          message requested_message = _delegate->get_item(item_to_fetch);
+          framed_message_ptr requested_message = std::make_shared<framed_message>(_delegate->get_item(item_to_fetch));
           dlog("received item request from peer ${endpoint}, returning the item from delegate with id ${id} size ${size}",
-               ("id", requested_message.id())
-               ("size", requested_message.size)
+               ("id", item_hash)
+               ("size", requested_message->header().size)
                ("endpoint", originating_peer->get_remote_endpoint()));
           reply_messages.push_back(requested_message);
           if (fetch_items_message_received.item_type == block_message_type)
@@ -2517,7 +2745,7 @@ namespace bts { namespace net { namespace detail {
         }
         catch (fc::key_not_found_exception&)
         {
-          reply_messages.push_back(item_not_available_message(item_to_fetch));
+          reply_messages.push_back(std::make_shared<framed_message>(message(item_not_available_message(item_to_fetch))));
           dlog("received item request from peer ${endpoint} but we don't have it",
                ("endpoint", originating_peer->get_remote_endpoint()));
         }
@@ -2532,12 +2760,12 @@ namespace bts { namespace net { namespace detail {
         originating_peer->last_block_time_delegate_has_seen = _delegate->get_block_time(block.block_id);
       }
 
-      for (const message& reply : reply_messages)
+      for (const framed_message_ptr& reply : reply_messages)
       {
-        if (reply.msg_type == block_message_type)
-          originating_peer->send_item(item_id(block_message_type, reply.as<bts::client::block_message>().block_id));
+        if (reply->msg_type() == block_message_type)
+          originating_peer->send_item(item_id(block_message_type, reply->as<bts::client::block_message>().block_id));
         else
-          originating_peer->send_message(reply);
+          originating_peer->send_message(reply); // cached relays share one frame across all the peers asking for them
       }
     }
 
@@ -2663,7 +2891,8 @@ namespace bts { namespace net { namespace detail {
     {
       VERIFY_CORRECT_THREAD();
       peer_connection_ptr originating_peer_ptr = originating_peer->shared_from_this();
-      _rate_limiter.remove_tcp_socket( &originating_peer->get_socket() );
+      if (!originating_peer->uses_io_thread())
+        _rate_limiter.remove_tcp_socket( &originating_peer->get_socket() );
 
       // if we closed the connection (due to timeout or handshake failure), we should have recorded an
       // error message to store in the peer database when we closed the connection
@@ -2962,66 +3191,73 @@ namespace bts { namespace net { namespace detail {
 
       do
       {
-        std::copy(std::make_move_iterator(_new_received_sync_items.begin()),
-                  std::make_move_iterator(_new_received_sync_items.end()),
-                  std::front_inserter(_received_sync_items));
-        _new_received_sync_items.clear();
-        dlog("currently ${count} sync items to consider", ("count", _received_sync_items.size()));
+        dlog("currently ${count} sync items to consider", ("count", _received_sync_blocks.size()));
 
         block_processed_this_iteration = false;
-        for (auto received_block_iter = _received_sync_items.begin();
-             received_block_iter != _received_sync_items.end();
-             ++received_block_iter)
+
+        // the next block on the active chain or one of the forks is the first unfetched block of some peer,
+        // so look those up in the buffer rather than checking every buffered block against every peer
+        fc::optional<item_hash_t> next_block_id;
+        for (const peer_connection_ptr& peer : _active_connections)
         {
+          ASSERT_TASK_NOT_PREEMPTED(); // don't yield while iterating over _active_connections
+          if (!peer->ids_of_items_to_get.empty() &&
+              have_already_received_sync_item(peer->ids_of_items_to_get.front()))
+          {
+            next_block_id = peer->ids_of_items_to_get.front();
+            break;
+          }
+        }
+
+        // if we have it, process it, remove it from all sync peers lists
+        if (next_block_id)
+        {
+          auto received_block_iter = _received_sync_blocks.get<block_id_index>().find(*next_block_id);
+          bts::client::block_message block_message_to_process = received_block_iter->sync_block;
+          _received_sync_blocks_size -= received_block_iter->packed_size;
+          _received_sync_blocks.get<block_id_index>().erase(received_block_iter);
+
+          // we can get into an interesting situation near the end of synchronization.  We can be in
+          // sync with one peer who is sending us the last block on the chain via a regular inventory
+          // message, while at the same time still be synchronizing with a peer who is sending us the
+          // block through the sync mechanism.  Further, we must request both blocks because
+          // we don't know they're the same (for the peer in normal operation, it has only told us the
+          // message id, for the peer in the sync case we only known the block_id).
+          bool already_accepted = std::find(_most_recent_blocks_accepted.begin(), _most_recent_blocks_accepted.end(),
+                                            *next_block_id) != _most_recent_blocks_accepted.end();
 
-          // find out if this block is the next block on the active chain or one of the forks
-          bool potential_first_block = false;
           for (const peer_connection_ptr& peer : _active_connections)
           {
             ASSERT_TASK_NOT_PREEMPTED(); // don't yield while iterating over _active_connections
             if (!peer->ids_of_items_to_get.empty() &&
-                peer->ids_of_items_to_get.front() == received_block_iter->block_id)
+                peer->ids_of_items_to_get.front() == *next_block_id)
             {
-              potential_first_block = true;
               peer->ids_of_items_to_get.pop_front();
-              peer->ids_of_items_being_processed.insert(received_block_iter->block_id);
+              if (!already_accepted)
+                peer->ids_of_items_being_processed.insert(*next_block_id);
             }
           }
 
-          // if it is, process it, remove it from all sync peers lists
-          if (potential_first_block)
+          if (!already_accepted)
           {
-            // we can get into an interesting situation near the end of synchronization.  We can be in
-            // sync with one peer who is sending us the last block on the chain via a regular inventory
-            // message, while at the same time still be synchronizing with a peer who is sending us the
-            // block through the sync mechanism.  Further, we must request both blocks because
-            // we don't know they're the same (for the peer in normal operation, it has only told us the
-            // message id, for the peer in the sync case we only known the block_id).
-            if (std::find(_most_recent_blocks_accepted.begin(), _most_recent_blocks_accepted.end(),
-                          received_block_iter->block_id) == _most_recent_blocks_accepted.end())
-            {
-              bts::client::block_message block_message_to_process = *received_block_iter;
-              _received_sync_items.erase(received_block_iter);
-              _handle_message_calls_in_progress.emplace_back(fc::async([this, block_message_to_process](){
-                send_sync_block_to_node_delegate(block_message_to_process);
-              }, "send_sync_block_to_node_delegate"));
-              ++blocks_processed;
-              block_processed_this_iteration = true;
-            }
-            else
-              dlog("Already received and accepted this block (presumably through normal inventory mechanism), treating it as accepted");
-
-            break; // start iterating _received_sync_items from the beginning
-          } // end if potential_first_block
-        } // end for each block in _received_sync_items
+            _handle_message_calls_in_progress.emplace_back(fc::async([this, block_message_to_process](){
+              send_sync_block_to_node_delegate(block_message_to_process);
+            }, "send_sync_block_to_node_delegate"));
+            ++blocks_processed;
+          }
+          else
+            dlog("Already received and accepted this block (presumably through normal inventory mechanism), treating it as accepted");
+          block_processed_this_iteration = true;
+        }
 
         if (_handle_message_calls_in_progress.size() >= _maximum_number_of_blocks_to_handle_at_one_time)
         {
           dlog("stopping processing sync block backlog because we have ${count} blocks in progress",
                ("count", _handle_message_calls_in_progress.size()));
           //ulog("stopping processing sync block backlog because we have ${count} blocks in progress, total on hand: ${received}",
-          //     ("count", _handle_message_calls_in_progress.size())("received", _received_sync_items.size()));
-          if (_received_sync_items.size() >= _maximum_number_of_sync_blocks_to_prefetch)
+          //     ("count", _handle_message_calls_in_progress.size())("received", _received_sync_blocks.size()));
+          if (_received_sync_blocks.size() >= _maximum_number_of_sync_blocks_to_prefetch ||
+              _received_sync_blocks_size >= _maximum_sync_block_buffer_size)
             _suspend_fetching_sync_blocks = true;
           break;
         }
@@ -3046,9 +3282,44 @@ namespace bts { namespace net { namespace detail {
       VERIFY_CORRECT_THREAD();
       dlog( "received a sync block from peer ${endpoint}", ("endpoint", originating_peer->get_remote_endpoint() ) );
 
-      // add it to the front of _received_sync_items, then process _received_sync_items to try to
-      // pass as many messages as possible to the client.
-      _new_received_sync_items.push_front( block_message_to_process );
+      // a block asked of a second peer because the first was slow arrives twice; drop the copy that
+      // comes after we've buffered or handled the first, unless a peer is still waiting on it
+      const item_hash_t& block_id = block_message_to_process.block_id;
+      if (have_already_received_sync_item(block_id))
+      {
+        dlog("already have sync block ${id} buffered, dropping the copy", ("id", block_id));
+        return;
+      }
+      if (!is_sync_block_needed_next(block_id))
+      {
+        bool already_handled = std::find(_most_recent_blocks_accepted.begin(), _most_recent_blocks_accepted.end(),
+                                         block_id) != _most_recent_blocks_accepted.end();
+        for (const peer_connection_ptr& peer : _active_connections)
+          if (peer->ids_of_items_being_processed.find(block_id) != peer->ids_of_items_being_processed.end())
+            already_handled = true;
+        if (already_handled)
+        {
+          dlog("already handled sync block ${id}, dropping the copy", ("id", block_id));
+          return;
+        }
+      }
+
+      // add it to the reorder buffer, then process the buffer to try to pass as many messages as
+      // possible to the client.
+      auto insert_result = _received_sync_blocks.insert(received_sync_block(block_message_to_process));
+      _received_sync_blocks_size += insert_result.first->packed_size;
+
+      // stay under the memory bound by dropping the blocks furthest ahead.  Nothing is buffered or
+      // outstanding for them any more, so the fetch loop will ask for them again once there is room
+      auto& blocks_by_number = _received_sync_blocks.get<block_number_index>();
+      while (_received_sync_blocks_size > _maximum_sync_block_buffer_size && blocks_by_number.size() > 1)
+      {
+        auto furthest_block_iter = std::prev(blocks_by_number.end());
+        dlog("sync block buffer is full, dropping block ${num} to fetch again later", ("num", furthest_block_iter->block_num));
+        _received_sync_blocks_size -= furthest_block_iter->packed_size;
+        blocks_by_number.erase(furthest_block_iter);
+      }
+
       trigger_process_backlog_of_sync_blocks();
     }
 
@@ -3191,6 +3462,7 @@ namespace bts { namespace net { namespace detail {
                                                                                             block_message_to_process.block_id));
         if (sync_item_iter != originating_peer->sync_items_requested_from_peer.end())
         {
+          originating_peer->record_sync_block_received(sync_item_iter->second);
           originating_peer->sync_items_requested_from_peer.erase(sync_item_iter);
           _active_sync_requests.erase(block_message_to_process.block_id);
           process_block_during_sync(originating_peer, block_message_to_process, message_hash);
@@ -3204,6 +3476,8 @@ namespace bts { namespace net { namespace detail {
             else
               trigger_fetch_sync_items_loop();
           }
+          else
+            trigger_fetch_sync_items_loop(); // top up this peer's requests, or hand a straggler to it
           return;
         }
       }
@@ -3321,7 +3595,7 @@ namespace bts { namespace net { namespace detail {
         {
           // we're not connected to them, so we need to set up a connection to them
           // to test.
-          peer_connection_ptr peer_for_testing(peer_connection::make_shared(this));
+          peer_connection_ptr peer_for_testing(peer_connection::make_shared(this, get_io_thread_for_new_connection()));
           peer_for_testing->firewall_check_state = new firewall_check_state_data;
           peer_for_testing->firewall_check_state->endpoint_to_test = check_firewall_message_received.endpoint_to_check;
           peer_for_testing->firewall_check_state->expected_node_id = check_firewall_message_received.node_id;
@@ -3857,7 +4131,7 @@ namespace bts { namespace net { namespace detail {
       VERIFY_CORRECT_THREAD();
       while ( !_accept_loop_complete.canceled() )
       {
-        peer_connection_ptr new_peer(peer_connection::make_shared(this));
+        peer_connection_ptr new_peer(peer_connection::make_shared(this, get_io_thread_for_new_connection()));
 
         try
         {
@@ -3867,7 +4141,8 @@ namespace bts { namespace net { namespace detail {
             return;
           new_peer->connection_initiation_time = fc::time_point::now();
           _handshaking_connections.insert( new_peer );
-          _rate_limiter.add_tcp_socket( &new_peer->get_socket() );
+          if (!new_peer->uses_io_thread())
+            _rate_limiter.add_tcp_socket( &new_peer->get_socket() );
           std::weak_ptr<peer_connection> new_weak_peer(new_peer);
           new_peer->accept_or_connect_task_done = fc::async( [this, new_weak_peer]() {
             peer_connection_ptr new_peer(new_weak_peer.lock());
@@ -4259,7 +4534,8 @@ namespace bts { namespace net { namespace detail {
       new_peer->get_socket().set_reuse_address();
       new_peer->connection_initiation_time = fc::time_point::now();
       _handshaking_connections.insert(new_peer);
-      _rate_limiter.add_tcp_socket(&new_peer->get_socket());
+      if (!new_peer->uses_io_thread())
+        _rate_limiter.add_tcp_socket(&new_peer->get_socket());
 
       if (_node_is_shutting_down)
         return;
@@ -4282,7 +4558,7 @@ namespace bts { namespace net { namespace detail {
                            ("endpoint", remote_endpoint));
 
       dlog("node_impl::connect_to_endpoint(${endpoint})", ("endpoint", remote_endpoint));
-      peer_connection_ptr new_peer(peer_connection::make_shared(this));
+      peer_connection_ptr new_peer(peer_connection::make_shared(this, get_io_thread_for_new_connection()));
       new_peer->set_remote_endpoint(remote_endpoint);
       initiate_connect_to(new_peer);
     }
@@ -4364,8 +4640,7 @@ namespace bts { namespace net { namespace detail {
 
       ilog( "--------- MEMORY USAGE ------------" );
       ilog( "node._active_sync_requests size: ${size}", ("size", _active_sync_requests.size() ) ); // TODO: un-break this
-      ilog( "node._received_sync_items size: ${size}", ("size", _received_sync_items.size() ) );
-      ilog( "node._new_received_sync_items size: ${size}", ("size", _new_received_sync_items.size() ) );
+      ilog( "node._received_sync_blocks size: ${size} (${bytes} bytes)", ("size", _received_sync_blocks.size() )("bytes", _received_sync_blocks_size) );
       ilog( "node._items_to_fetch size: ${size}", ("size", _items_to_fetch.size() ) );
       ilog( "node._new_inventory size: ${size}", ("size", _new_inventory.size() ) );
       ilog( "node._message_cache size: ${size}", ("size", _message_cache.size() ) );
@@ -4633,6 +4908,16 @@ namespace bts { namespace net { namespace detail {
         _maximum_number_of_sync_blocks_to_prefetch = params["maximum_number_of_sync_blocks_to_prefetch"].as<uint32_t>();
       if (params.contains("maximum_blocks_per_peer_during_syncing"))
         _maximum_blocks_per_peer_during_syncing = params["maximum_blocks_per_peer_during_syncing"].as<uint32_t>();
+      if (params.contains("maximum_sync_block_buffer_size"))
+        _maximum_sync_block_buffer_size = params["maximum_sync_block_buffer_size"].as<uint64_t>();
+      if (params.contains("send_compressed_blocks"))
+        _send_compressed_blocks = params["send_compressed_blocks"].as_bool();
+      if (params.contains("io_thread_count"))
+      {
+        _io_thread_count = params["io_thread_count"].as<uint32_t>(); // only affects new connections
+        if (_bandwidth_limited && _io_thread_count > 0)
+          wlog("ignoring io_thread_count ${count} for new connections so the bandwidth limit applies to them", ("count", _io_thread_count));
+      }
 
       _desired_number_of_connections = std::min(_desired_number_of_connections, _maximum_number_of_connections);
 
@@ -4652,6 +4937,9 @@ namespace bts { namespace net { namespace detail {
       result["maximum_number_of_blocks_to_handle_at_one_time"] = _maximum_number_of_blocks_to_handle_at_one_time;
       result["maximum_number_of_sync_blocks_to_prefetch"] = _maximum_number_of_sync_blocks_to_prefetch;
       result["maximum_blocks_per_peer_during_syncing"] = _maximum_blocks_per_peer_during_syncing;
+      result["maximum_sync_block_buffer_size"] = (uint64_t)_maximum_sync_block_buffer_size;
+      result["send_compressed_blocks"] = _send_compressed_blocks;
+      result["io_thread_count"] = _io_thread_count;
       return result;
     }
 
@@ -4698,6 +4986,9 @@ namespace bts { namespace net { namespace detail {
       VERIFY_CORRECT_THREAD();
       _rate_limiter.set_upload_limit( upload_bytes_per_second );
       _rate_limiter.set_download_limit( download_bytes_per_second );
+      _bandwidth_limited = upload_bytes_per_second != 0 || download_bytes_per_second != 0;
+      if (_bandwidth_limited && _io_thread_count > 0)
+        wlog("ignoring io_thread_count ${count} for new connections so the bandwidth limit applies to them", ("count", _io_thread_count));
     }
 
     void node_impl::disable_peer_advertising()
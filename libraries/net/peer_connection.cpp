@@ -14,7 +14,7 @@
 
 namespace bts { namespace net
   {
-    message peer_connection::real_queued_message::get_message(peer_connection_delegate*)
+    void peer_connection::real_queued_message::send(message_oriented_connection& connection, peer_connection_delegate*)
     {
       if (message_send_time_field_offset != (size_t)-1)
       {
@@ -25,15 +25,24 @@ namespace bts { namespace net
         memcpy(message_to_send.data.data() + message_send_time_field_offset,
                packed_current_time.data(), packed_current_time.size());
       }
-      return message_to_send;
+      connection.send_message(message_to_send);
     }
     size_t peer_connection::real_queued_message::get_size_in_queue()
     {
       return message_to_send.data.size();
     }
-    message peer_connection::virtual_queued_message::get_message(peer_connection_delegate* node)
+    void peer_connection::shared_queued_message::send(message_oriented_connection& connection, peer_connection_delegate*)
     {
-      return node->get_message_for_item(item_to_send);
+      connection.send_message(frame_to_send);
+    }
+    size_t peer_connection::shared_queued_message::get_size_in_queue()
+    {
+      // counted in full even though it's shared: a slow peer can keep it alive after everyone else is done with it
+      return frame_to_send->size();
+    }
+    void peer_connection::virtual_queued_message::send(message_oriented_connection& connection, peer_connection_delegate* node)
+    {
+      connection.send_message(node->get_message_for_item(item_to_send, peer_accepts_compressed_messages));
     }
 
     size_t peer_connection::virtual_queued_message::get_size_in_queue()
@@ -41,9 +50,10 @@ namespace bts { namespace net
       return sizeof(item_id);
     }
 
-    peer_connection::peer_connection(peer_connection_delegate* delegate) :
+    peer_connection::peer_connection(peer_connection_delegate* delegate, fc::thread* io_thread) :
       _node(delegate),
-      _message_connection(this),
+      _message_connection(this, io_thread),
+      _uses_io_thread(io_thread != nullptr),
       _total_queued_messages_size(0),
       direction(peer_connection_direction::unknown),
       is_firewalled(firewalled_state::unknown),
@@ -52,6 +62,7 @@ namespace bts { namespace net
       their_state(their_connection_state::disconnected),
       we_have_requested_close(false),
       negotiation_status(connection_negotiation_status::disconnected),
+      accepts_compressed_messages(false),
       number_of_unfetched_item_ids(0),
       peer_needs_sync_items_from_us(true),
       we_need_sync_items_from_peer(true),
@@ -67,7 +78,7 @@ namespace bts { namespace net
     {
     }
 
-    peer_connection_ptr peer_connection::make_shared(peer_connection_delegate* delegate)
+    peer_connection_ptr peer_connection::make_shared(peer_connection_delegate* delegate, fc::thread* io_thread)
     {
       // The lifetime of peer_connection objects is managed by shared_ptrs in node.  The peer_connection
       // is responsible for notifying the node when it should be deleted, and the process of deleting it
@@ -77,7 +88,7 @@ namespace bts { namespace net
       // current task yields.  In the (not uncommon) case where it is the task executing
       // connect_to or read_loop, this allows the task to finish before the destructor is forced
       // to cancel it.
-      return peer_connection_ptr(new peer_connection(delegate));
+      return peer_connection_ptr(new peer_connection(delegate, io_thread));
       //, [](peer_connection* peer_to_delete){ fc::async([peer_to_delete](){delete peer_to_delete;}); });
     }
 
@@ -261,13 +272,11 @@ namespace bts { namespace net
       while (!_queued_messages.empty())
       {
         _queued_messages.front()->transmission_start_time = fc::time_point::now();
-        message message_to_send = _queued_messages.front()->get_message(_node);
         try
         {
           dlog("peer_connection::send_queued_messages_task() calling message_oriented_connection::send_message() "
-               "to send message of type ${type} for peer ${endpoint}",
-               ("type", message_to_send.msg_type)("endpoint", get_remote_endpoint()));
-          _message_connection.send_message(message_to_send);
+               "for peer ${endpoint}", ("endpoint", get_remote_endpoint()));
+          _queued_messages.front()->send(_message_connection, _node);
           dlog("peer_connection::send_queued_messages_task()'s call to message_oriented_connection::send_message() completed normally for peer ${endpoint}",
                ("endpoint", get_remote_endpoint()));
         }
@@ -345,12 +354,21 @@ namespace bts { namespace net
       send_queueable_message(std::move(message_to_enqueue));
     }
 
+    void peer_connection::send_message(const framed_message_ptr& frame_to_send)
+    {
+      VERIFY_CORRECT_THREAD();
+      dlog("peer_connection::send_message() enqueueing shared message of type ${type} for peer ${endpoint}",
+           ("type", frame_to_send->msg_type())("endpoint", get_remote_endpoint()));
+      std::unique_ptr<queued_message> message_to_enqueue(new shared_queued_message(frame_to_send));
+      send_queueable_message(std::move(message_to_enqueue));
+    }
+
     void peer_connection::send_item(const item_id& item_to_send)
     {
       VERIFY_CORRECT_THREAD();
       dlog("peer_connection::send_item() enqueueing message of type ${type} for peer ${endpoint}",
            ("type", item_to_send.item_type)("endpoint", get_remote_endpoint()));
-      std::unique_ptr<queued_message> message_to_enqueue(new virtual_queued_message(item_to_send));
+      std::unique_ptr<queued_message> message_to_enqueue(new virtual_queued_message(item_to_send, accepts_compressed_messages));
       send_queueable_message(std::move(message_to_enqueue));
     }
 
@@ -423,6 +441,20 @@ namespace bts { namespace net
       return !busy();
     }
 
+    void peer_connection::record_sync_block_received(const fc::time_point& request_time)
+    {
+      VERIFY_CORRECT_THREAD();
+      // blocks requested together arrive one after another, so time each from when the peer
+      // could have started on it: its request, or the delivery of the block before it
+      fc::time_point now = fc::time_point::now();
+      fc::microseconds interval = std::max(now - std::max(request_time, last_sync_block_received_time), fc::microseconds(1));
+      if (sync_block_interval == fc::microseconds())
+        sync_block_interval = interval;
+      else
+        sync_block_interval = fc::microseconds((interval.count() + 7 * sync_block_interval.count()) / 8);
+      last_sync_block_received_time = now;
+    }
+
     bool peer_connection::is_transaction_fetching_inhibited() const
     {
       VERIFY_CORRECT_THREAD();
@@ -9,6 +9,7 @@
 #include <fc/network/ip.hpp>
 #include <fc/exception/exception.hpp>
 
+#include <bts/net/config.hpp>
 #include <bts/net/stcp_socket.hpp>
 
 namespace bts { namespace net {
@@ -60,16 +61,17 @@ void stcp_socket::bind( const fc::ip::endpoint& local_endpoint )
 /**
  *   This method must read at least 16 bytes at a time from
  *   the underlying TCP socket so that it can decrypt them. It
- *   will buffer any left-over.
+ *   reads the ciphertext straight into the caller's buffer and
+ *   decrypts it there, so len is only limited by the buffer.
  */
 size_t stcp_socket::readsome( char* buffer, size_t len )
 { try {
     assert( len > 0 && (len % 16) == 0 );
 
 #ifndef NDEBUG
-    // This code was written with the assumption that you'd only be making one call to readsome 
-    // at a time so it reuses _read_buffer.  If you really need to make concurrent calls to 
-    // readsome(), you'll need to prevent reusing _read_buffer here
+    // This code was written with the assumption that you'd only be making one call to readsome
+    // at a time, since the decoder's state carries over from one call to the next.  If you really
+    // need to make concurrent calls to readsome(), you'll need to serialize them here
     struct check_buffer_in_use {
       bool& _buffer_in_use;
       check_buffer_in_use(bool& buffer_in_use) : _buffer_in_use(buffer_in_use) { assert(!_buffer_in_use); _buffer_in_use = true; }
@@ -77,19 +79,14 @@ size_t stcp_socket::readsome( char* buffer, size_t len )
     } buffer_in_use_checker(_read_buffer_in_use);
 #endif
 
-    const size_t read_buffer_length = 4096;
-    if (!_read_buffer)
-      _read_buffer.reset(new char[read_buffer_length], [](char* p){ delete[] p; });
-
-    len = std::min<size_t>(read_buffer_length, len);
-
-    size_t s = _sock.readsome( _read_buffer, len, 0 );
-    if( s % 16 ) 
+    size_t s = _sock.readsome( buffer, len );
+    if( s % 16 )
     {
-      _sock.read(_read_buffer, 16 - (s%16), s);
+      // len is a multiple of 16, so the rest of the block still fits
+      _sock.read(buffer + s, 16 - (s%16));
       s += 16-(s%16);
     }
-    _recv_aes.decode( _read_buffer.get(), s, buffer );
+    _recv_aes.decode( buffer, s, buffer );
     return s;
 } FC_RETHROW_EXCEPTIONS( warn, "", ("len",len) ) }
 
@@ -118,11 +115,9 @@ size_t stcp_socket::writesome( const char* buffer, size_t len )
     } buffer_in_use_checker(_write_buffer_in_use);
 #endif
 
-    const std::size_t write_buffer_length = 4096;
     if (!_write_buffer)
-      _write_buffer.reset(new char[write_buffer_length], [](char* p){ delete[] p; });
-    len = std::min<size_t>(write_buffer_length, len);
-    memset(_write_buffer.get(), 0, len); // just in case aes.encode screws up
+      _write_buffer.reset(new char[BTS_NET_STCP_WRITE_BUFFER_SIZE], [](char* p){ delete[] p; });
+    len = std::min<size_t>(BTS_NET_STCP_WRITE_BUFFER_SIZE, len);
     /**
      * every sizeof(crypt_buf) bytes the aes channel
      * has an error and doesn't decrypt properly...  disable
@@ -140,6 +135,23 @@ size_t stcp_socket::writesome( const std::shared_ptr<const char>& buf, size_t le
   return writesome(buf.get() + offset, len);
 }
 
+void stcp_socket::write_encrypted( const char* plaintext, char* ciphertext, size_t len )
+{ try {
+    assert( len > 0 && (len % 16) == 0 );
+
+#ifndef NDEBUG
+    struct check_buffer_in_use {
+      bool& _buffer_in_use;
+      check_buffer_in_use(bool& buffer_in_use) : _buffer_in_use(buffer_in_use) { assert(!_buffer_in_use); _buffer_in_use = true; }
+      ~check_buffer_in_use() { assert(_buffer_in_use); _buffer_in_use = false; }
+    } buffer_in_use_checker(_write_buffer_in_use);
+#endif
+
+    uint32_t ciphertext_len = _send_aes.encode( plaintext, len, ciphertext );
+    assert(ciphertext_len == len);
+    _sock.write( ciphertext, ciphertext_len );
+} FC_RETHROW_EXCEPTIONS( warn, "", ("len",len) ) }
+
 void stcp_socket::flush()
 {
   _sock.flush();
@@ -164,9 +164,9 @@ public:
     _probe_complete_promise->set_value();
   }
 
-  bts::net::message get_message_for_item(const bts::net::item_id& item) override
+  bts::net::framed_message_ptr get_message_for_item(const bts::net::item_id& item, bool peer_accepts_compressed_messages) override
   {
-    return bts::net::item_not_available_message(item);
+    return std::make_shared<bts::net::framed_message>(bts::net::message(bts::net::item_not_available_message(item)));
   }
 
   void wait()
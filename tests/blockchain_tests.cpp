@@ -0,0 +1,749 @@
+#define BOOST_TEST_MODULE BlockchainTests
+#include <boost/test/unit_test.hpp>
+
+#include <bts/blockchain/block_log.hpp>
+#include <bts/blockchain/chain_database_impl.hpp>
+#include <bts/blockchain/exceptions.hpp>
+#include <bts/blockchain/fork_blocks.hpp>
+#include <bts/blockchain/market_records.hpp>
+#include <bts/blockchain/market_depth.hpp>
+#include <bts/blockchain/pending_chain_state.hpp>
+#include <bts/blockchain/pending_transaction_pool.hpp>
+#include <bts/blockchain/transaction_evaluation_state.hpp>
+#include <bts/db/level_map.hpp>
+
+#include <fc/filesystem.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <cstring>
+#include <limits>
+
+using namespace bts::blockchain;
+
+static full_block make_block( uint32_t block_num, const block_id_type& previous )
+{
+   full_block block;
+   block.block_num = block_num;
+   block.previous = previous;
+   block.timestamp = fc::time_point_sec( 1420000000 + block_num * 10 );
+   return block;
+}
+
+/** Appends blocks up to and including last_block_num and returns their ids, indexed by block number */
+static vector<block_id_type> append_blocks( block_log& log, uint32_t last_block_num, vector<block_id_type> ids = vector<block_id_type>( 1 ) )
+{
+   for( uint32_t block_num = log.head_block_num() + 1; block_num <= last_block_num; ++block_num )
+   {
+      const full_block block = make_block( block_num, ids.back() );
+      log.append( block, block.id() );
+      ids.push_back( block.id() );
+   }
+   return ids;
+}
+
+BOOST_AUTO_TEST_SUITE( block_log_tests )
+
+BOOST_AUTO_TEST_CASE( append_and_fetch )
+{ try {
+   fc::temp_directory dir;
+   block_log log;
+   log.open( dir.path() );
+   BOOST_CHECK_EQUAL( log.head_block_num(), 0u );
+   BOOST_CHECK( !log.fetch_optional( 1 ).valid() );
+
+   const vector<block_id_type> ids = append_blocks( log, 10 );
+   BOOST_CHECK_EQUAL( log.head_block_num(), 10u );
+   for( uint32_t block_num = 1; block_num <= 10; ++block_num )
+   {
+      BOOST_CHECK( *log.fetch_block_id( block_num ) == ids[ block_num ] );
+      BOOST_CHECK( log.fetch( block_num ).id() == ids[ block_num ] );
+      BOOST_CHECK( log.fetch_optional( block_num, ids[ block_num ] ).valid() );
+   }
+   BOOST_CHECK( !log.fetch_optional( 11 ).valid() );
+   BOOST_CHECK( !log.fetch_optional( 3, ids[ 4 ] ).valid() );
+   BOOST_CHECK_THROW( log.append( make_block( 12, ids.back() ), block_id_type() ), fc::exception );
+
+   // Reopening finds the same blocks
+   log.close();
+   log.open( dir.path() );
+   BOOST_CHECK_EQUAL( log.head_block_num(), 10u );
+   BOOST_CHECK( log.fetch( 7 ).id() == ids[ 7 ] );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( truncate_and_append )
+{ try {
+   fc::temp_directory dir;
+   block_log log;
+   log.open( dir.path() );
+   vector<block_id_type> ids = append_blocks( log, 10 );
+
+   log.truncate( 6 );
+   BOOST_CHECK_EQUAL( log.head_block_num(), 5u );
+   BOOST_CHECK( !log.fetch_optional( 6 ).valid() );
+   BOOST_CHECK( log.fetch( 5 ).id() == ids[ 5 ] );
+
+   // Blocks on the new fork replace the truncated ones
+   ids.resize( 6 );
+   ids = append_blocks( log, 8, ids );
+   BOOST_CHECK_EQUAL( log.head_block_num(), 8u );
+   BOOST_CHECK( log.fetch( 6 ).previous == ids[ 5 ] );
+   BOOST_CHECK( log.fetch( 8 ).id() == ids[ 8 ] );
+
+   log.close();
+   log.open( dir.path() );
+   BOOST_CHECK_EQUAL( log.head_block_num(), 8u );
+   BOOST_CHECK( log.fetch( 8 ).id() == ids[ 8 ] );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( discards_partial_append )
+{ try {
+   fc::temp_directory dir;
+   vector<block_id_type> ids;
+   {
+      block_log log;
+      log.open( dir.path() );
+      ids = append_blocks( log, 4 );
+   }
+
+   // Simulate a crash after the block was written but before its index entry was complete
+   const fc::path log_path = dir.path() / "blocks.log";
+   const fc::path index_path = dir.path() / "blocks.index";
+   boost::filesystem::resize_file( log_path, boost::filesystem::file_size( log_path ) - 1 );
+   boost::filesystem::resize_file( index_path, boost::filesystem::file_size( index_path ) - 3 );
+
+   block_log log;
+   log.open( dir.path() );
+   BOOST_CHECK_EQUAL( log.head_block_num(), 3u );
+   BOOST_CHECK( log.fetch( 3 ).id() == ids[ 3 ] );
+
+   ids.resize( 4 );
+   ids = append_blocks( log, 5, ids );
+   BOOST_CHECK( log.fetch( 5 ).id() == ids[ 5 ] );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( concurrent_reads )
+{ try {
+   fc::temp_directory dir;
+   block_log log;
+   log.open( dir.path() );
+   vector<block_id_type> ids = append_blocks( log, 50 );
+
+   // The chain_server reads from its own threads while the chain thread moves the head
+   std::vector<std::unique_ptr<fc::thread>> readers;
+   std::vector<fc::future<uint32_t>> results;
+   for( int i = 0; i < 4; ++i )
+   {
+      readers.emplace_back( new fc::thread( "block_log reader" ) );
+      results.push_back( readers.back()->async( [&log]() -> uint32_t
+      {
+         uint32_t bad_blocks = 0;
+         for( int pass = 0; pass < 20; ++pass )
+            for( uint32_t block_num = 1; block_num <= 40; ++block_num )
+            {
+               const optional<full_block> block = log.fetch_optional( block_num );
+               if( block.valid() && block->block_num != block_num )
+                  ++bad_blocks;
+            }
+         return bad_blocks;
+      } ) );
+   }
+
+   for( int i = 0; i < 20; ++i )
+   {
+      log.truncate( 41 );
+      ids.resize( 41 );
+      ids = append_blocks( log, 50, ids );
+   }
+
+   for( auto& result : results )
+      BOOST_CHECK_EQUAL( result.wait(), 0u );
+   for( auto& reader : readers )
+      reader->quit();
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+/** Stands in for the chain database, at a head block past every hard fork */
+class test_chain_state : public pending_chain_state
+{
+   public:
+      virtual uint32_t get_head_block_num()const override { return BTS_V0_9_2_FORK_BLOCK_NUM + 1; }
+};
+
+static address make_address( const string& seed )
+{
+   return address( fc::ecc::private_key::regenerate( fc::sha256::hash( seed ) ).get_public_key() );
+}
+
+static balance_id_type make_balance_id( const address& owner )
+{
+   return withdraw_condition( withdraw_with_signature( owner ), 0, 0 ).get_address();
+}
+
+static std::shared_ptr<test_chain_state> make_chain_state( const vector<address>& owners )
+{
+   const auto state = std::make_shared<test_chain_state>();
+   state->set_chain_id( digest_type() );
+
+   asset_record base_asset;
+   base_asset.id = 0;
+   base_asset.symbol = BTS_BLOCKCHAIN_SYMBOL;
+   base_asset.issuer_id = asset_record::god_issuer_id;
+   base_asset.name = BTS_BLOCKCHAIN_NAME;
+   base_asset.precision = BTS_BLOCKCHAIN_PRECISION;
+   base_asset.max_supply = BTS_BLOCKCHAIN_MAX_SHARES;
+   base_asset.current_supply = 1000000 * owners.size();
+   base_asset.collected_fees = 1000;
+   state->store_asset_record( base_asset );
+
+   for( const address& owner : owners )
+      state->store_balance_record( balance_record( owner, asset( 1000000, 0 ), 0 ) );
+
+   return state;
+}
+
+/** Moves 1000 from one owner to another and pays a fee of 10 in the base asset */
+static signed_transaction make_transfer( const chain_interface& state, const address& from, const address& to )
+{
+   signed_transaction trx;
+   trx.expiration = state.now() + 3600;
+   trx.withdraw( make_balance_id( from ), 1010 );
+   trx.deposit_to_address( asset( 1000, 0 ), to );
+   return trx;
+}
+
+static transaction_evaluation_state_ptr evaluate( const pending_chain_state_ptr& state, const signed_transaction& trx )
+{
+   const auto eval_state = std::make_shared<transaction_evaluation_state>( state );
+   eval_state->_skip_signature_check = true;
+   eval_state->evaluate( trx );
+   return eval_state;
+}
+
+BOOST_AUTO_TEST_SUITE( pending_state_tests )
+
+BOOST_AUTO_TEST_CASE( fee_payers_reused_across_block )
+{ try {
+   const address alice = make_address( "alice" );
+   const address bob = make_address( "bob" );
+   const address carol = make_address( "carol" );
+   const address dave = make_address( "dave" );
+   const auto chain = make_chain_state( { alice, carol } );
+
+   // Evaluate a pending transaction the way the chain database does, recording what it reads
+   const auto pending = std::make_shared<pending_chain_state>( chain );
+   const auto reads = std::make_shared<pending_read_set>();
+   const auto changes = std::make_shared<pending_chain_state>( pending );
+   changes->track_reads( reads );
+   const signed_transaction trx = make_transfer( *changes, alice, bob );
+   evaluate( changes, trx );
+   changes->track_reads( nullptr );
+   changes->apply_changes();
+   pending_read_set writes;
+   writes.add_writes( *changes );
+
+   // A block with an unrelated transaction that also pays fees, and pays its delegate from the base asset
+   const auto block_state = std::make_shared<pending_chain_state>( chain );
+   evaluate( block_state, make_transfer( *block_state, carol, dave ) );
+   oasset_record base_asset = block_state->get_asset_record( 0 );
+   base_asset->collected_fees -= 100;
+   base_asset->current_supply += 50;
+   block_state->store_asset_record( *base_asset );
+
+   pending_read_set dirty_keys;
+   dirty_keys.add_writes( *block_state );
+   BOOST_CHECK( !reads->intersects( dirty_keys ) );
+   BOOST_CHECK( !writes.intersects( dirty_keys ) );
+
+   // Anything that reads the collected fees or supply still has to be redone
+   pending_read_set supply_reader;
+   supply_reader.asset_supply_ids.insert( 0 );
+   BOOST_CHECK( supply_reader.intersects( dirty_keys ) );
+   BOOST_CHECK( supply_reader.intersects( writes ) );
+
+   // Reusing the saved changes on top of the new block gives the same result as evaluating again
+   block_state->apply_changes();
+   const auto reused = std::make_shared<pending_chain_state>( chain );
+   changes->set_prev_state( reused );
+   changes->apply_changes();
+
+   const auto evaluated = std::make_shared<pending_chain_state>( chain );
+   evaluate( evaluated, trx );
+
+   BOOST_CHECK_EQUAL( reused->get_asset_record( 0 )->collected_fees, 1000 + 10 - 100 + 10 );
+   BOOST_CHECK( fc::raw::pack( *reused->get_asset_record( 0 ) ) == fc::raw::pack( *evaluated->get_asset_record( 0 ) ) );
+   BOOST_CHECK_EQUAL( reused->get_balance_record( make_balance_id( bob ) )->balance, 1000 );
+   BOOST_CHECK_EQUAL( reused->get_balance_record( make_balance_id( alice ) )->balance, 1000000 - 1010 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( asset_definition_change_conflicts )
+{ try {
+   const address alice = make_address( "alice" );
+   const address bob = make_address( "bob" );
+   const auto chain = make_chain_state( { alice } );
+
+   const auto pending = std::make_shared<pending_chain_state>( chain );
+   const auto reads = std::make_shared<pending_read_set>();
+   const auto changes = std::make_shared<pending_chain_state>( pending );
+   changes->track_reads( reads );
+   evaluate( changes, make_transfer( *changes, alice, bob ) );
+   changes->track_reads( nullptr );
+
+   const auto block_state = std::make_shared<pending_chain_state>( chain );
+   oasset_record base_asset = block_state->get_asset_record( 0 );
+   base_asset->description = "changed";
+   block_state->store_asset_record( *base_asset );
+
+   pending_read_set dirty_keys;
+   dirty_keys.add_writes( *block_state );
+   BOOST_CHECK( reads->intersects( dirty_keys ) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( expired_writes_dirty_later_transactions )
+{ try {
+   const address alice = make_address( "alice" );
+   const address bob = make_address( "bob" );
+   const address carol = make_address( "carol" );
+   const address dave = make_address( "dave" );
+   const auto chain = make_chain_state( { alice, bob, carol } );
+   const auto pending = std::make_shared<pending_chain_state>( chain );
+
+   // Evaluate pending transactions in pool order the way the chain database does
+   unordered_map<transaction_id_type, pending_evaluation> evaluations;
+   const auto evaluate_pending = [ & ]( const address& from, const address& to ) -> transaction_id_type
+   {
+      pending_evaluation evaluation;
+      evaluation.reads = std::make_shared<pending_read_set>();
+      evaluation.changes = std::make_shared<pending_chain_state>( pending );
+      evaluation.changes->track_reads( evaluation.reads );
+      const signed_transaction trx = make_transfer( *evaluation.changes, from, to );
+      evaluation.eval_state = evaluate( evaluation.changes, trx );
+      evaluation.changes->track_reads( nullptr );
+      evaluation.changes->apply_changes();
+      evaluation.writes = std::make_shared<pending_read_set>();
+      evaluation.writes->add_writes( *evaluation.changes );
+      evaluation.reusable = true;
+      evaluations[ trx.id() ] = evaluation;
+      return trx.id();
+   };
+
+   // The first transaction pays bob, the second spends from the same balance
+   const transaction_id_type expiring = evaluate_pending( alice, bob );
+   const transaction_id_type spender = evaluate_pending( bob, dave );
+   const transaction_id_type unrelated = evaluate_pending( carol, dave );
+   const pending_read_set_ptr spender_reads = evaluations.at( spender ).reads;
+   const pending_read_set_ptr unrelated_reads = evaluations.at( unrelated ).reads;
+
+   pending_read_set dirty_keys;
+   forget_pending_evaluations( evaluations, { expiring }, dirty_keys );
+
+   BOOST_CHECK_EQUAL( evaluations.count( expiring ), 0u );
+   BOOST_CHECK_EQUAL( evaluations.size(), 2u );
+   BOOST_CHECK( dirty_keys.balance_ids.count( make_balance_id( bob ) ) > 0 );
+   BOOST_CHECK( spender_reads->intersects( dirty_keys ) );
+   BOOST_CHECK( !unrelated_reads->intersects( dirty_keys ) );
+
+   // Transactions that were never evaluated leave nothing behind
+   pending_read_set untouched;
+   forget_pending_evaluations( evaluations, { expiring }, untouched );
+   BOOST_CHECK( !spender_reads->intersects( untouched ) );
+   BOOST_CHECK_EQUAL( evaluations.size(), 2u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+static price make_price( uint64_t ratio )
+{
+   return price( fc::uint128_t( ratio ), 1, 0 );
+}
+
+BOOST_AUTO_TEST_SUITE( market_depth_tests )
+
+BOOST_AUTO_TEST_CASE( levels_and_updates )
+{ try {
+   market_depth_index index;
+   BOOST_CHECK( index.adjust( bid_order, 1, 0, make_price( 10 ), 100, 1 ) );
+   BOOST_CHECK( index.adjust( bid_order, 1, 0, make_price( 20 ), 50, 1 ) );
+   BOOST_CHECK( index.adjust( bid_order, 1, 0, make_price( 20 ), 30, 1 ) );
+   BOOST_CHECK( index.adjust( ask_order, 1, 0, make_price( 30 ), 70, 1 ) );
+   BOOST_CHECK( index.adjust( ask_order, 1, 0, make_price( 40 ), 60, 1 ) );
+   index.end_update( 1 );
+
+   market_depth depth = index.get_depth( 1, 0, 10 );
+   BOOST_CHECK_EQUAL( depth.update_id, 1u );
+   BOOST_REQUIRE_EQUAL( depth.bids.size(), 2u );
+   BOOST_CHECK( depth.bids[ 0 ].order_price == make_price( 20 ) );
+   BOOST_CHECK_EQUAL( depth.bids[ 0 ].balance, 80 );
+   BOOST_CHECK_EQUAL( depth.bids[ 0 ].order_count, 2u );
+   BOOST_REQUIRE_EQUAL( depth.asks.size(), 2u );
+   BOOST_CHECK( depth.asks[ 0 ].order_price == make_price( 30 ) );
+   BOOST_CHECK_EQUAL( index.get_depth( 1, 0, 1 ).asks.size(), 1u );
+
+   // Removing the last order at a level reports it with no orders
+   BOOST_CHECK( index.adjust( ask_order, 1, 0, make_price( 30 ), -70, -1 ) );
+   index.end_update( 2 );
+   index.end_update( 3 );
+
+   const vector<market_depth_update> updates = index.get_updates( 1, 0, 1, 10 );
+   BOOST_REQUIRE_EQUAL( updates.size(), 1u );
+   BOOST_CHECK_EQUAL( updates[ 0 ].block_num, 2u );
+   BOOST_REQUIRE_EQUAL( updates[ 0 ].changes.size(), 1u );
+   BOOST_CHECK( updates[ 0 ].changes[ 0 ].type == ask_order );
+   BOOST_CHECK_EQUAL( updates[ 0 ].changes[ 0 ].level.order_count, 0u );
+   BOOST_CHECK_EQUAL( index.get_depth( 1, 0, 10 ).asks.size(), 1u );
+   BOOST_CHECK( index.get_updates( 2, 0, 0, 10 ).empty() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( old_updates_pruned )
+{ try {
+   market_depth_index index;
+   for( uint32_t block_num = 1; block_num <= BTS_BLOCKCHAIN_MARKET_DEPTH_UPDATE_HISTORY + 1; ++block_num )
+   {
+      BOOST_CHECK( index.adjust( bid_order, 1, 0, make_price( block_num ), 1, 1 ) );
+      index.end_update( block_num );
+   }
+
+   BOOST_CHECK_THROW( index.get_updates( 1, 0, 0, 10 ), fc::exception );
+   BOOST_CHECK_EQUAL( index.get_updates( 1, 0, 1, 10 ).size(), 10u );
+   BOOST_CHECK_THROW( index.get_updates( 1, 0, BTS_BLOCKCHAIN_MARKET_DEPTH_UPDATE_HISTORY + 2, 10 ), fc::exception );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( mismatched_removal_leaves_book_for_resync )
+{ try {
+   market_depth_index index;
+   BOOST_CHECK( index.adjust( bid_order, 1, 0, make_price( 10 ), 100, 1 ) );
+   index.end_update( 1 );
+
+   BOOST_CHECK( !index.adjust( bid_order, 1, 0, make_price( 20 ), -100, -1 ) );
+   BOOST_CHECK( !index.adjust( bid_order, 1, 0, make_price( 10 ), -200, -2 ) );
+   market_depth depth = index.get_depth( 1, 0, 10 );
+   BOOST_REQUIRE_EQUAL( depth.bids.size(), 1u );
+   BOOST_CHECK_EQUAL( depth.bids[ 0 ].order_count, 1u );
+
+   // Rebuilding the market reports the levels that went away along with the new ones
+   index.reset_market( 1, 0 );
+   BOOST_CHECK( index.adjust( bid_order, 1, 0, make_price( 15 ), 40, 1 ) );
+   index.end_update( 2 );
+
+   depth = index.get_depth( 1, 0, 10 );
+   BOOST_REQUIRE_EQUAL( depth.bids.size(), 1u );
+   BOOST_CHECK( depth.bids[ 0 ].order_price == make_price( 15 ) );
+
+   const vector<market_depth_update> updates = index.get_updates( 1, 0, 1, 10 );
+   BOOST_REQUIRE_EQUAL( updates.size(), 1u );
+   BOOST_CHECK_EQUAL( updates[ 0 ].changes.size(), 2u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( history_newest_block_first_in_execution_order )
+{ try {
+   const std::set<market_history_pair_index> index{ { 1, 0, 5, 0 }, { 1, 0, 5, 1 }, { 1, 0, 7, 0 }, { 1, 0, 7, 1 },
+                                                    { 1, 0, 7, 2 }, { 2, 0, 9, 0 }, { 0, 0, 8, 0 } };
+
+   vector<std::pair<uint32_t, uint32_t>> walked;
+   auto iter = std::set<market_history_pair_index>::const_reverse_iterator(
+           index.upper_bound( market_history_pair_index{ 1, 0, std::numeric_limits<uint32_t>::max(), 0 } ) );
+   for( ; iter != index.rend() && iter->quote_id == 1 && iter->base_id == 0; ++iter )
+      walked.emplace_back( iter->block_num, iter->seq );
+
+   const vector<std::pair<uint32_t, uint32_t>> expected{ { 7, 0 }, { 7, 1 }, { 7, 2 }, { 5, 0 }, { 5, 1 } };
+   BOOST_CHECK( walked == expected );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( unstuck_shorts_match_full_scan )
+{ try {
+   // Limits of the market's own pair below, at and above the feed, plus unvalidated limits of other pairs
+   const vector<price> limits{ make_price( 10 ), make_price( 10 ), make_price( 15 ), make_price( 20 ), make_price( 30 ),
+                               price( fc::uint128_t( 5 ), 2, 0 ), price( fc::uint128_t( 50 ), 0, 1 ), price( fc::uint128_t( 7 ), -1, 0 ), price( fc::uint128_t( 20 ), 1, 3 ), price( fc::uint128_t( 40 ), 300, -300 ) };
+   const vector<address> owners{ make_address( "alice" ), make_address( "bob" ) };
+
+   std::set<short_limit_index> shorts;
+   for( size_t i = 0; i < limits.size(); ++i )
+      shorts.insert( { limits[ i ], market_index_key( make_price( 100 + i ), owners[ i % owners.size() ] ) } );
+
+   for( const uint64_t feed_ratio : { 1, 10, 15, 20, 25, 100 } )
+   {
+      const price feed_price = make_price( feed_ratio );
+
+      // The shorts the engine used to collect up front: every limit that is not at or above the feed
+      std::set<pair<price, market_index_key>> full_scan;
+      for( const short_limit_index& item : shorts )
+      {
+         if( !(item.limit_price >= feed_price) )
+            full_scan.insert( std::make_pair( item.limit_price, item.key ) );
+      }
+      vector<market_index_key> expected;
+      for( auto itr = full_scan.rbegin(); itr != full_scan.rend(); ++itr )
+         expected.push_back( itr->second );
+
+      vector<market_index_key> walked;
+      for( auto itr = skip_stuck_shorts( shorts, shorts.rbegin(), feed_price ); itr != shorts.rend();
+           itr = skip_stuck_shorts( shorts, ++itr, feed_price ) )
+      {
+         walked.push_back( itr->key );
+      }
+
+      BOOST_CHECK( walked == expected );
+   }
+
+   // Shorts limited in another pair are never stuck at the feed
+   vector<market_index_key> walked;
+   for( auto itr = skip_stuck_shorts( shorts, shorts.rbegin(), make_price( 1 ) ); itr != shorts.rend();
+        itr = skip_stuck_shorts( shorts, ++itr, make_price( 1 ) ) )
+   {
+      walked.push_back( itr->key );
+   }
+   BOOST_CHECK_EQUAL( walked.size(), 5u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+/** Checks that the encoded keys compare bytewise in the same order as the keys and decode back to them */
+template<typename Key>
+static void check_memcmp_order( vector<Key> keys )
+{
+   typedef bts::db::key_codec<Key> codec;
+   BOOST_REQUIRE( codec::memcmp_ordered );
+
+   std::sort( keys.begin(), keys.end() );
+   for( size_t i = 0; i < keys.size(); ++i )
+   {
+      const vector<char> packed = codec::pack( keys[ i ] );
+      Key unpacked;
+      codec::unpack( packed.data(), packed.size(), unpacked );
+      BOOST_CHECK( !( unpacked < keys[ i ] ) && !( keys[ i ] < unpacked ) );
+
+      if( i == 0 ) continue;
+      const vector<char> previous = codec::pack( keys[ i - 1 ] );
+      BOOST_REQUIRE_EQUAL( previous.size(), packed.size() );
+      const int result = memcmp( previous.data(), packed.data(), packed.size() );
+      BOOST_CHECK( keys[ i - 1 ] < keys[ i ] ? result < 0 : result == 0 );
+   }
+}
+
+static const vector<asset_id_type> test_asset_ids{ -300, -1, 0, 1, 300 };
+
+BOOST_AUTO_TEST_SUITE( key_encoding_tests )
+
+BOOST_AUTO_TEST_CASE( market_index_key_order )
+{ try {
+   const vector<fc::uint128_t> ratios{ fc::uint128_t(), fc::uint128_t( 0, 1 ), fc::uint128_t( 1, 0 ), fc::uint128_t( 1, 1 ),
+                                       fc::uint128_t( uint64_t( -1 ), 0 ) };
+   const vector<address> owners{ make_address( "alice" ), make_address( "bob" ) };
+
+   vector<market_index_key> keys;
+   for( const asset_id_type quote_id : test_asset_ids )
+      for( const asset_id_type base_id : test_asset_ids )
+         for( const fc::uint128_t& ratio : ratios )
+            for( const address& owner : owners )
+               keys.push_back( market_index_key( price( ratio, quote_id, base_id ), owner ) );
+   keys.push_back( keys.front() );
+
+   check_memcmp_order( keys );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( market_history_key_order )
+{ try {
+   const vector<market_history_key::time_granularity_enum> granularities{ market_history_key::each_block,
+                                                                          market_history_key::each_hour,
+                                                                          market_history_key::each_day };
+   const vector<fc::time_point_sec> timestamps{ fc::time_point_sec(), fc::time_point_sec( 1 ),
+                                                fc::time_point_sec( 1420000000 ), fc::time_point_sec( 0x80000000u ) };
+
+   vector<market_history_key> keys;
+   for( const asset_id_type quote_id : test_asset_ids )
+      for( const asset_id_type base_id : test_asset_ids )
+         for( const auto granularity : granularities )
+            for( const fc::time_point_sec& timestamp : timestamps )
+               keys.push_back( market_history_key( quote_id, base_id, granularity, timestamp ) );
+
+   check_memcmp_order( keys );
+} FC_LOG_AND_RETHROW() }
+
+/** Leaves a database of market history keys at dir with one entry per block number up to count */
+static void make_history_db( const fc::path& dir, uint32_t count )
+{
+   bts::db::level_map<market_history_key, uint32_t> db;
+   db.open( dir );
+   for( uint32_t block_num = 1; block_num <= count; ++block_num )
+      db.store( market_history_key( 1, 0, market_history_key::each_block, fc::time_point_sec( block_num ) ), block_num );
+   db.close();
+}
+
+static uint32_t count_history_db( const fc::path& dir )
+{
+   bts::db::level_map<market_history_key, uint32_t> db;
+   db.open( dir );
+   uint32_t count = 0;
+   for( auto iter = db.begin(); iter.valid(); ++iter )
+      ++count;
+   db.close();
+   return count;
+}
+
+BOOST_AUTO_TEST_CASE( interrupted_upgrade_swap )
+{ try {
+   fc::temp_directory temp;
+   const fc::path dir = temp.path() / "db";
+   const fc::path new_dir = temp.path() / "db.key_upgrade";
+   const fc::path old_dir = temp.path() / "db.key_upgrade_old";
+
+   // Stopped after the old database was moved aside but before the unfinished copy took its place
+   make_history_db( old_dir, 3 );
+   fc::create_directories( new_dir );
+   BOOST_CHECK_EQUAL( count_history_db( dir ), 3u );
+   BOOST_CHECK( !fc::exists( old_dir ) );
+   BOOST_CHECK( !fc::exists( new_dir ) );
+
+   // Stopped after the old database was moved aside; the finished copy has its KEY_ENCODING file
+   fc::remove_all( dir );
+   make_history_db( old_dir, 3 );
+   make_history_db( new_dir, 5 );
+   fc::create_directories( dir );
+   BOOST_CHECK_EQUAL( count_history_db( dir ), 5u );
+   BOOST_CHECK( !fc::exists( old_dir ) );
+   BOOST_CHECK( !fc::exists( new_dir ) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+/** Transactions that differ only in expiration, so they all pack to the same size */
+static signed_transaction make_pending_transaction( uint32_t expires_after )
+{
+   signed_transaction trx;
+   trx.expiration = fc::time_point_sec( 1420000000 + expires_after );
+   return trx;
+}
+
+static transaction_id_type insert_pending( pending_transaction_pool& pool, uint32_t expires_after, share_type fees,
+                                           const set<address>& signers = set<address>(), bool local = false,
+                                           vector<transaction_id_type>* evicted = nullptr )
+{
+   const signed_transaction trx = make_pending_transaction( expires_after );
+   const vector<transaction_id_type> evictions = pool.insert( trx.id(), trx, fees, signers, local );
+   if( evicted != nullptr )
+      *evicted = evictions;
+   return trx.id();
+}
+
+static const uint32_t pending_transaction_size = fc::raw::pack_size( make_pending_transaction( 0 ) );
+
+BOOST_AUTO_TEST_SUITE( pending_pool_tests )
+
+BOOST_AUTO_TEST_CASE( evicts_cheapest_per_byte )
+{ try {
+   pending_transaction_pool pool;
+   pool.set_limits( 3 * pending_transaction_size, 10 );
+
+   const transaction_id_type a = insert_pending( pool, 1, 30 );
+   const transaction_id_type b = insert_pending( pool, 2, 10 );
+   const transaction_id_type c = insert_pending( pool, 3, 20 );
+
+   vector<transaction_id_type> evicted;
+   const transaction_id_type d = insert_pending( pool, 4, 25, set<address>(), false, &evicted );
+   BOOST_REQUIRE_EQUAL( evicted.size(), 1u );
+   BOOST_CHECK( evicted.front() == b );
+   BOOST_CHECK( pool.contains( a ) && !pool.contains( b ) && pool.contains( c ) && pool.contains( d ) );
+
+   const pending_pool_stats stats = pool.get_stats();
+   BOOST_CHECK_EQUAL( stats.transaction_count, 3u );
+   BOOST_CHECK_EQUAL( stats.total_bytes, 3 * pending_transaction_size );
+   BOOST_CHECK_EQUAL( stats.evicted_count, 1u );
+   BOOST_CHECK_EQUAL( stats.min_fee_per_kilobyte, share_type( 20 * 1024 / pending_transaction_size ) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( rejects_newcomer_not_outbidding_cheapest )
+{ try {
+   pending_transaction_pool pool;
+   pool.set_limits( 2 * pending_transaction_size, 10 );
+
+   insert_pending( pool, 1, 20 );
+   insert_pending( pool, 2, 30 );
+
+   BOOST_CHECK_THROW( pool.check_admission( pending_transaction_size, 15, set<address>() ), pending_pool_full );
+   BOOST_CHECK_THROW( insert_pending( pool, 3, 15 ), pending_pool_full );
+   BOOST_CHECK_EQUAL( pool.size(), 2u );
+   BOOST_CHECK_EQUAL( pool.get_stats().evicted_count, 0u );
+
+   // Paying more per byte than the cheapest is not enough if it would have to evict a better one too
+   BOOST_CHECK_THROW( pool.check_admission( 2 * pending_transaction_size, 50, set<address>() ), pending_pool_full );
+   pool.check_admission( pending_transaction_size, 25, set<address>() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( limits_transactions_per_address )
+{ try {
+   const address alice = make_address( "alice" );
+   const address bob = make_address( "bob" );
+
+   pending_transaction_pool pool;
+   pool.set_limits( 100 * pending_transaction_size, 2 );
+
+   const transaction_id_type first = insert_pending( pool, 1, 10, { alice } );
+   insert_pending( pool, 2, 10, { alice, bob } );
+
+   BOOST_CHECK_THROW( pool.check_admission( pending_transaction_size, 10, { alice } ), too_many_pending_transactions );
+   BOOST_CHECK_THROW( pool.check_admission( pending_transaction_size, 10, { bob, alice } ), too_many_pending_transactions );
+   pool.check_admission( pending_transaction_size, 10, { bob } );
+   BOOST_CHECK_EQUAL( pool.get_stats().signer_count, 2u );
+
+   BOOST_CHECK( pool.remove( first ) );
+   pool.check_admission( pending_transaction_size, 10, { alice } );
+
+   // A new evaluation can change who signed
+   insert_pending( pool, 3, 10, { bob } );
+   pool.update( make_pending_transaction( 3 ).id(), 10, { alice } );
+   BOOST_CHECK_THROW( pool.check_admission( pending_transaction_size, 10, { alice } ), too_many_pending_transactions );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( local_transactions_never_evicted )
+{ try {
+   pending_transaction_pool pool;
+   pool.set_limits( 2 * pending_transaction_size, 10 );
+
+   const transaction_id_type local = insert_pending( pool, 1, 0, set<address>(), true );
+   const transaction_id_type remote = insert_pending( pool, 2, 10 );
+
+   vector<transaction_id_type> evicted;
+   const transaction_id_type richer = insert_pending( pool, 3, 50, set<address>(), false, &evicted );
+   BOOST_REQUIRE_EQUAL( evicted.size(), 1u );
+   BOOST_CHECK( evicted.front() == remote );
+   BOOST_CHECK( pool.contains( local ) && pool.contains( richer ) );
+
+   // Local transactions are taken even when the pool is full
+   insert_pending( pool, 4, 0, set<address>(), true, &evicted );
+   BOOST_CHECK( evicted.empty() );
+   BOOST_CHECK_EQUAL( pool.size(), 3u );
+   BOOST_CHECK_EQUAL( pool.get_stats().min_fee_per_kilobyte, share_type( 50 * 1024 / pending_transaction_size ) );
+
+   // With only local transactions left to evict, nothing else fits
+   BOOST_CHECK_THROW( insert_pending( pool, 5, 1000 ), pending_pool_full );
+   BOOST_CHECK( pool.contains( local ) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( removes_expired_in_expiration_order )
+{ try {
+   pending_transaction_pool pool;
+   pool.set_limits( 100 * pending_transaction_size, 10 );
+
+   const transaction_id_type later = insert_pending( pool, 3, 10 );
+   const transaction_id_type first = insert_pending( pool, 1, 10 );
+   const transaction_id_type second = insert_pending( pool, 2, 10, set<address>(), true );
+
+   BOOST_CHECK( pool.remove_expired( fc::time_point_sec( 1420000000 ) ).empty() );
+
+   const vector<transaction_id_type> expired = pool.remove_expired( fc::time_point_sec( 1420000002 ) );
+   BOOST_REQUIRE_EQUAL( expired.size(), 2u );
+   BOOST_CHECK( expired[ 0 ] == first );
+   BOOST_CHECK( expired[ 1 ] == second );
+   BOOST_CHECK( pool.contains( later ) );
+
+   const pending_pool_stats stats = pool.get_stats();
+   BOOST_CHECK_EQUAL( stats.transaction_count, 1u );
+   BOOST_CHECK_EQUAL( stats.total_bytes, pending_transaction_size );
+   BOOST_CHECK_EQUAL( stats.expired_count, 2u );
+   BOOST_REQUIRE( stats.next_expiration.valid() );
+   BOOST_CHECK( *stats.next_expiration == fc::time_point_sec( 1420000003 ) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,195 @@
+/**
+ *  Replays market matching against a copy of the order books in an existing chain database, so that changes to the
+ *  market engines can be timed without producing blocks. Every run of a market starts from the same state and must
+ *  produce the same market transactions; the benchmark fails if any run differs.
+ *
+ *  The order books are read from the database; a captured pending_chain_state (for example an undo state dumped to
+ *  JSON) can be layered on top to supply the asset, balance, feed and status records the engines read.
+ */
+#include <bts/blockchain/chain_database.hpp>
+#include <bts/blockchain/config.hpp>
+#include <fc/io/json.hpp>
+#include <fc/io/raw.hpp>
+#include <fc/log/logger_config.hpp>
+#include <fc/reflect/variant.hpp>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/program_options.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+
+using namespace bts::blockchain;
+
+static std::atomic<uint64_t> allocation_count( 0 );
+
+void* operator new( size_t size )
+{
+   ++allocation_count;
+   if( void* ptr = std::malloc( size > 0 ? size : 1 ) )
+      return ptr;
+   throw std::bad_alloc();
+}
+
+void operator delete( void* ptr )noexcept
+{
+   std::free( ptr );
+}
+
+struct market_stats
+{
+   uint32_t                 runs = 0;
+   uint64_t                 transactions = 0;
+   uint64_t                 allocations = 0;
+   fc::microseconds         total;
+   vector<fc::microseconds> pass_totals;
+};
+
+int main( int argc, char** argv )
+{
+   namespace po = boost::program_options;
+
+   po::options_description option_config( "Allowed options" );
+   option_config.add_options()
+      ( "help", "display this help message" )
+      ( "data-dir", po::value<std::string>(), "chain database directory of a stopped client" )
+      ( "markets", po::value<std::string>(), "comma separated QUOTE:BASE pairs to run; defaults to every market" )
+      ( "state", po::value<std::string>(), "JSON pending_chain_state to layer over the database" )
+      ( "runs", po::value<uint32_t>()->default_value( 100 ), "number of times to run each market" )
+      ( "engine", po::value<uint32_t>()->default_value( 0 ), "market engine version; 0 is the current engine" );
+
+   po::variables_map options;
+   try
+   {
+      po::store( po::parse_command_line( argc, argv, option_config ), options );
+      po::notify( options );
+   }
+   catch( const po::error& e )
+   {
+      std::cerr << e.what() << "\n\n" << option_config << "\n";
+      return 1;
+   }
+
+   if( options.count( "help" ) || !options.count( "data-dir" ) )
+   {
+      std::cout << option_config << "\n";
+      return options.count( "help" ) ? 0 : 1;
+   }
+
+   try
+   {
+      // The engines log every match at info level
+      fc::logging_config log_config = fc::logging_config::default_config();
+      for( auto& logger : log_config.loggers )
+         logger.level = fc::log_level::warn;
+      fc::configure_logging( log_config );
+
+      const chain_database_ptr db = std::make_shared<chain_database>();
+      db->open( options[ "data-dir" ].as<std::string>(), fc::optional<fc::path>(), false );
+
+      chain_interface_ptr base_state = db;
+      if( options.count( "state" ) )
+      {
+         auto captured = std::make_shared<pending_chain_state>(
+                 fc::json::from_file( options[ "state" ].as<std::string>() ).as<pending_chain_state>() );
+         captured->set_prev_state( db );
+         base_state = captured;
+      }
+
+      vector<pair<asset_id_type, asset_id_type>> markets;
+      if( options.count( "markets" ) )
+      {
+         vector<std::string> pairs;
+         boost::split( pairs, options[ "markets" ].as<std::string>(), boost::is_any_of( "," ) );
+         for( const std::string& item : pairs )
+         {
+            vector<std::string> symbols;
+            boost::split( symbols, item, boost::is_any_of( ":" ) );
+            FC_ASSERT( symbols.size() == 2, "Markets must be given as QUOTE:BASE" );
+            markets.emplace_back( db->get_asset_id( symbols[ 0 ] ), db->get_asset_id( symbols[ 1 ] ) );
+         }
+      }
+      else
+      {
+         markets = db->get_market_pairs();
+      }
+
+      const uint32_t runs = options[ "runs" ].as<uint32_t>();
+      const uint32_t engine_version = options[ "engine" ].as<uint32_t>();
+      const time_point_sec timestamp = db->now() + BTS_BLOCKCHAIN_BLOCK_INTERVAL_SEC;
+
+      std::cout << "Head block " << db->get_head_block_num() << ", engine " << engine_version << ", "
+                << runs << " runs per market\n\n";
+      std::cout << std::left << std::setw( 16 ) << "market" << std::right
+                << std::setw( 10 ) << "matched" << std::setw( 14 ) << "us/run" << std::setw( 14 ) << "matched/s"
+                << std::setw( 14 ) << "allocs/run" << std::setw( 14 ) << "margin us" << std::setw( 14 ) << "expired us"
+                << std::setw( 14 ) << "asks us" << "\n";
+
+      bool deterministic = true;
+      for( const auto& market : markets )
+      {
+         market_stats stats;
+         vector<char> expected;
+
+         for( uint32_t i = 0; i < runs; ++i )
+         {
+            const pending_chain_state_ptr state = std::make_shared<pending_chain_state>( base_state );
+
+            const uint64_t allocations_before = allocation_count;
+            const fc::time_point start = fc::time_point::now();
+            const market_engine_run run = db->debug_execute_market( state, market.first, market.second, timestamp,
+                                                                    engine_version );
+            stats.total += fc::time_point::now() - start;
+            stats.allocations += allocation_count - allocations_before;
+
+            ++stats.runs;
+            stats.transactions += run.transactions.size();
+            stats.pass_totals.resize( std::max( stats.pass_totals.size(), run.pass_durations.size() ) );
+            for( size_t pass = 0; pass < run.pass_durations.size(); ++pass )
+               stats.pass_totals[ pass ] += run.pass_durations[ pass ];
+
+            const vector<char> packed = fc::raw::pack( run.transactions );
+            if( i == 0 )
+            {
+               expected = packed;
+            }
+            else if( packed != expected )
+            {
+               std::cerr << "Run " << i << " of market " << db->get_asset_symbol( market.first ) << ":"
+                         << db->get_asset_symbol( market.second ) << " produced different market transactions\n";
+               deterministic = false;
+               break;
+            }
+         }
+
+         if( stats.runs == 0 )
+            continue;
+
+         const int64_t total_us = std::max<int64_t>( stats.total.count(), 1 );
+         const auto pass_us = [ & ]( size_t pass ) -> int64_t
+         {
+            return pass < stats.pass_totals.size() ? stats.pass_totals[ pass ].count() / stats.runs : 0;
+         };
+
+         std::cout << std::left << std::setw( 16 )
+                   << ( db->get_asset_symbol( market.first ) + ":" + db->get_asset_symbol( market.second ) ) << std::right
+                   << std::setw( 10 ) << stats.transactions / stats.runs
+                   << std::setw( 14 ) << total_us / stats.runs
+                   << std::setw( 14 ) << uint64_t( stats.transactions * 1000000 / total_us )
+                   << std::setw( 14 ) << stats.allocations / stats.runs
+                   << std::setw( 14 ) << pass_us( 0 ) << std::setw( 14 ) << pass_us( 1 ) << std::setw( 14 ) << pass_us( 2 )
+                   << "\n";
+      }
+
+      db->close();
+      return deterministic ? 0 : 2;
+   }
+   catch( const fc::exception& e )
+   {
+      std::cerr << e.to_detail_string() << "\n";
+      return 1;
+   }
+}